@@ -12,7 +12,8 @@
 #include "include/history.h"
 #include "../3.lexor/src/lab_parser.h"
 #include "process/process_mgmt.h"
-#include "process/process_mgmt.h"
+#include "process/cache.h"
+#include "vm.h"
 
 
 
@@ -86,6 +87,7 @@ void handle_zoombie(){
 
 void sigint_handler(int sig) {
 
+    vm_interrupt = 1;   // a job running in-process (run) stops at its next branch
     write(STDOUT_FILENO, "\n", 1);
 
     char curr_working_dir[4000];
@@ -158,6 +160,7 @@ void getCurrDir(char *buffer, size_t size){
 int main() {
     initHistory();
     init_process_table();
+    cache_init();
 
     signal(SIGCHLD, handle_zoombie);
     signal(SIGINT, sigint_handler); // custom handler for Ctrl+C in main shell process
@@ -271,6 +274,13 @@ int main() {
         //     continue;
         // }
 
+        int check_cache = handle_cache(argument_list);
+        if (check_cache == 1) {
+            addToHistory(trimmed_input);
+            free(read);
+            continue;
+        }
+
         int check_kill = handle_kill(argument_list);
         if (check_kill == 1) {
             addToHistory(trimmed_input);
@@ -0,0 +1,213 @@
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+static char cache_dir[4096];   // empty: caching disabled
+static int hits[2], misses[2]; // [0] assembly (.asm), [1] bytecode (.byc)
+
+static int stat_slot(const char *ext) {
+    return strcmp(ext, ".byc") == 0;
+}
+
+void cache_init(void) {
+    char cwd[4000];
+    if (!getcwd(cwd, sizeof(cwd))) return;
+
+    snprintf(cache_dir, sizeof(cache_dir), "%s/%s", cwd, CACHE_DIR_NAME);
+    if (mkdir(cache_dir, 0755) != 0 && errno != EEXIST) {
+        perror("[Cache] Could not create cache directory");
+        cache_dir[0] = '\0';
+    }
+}
+
+// 64-bit FNV-1a, fed incrementally
+static uint64_t fnv1a(uint64_t h, const void *data, size_t n) {
+    const unsigned char *b = data;
+    for (size_t i = 0; i < n; i++) {
+        h ^= b[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+int cache_key(const char *file, const char *stage, char *key) {
+    // the whole shell is rebuilt in one step, so this changes with the compiler and assembler
+    const char *stamp = "compiler " __DATE__ " " __TIME__;
+    uint64_t h = fnv1a(0xcbf29ce484222325ULL, stamp, strlen(stamp));
+    h = fnv1a(h, stage, strlen(stage) + 1);
+
+    FILE *in = fopen(file, "rb");
+    if (!in) return 0;
+
+    unsigned char buf[8192];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        h = fnv1a(h, buf, n);
+    }
+    fclose(in);
+
+    snprintf(key, CACHE_KEY_LEN, "%016llx", (unsigned long long)h);
+    return 1;
+}
+
+static int copy_file(const char *src, const char *dest) {
+    FILE *in = fopen(src, "rb");
+    if (!in) return 0;
+    FILE *out = fopen(dest, "wb");
+    if (!out) {
+        fclose(in);
+        return 0;
+    }
+
+    unsigned char buf[8192];
+    size_t n;
+    int ok = 1;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, n, out) != n) {
+            ok = 0;
+            break;
+        }
+    }
+    if (ferror(in)) ok = 0;
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    return ok;
+}
+
+static void entry_path(char *path, size_t size, const char *key, const char *ext) {
+    snprintf(path, size, "%s/%s%s", cache_dir, key, ext);
+}
+
+int cache_fetch(const char *key, const char *ext, const char *dest) {
+    char path[4200];
+    if (!cache_dir[0]) return 0;
+
+    entry_path(path, sizeof(path), key, ext);
+    if (access(path, R_OK) == 0 && copy_file(path, dest)) {
+        utimensat(AT_FDCWD, path, NULL, 0);   // recently used: evicted last
+        hits[stat_slot(ext)]++;
+        return 1;
+    }
+    misses[stat_slot(ext)]++;
+    return 0;
+}
+
+static int is_entry(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && (strcmp(dot, ".asm") == 0 || strcmp(dot, ".byc") == 0);
+}
+
+typedef struct {
+    char name[256];
+    time_t used;   // mtime: written or last hit
+} CacheEntry;
+
+static int least_recent_first(const void *a, const void *b) {
+    const CacheEntry *x = a, *y = b;
+    if (x->used != y->used) return x->used < y->used ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+// drop the least recently used entries beyond CACHE_MAX_ENTRIES
+static void cache_trim(void) {
+    DIR *dir = opendir(cache_dir);
+    if (!dir) return;
+
+    CacheEntry *entries = NULL;
+    int count = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        char path[4400];
+        struct stat st;
+        if (!is_entry(ent->d_name) || strlen(ent->d_name) >= sizeof(entries->name)) continue;
+        snprintf(path, sizeof(path), "%s/%s", cache_dir, ent->d_name);
+        if (stat(path, &st) != 0) continue;
+
+        if (count == cap) {
+            int new_cap = cap ? cap * 2 : CACHE_MAX_ENTRIES + 16;
+            CacheEntry *grown = realloc(entries, (size_t)new_cap * sizeof(CacheEntry));
+            if (!grown) break;   // trim what we have listed so far
+            entries = grown;
+            cap = new_cap;
+        }
+        strcpy(entries[count].name, ent->d_name);
+        entries[count].used = st.st_mtime;
+        count++;
+    }
+    closedir(dir);
+
+    if (count > CACHE_MAX_ENTRIES) {
+        qsort(entries, (size_t)count, sizeof(CacheEntry), least_recent_first);
+        for (int i = 0; i < count - CACHE_MAX_ENTRIES; i++) {
+            char path[4400];
+            snprintf(path, sizeof(path), "%s/%s", cache_dir, entries[i].name);
+            remove(path);
+        }
+    }
+    free(entries);
+}
+
+void cache_store(const char *key, const char *ext, const char *src) {
+    char path[4200], tmp[4300];
+    if (!cache_dir[0]) return;
+
+    entry_path(path, sizeof(path), key, ext);
+    snprintf(tmp, sizeof(tmp), "%s.tmp.%d", path, (int)getpid());
+    if (!copy_file(src, tmp) || rename(tmp, path) != 0) {
+        remove(tmp);
+        return;
+    }
+    cache_trim();
+}
+
+// --- CACHE COMMAND HANDLER ---
+int handle_cache(char **args) {
+    if (strcmp(args[0], "cache") != 0) return 0;
+
+    if (!cache_dir[0]) {
+        printf("[Cache] Disabled (no cache directory).\n");
+        return 1;
+    }
+
+    int clear = args[1] != NULL && strcmp(args[1], "clear") == 0;
+    if (args[1] != NULL && !clear) {
+        printf("Usage: cache [clear]\n");
+        return 1;
+    }
+
+    DIR *dir = opendir(cache_dir);
+    if (!dir) {
+        perror("[Cache] Could not open cache directory");
+        return 1;
+    }
+
+    int entries = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (!is_entry(ent->d_name)) continue;
+        if (clear) {
+            char path[4400];
+            snprintf(path, sizeof(path), "%s/%s", cache_dir, ent->d_name);
+            if (remove(path) != 0) continue;
+        }
+        entries++;
+    }
+    closedir(dir);
+
+    if (clear) {
+        printf("[Cache] Removed %d entries from %s\n", entries, cache_dir);
+    } else {
+        printf("[Cache] %s: %d entries (limit %d)\n", cache_dir, entries, CACHE_MAX_ENTRIES);
+        printf("        assembly hits %d, misses %d\n", hits[0], misses[0]);
+        printf("        bytecode hits %d, misses %d\n", hits[1], misses[1]);
+    }
+    return 1;
+}
@@ -0,0 +1,35 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+/*
+ * Content-addressed compile cache. Each entry is <dir>/<key><ext>, where the
+ * key hashes the input file's bytes together with the shell's build stamp:
+ * the compiler and assembler are linked into the shell, so rebuilding it
+ * misses instead of returning stale output. Entries are written to a temp
+ * file and renamed, so shells sharing the directory never read a
+ * half-written entry.
+ *
+ * The directory holds at most CACHE_MAX_ENTRIES entries: a hit refreshes an
+ * entry's mtime and each store evicts the least recently used beyond that.
+ * Without a usable cache directory every lookup misses and stores do nothing.
+ */
+#define CACHE_DIR_NAME ".cache"
+#define CACHE_KEY_LEN 17          /* 16 hex digits + NUL */
+#define CACHE_MAX_ENTRIES 256
+
+/* creates <cwd>/.cache at startup, so a later `cd` does not move it */
+void cache_init(void);
+
+/* stage ("compile", "assemble") keeps one input's entries for different
+ * steps apart; returns 0 if file cannot be read */
+int cache_key(const char *file, const char *stage, char *key);
+
+/* copy the entry to dest; 1 on a hit */
+int cache_fetch(const char *key, const char *ext, const char *dest);
+/* copy src into the cache under key, evicting old entries past the limit */
+void cache_store(const char *key, const char *ext, const char *src);
+
+/* `cache` prints the directory and hit counts, `cache clear` empties it */
+int handle_cache(char **args);
+
+#endif
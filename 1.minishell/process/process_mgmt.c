@@ -1,4 +1,5 @@
 #include "process_mgmt.h"
+#include "cache.h"
 #include <stdio.h>
 #include <string.h>
 #include <sys/wait.h>
@@ -6,10 +7,15 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <libgen.h> // Required for basename() and dirname()
+#include <setjmp.h>
+#include <time.h>
 
 #include "../../3.lexor/src/lab_parser.h" 
 #include "../../5.VM(ASS)withGC/debugger/debugger.h"
 #include "../../5.VM(ASS)withGC/VM/loader.h"
+#include "../../5.VM(ASS)withGC/VM/exec.h"
+#include "../../5.VM(ASS)withGC/VM/include/object.h"
+#include "../../5.VM(ASS)withGC/assembler_c/assembler.h"
 
 Process process_table[MAX_PROCESSES];
 int next_pid = 100; // Start PIDs at 100
@@ -138,7 +144,7 @@ void print_process_list() {
             printf("%-5d %-12s %-18s %-18s %-18s\n", 
                 process_table[i].pid, s, 
                 process_table[i].input_file, 
-                process_table[i].output_file,
+                process_table[i].output_file[0] ? process_table[i].output_file : "-",
                 process_table[i].bytecode_file);
         }
     }
@@ -157,15 +163,6 @@ void handle_zoombi(){
     
 }
 
-void sigint_handle(int sig) {
-
-    write(STDOUT_FILENO, "\n", 1);
-
-    char curr_working_dir[4000];
-    getCurrDir(curr_working_dir, sizeof(curr_working_dir));
-
-
-}
 
 
 //code --- PS COMMAND HANDLER ---
@@ -179,8 +176,11 @@ int handle_ps(char **args) {
 int handle_submit(char **args) {
     if (strcmp(args[0], "submit") != 0) return 0;
 
-    if (args[1] == NULL) {
-        printf("Usage: submit <filename>\n");
+    // --asm: compile to text assembly and assemble it on run (a debug
+    // artifact that can be read or edited); default: bytecode straight from the AST
+    int want_asm = args[1] != NULL && args[2] != NULL && strcmp(args[2], "--asm") == 0;
+    if (args[1] == NULL || (args[2] != NULL && !want_asm)) {
+        printf("Usage: submit <filename> [--asm]\n");
         return 1;
     }
 
@@ -201,27 +201,49 @@ int handle_submit(char **args) {
 
     Process *proc = get_process(pid);
     printf("Process created with PID: %d\n", pid);
-    printf("Submitting %s to parser...\n", full_input_path);
 
-    // CALL THE PARSER
-    // run_parser generates "output.asm" in the current directory
-    // We pass 0 for do_eval (compile only)
-    int result = run_parser(full_input_path, 0); 
+    // No .asm for this process: run and debug use the bytecode as is
+    if (!want_asm) proc->output_file[0] = '\0';
+
+    const char *ext = want_asm ? ".asm" : ".byc";
+    const char *generated = want_asm ? "output.asm" : "output.byc";
+    const char *target = want_asm ? proc->output_file : proc->bytecode_file;
+
+    // An identical source compiled before: reuse its output
+    char key[CACHE_KEY_LEN];
+    int keyed = cache_key(full_input_path, "compile", key);
+    int result;
+
+    if (keyed && cache_fetch(key, ext, target)) {
+        printf("[Cache] %s unchanged, skipping the parser.\n", full_input_path);
+        result = 0;
+    } else {
+        printf("Submitting %s to parser...\n", full_input_path);
+
+        // CALL THE PARSER
+        // run_parser generates "output.asm" or "output.byc" in the current directory
+        // We pass 0 for do_eval (compile only)
+        result = run_parser(full_input_path, 0, want_asm ? PARSER_EMIT_ASM : PARSER_EMIT_BYC); 
 
-    if (result == 0) {
-        // --- SUCCESS LOGIC ---
-        
         // Rename the generic output to the specific output file
         // (e.g., rename "output.asm" to "test.asm")
-        if (rename("output.asm", proc->output_file) != 0) {
-            perror("[Warning] Could not rename output.asm");
+        if (result == 0 && rename(generated, target) != 0) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "[Warning] Could not rename %s", generated);
+            perror(msg);
             // If rename fails, we still mark it submitted but warn the user
+        } else if (result == 0 && keyed) {
+            cache_store(key, ext, target);
         }
+    }
+
+    if (result == 0) {
+        // --- SUCCESS LOGIC ---
 
         // Update Process State
         update_process_state(pid, STATE_SUBMITTED);
         
-        printf("[Success] AST Generated & ASM Written to '%s'.\n", proc->output_file);
+        printf("[Success] AST Generated & %s Written to '%s'.\n", want_asm ? "ASM" : "Bytecode", target);
         printf("Ready to run. Type: run %d\n", pid);
 
     } else {
@@ -233,6 +255,103 @@ int handle_submit(char **args) {
     return 1;
 }
 
+// Whole file into a malloc'd buffer; NULL if it cannot be read
+static char *read_file(const char *file, size_t *len) {
+    FILE *in = fopen(file, "rb");
+    if (!in) return NULL;
+
+    char *text = NULL;
+    long size = -1;
+    if (fseek(in, 0, SEEK_END) == 0) size = ftell(in);
+    if (size >= 0 && fseek(in, 0, SEEK_SET) == 0) text = malloc((size_t)size + 1);
+    if (text && fread(text, 1, (size_t)size, in) != (size_t)size) {
+        free(text);
+        text = NULL;
+    }
+    fclose(in);
+    *len = text ? (size_t)size : 0;
+    return text;
+}
+
+static int write_file(const char *file, const unsigned char *data, int size) {
+    FILE *out = fopen(file, "wb");
+    if (!out) return 0;
+    int written = (int)fwrite(data, 1, (size_t)size, out);
+    return fclose(out) == 0 && written == size;
+}
+
+// Assemble proc's .asm into its .byc with the assembler linked into the
+// shell (no child process), or copy the bytecode cached for an identical
+// .asm. Returns 0 on success.
+static int build_bytecode(Process *proc) {
+    char key[CACHE_KEY_LEN];
+    int keyed = cache_key(proc->output_file, "assemble", key);
+
+    if (keyed && cache_fetch(key, ".byc", proc->bytecode_file)) {
+        printf("[Cache] %s unchanged, skipping the assembler.\n", proc->output_file);
+        return 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t len;
+    char *text = read_file(proc->output_file, &len);
+    if (!text) {
+        perror("[Shell] Could not read assembly");
+        return -1;
+    }
+
+    ByteBuf bytecode = { 0 };
+    int failed = assemble_buffer(text, len, &bytecode) != 0;
+    free(text);
+    if (!failed && !write_file(proc->bytecode_file, bytecode.data, bytecode.size)) {
+        perror("[Shell] Could not write bytecode");
+        failed = 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long us = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+    if (!failed) printf("[Shell] Assembled %d bytes in %ld us.\n", bytecode.size, us);
+    free(bytecode.data);
+    if (failed) return -1;
+
+    if (keyed) cache_store(key, ".byc", proc->bytecode_file);
+    return 0;
+}
+
+// Run a .byc inside the shell: the program gets its own heap, and a VM
+// error unwinds back here instead of exiting the shell.
+static int run_bytecode(const char *file) {
+    Heap *heap = heap_create();
+    Program prog;
+    jmp_buf on_error;
+    int status = VM_EXIT_OK;
+
+    if (!heap) return VM_EXIT_ERR;
+    if (!vm_load(&prog, heap, file)) {
+        heap_destroy(heap);
+        return VM_EXIT_ERR;
+    }
+    if (setjmp(on_error) == 0) {
+        prog.on_error = &on_error;
+        vm_interrupt = 0;   /* a Ctrl-C at the prompt must not stop this run */
+        vm_validate(&prog);
+        vm_fuse(&prog);
+        vm_run(&prog);
+
+        gc_collect(heap, 0);
+        vm_print_stack(&prog);
+        vm_print_memory(&prog);
+    } else {
+        status = VM_EXIT_ERR;
+    }
+
+    vm_free(&prog);
+    heap_destroy(heap);   /* waits for a background sweep still in flight */
+    return status;
+}
+
 // --- RUN COMMAND HANDLER ---
 int handle_run(char **args) {
     if (strcmp(args[0], "run") != 0) return 0;
@@ -257,25 +376,17 @@ int handle_run(char **args) {
         return 1;
     }
 
-    // Define Executable Paths
-    const char *ASSEMBLER_BIN = "../5.VM(ASS)withGC/assembler";
-    const char *VM_BIN        = "../5.VM(ASS)withGC/bvm";
-
-    char cmd[1024];
-
-    // STEP A: Run Assembler
+    // STEP A: Run Assembler (only for `submit --asm`; otherwise the .byc is ready)
     // Input: proc->output_file (.asm) | Output: proc->bytecode_file (.byc)
-    printf("[Shell] Assembling '%s' -> '%s'...\n", proc->output_file, proc->bytecode_file);
-    
-    // Use single quotes around paths to handle the () in the folder name
-    snprintf(cmd, sizeof(cmd), "'%s' '%s' '%s'", 
-             ASSEMBLER_BIN, proc->output_file, proc->bytecode_file);
-    
-    int asm_ret = system(cmd);
-    if (asm_ret != 0) {
-        printf("[Shell] Assembly Failed.\n");
-        update_process_state(pid, STATE_FAILED);
-        return 1;
+    if (proc->output_file[0]) {
+        printf("[Shell] Assembling '%s' -> '%s'...\n", proc->output_file, proc->bytecode_file);
+        
+        int asm_ret = build_bytecode(proc);
+        if (asm_ret != 0) {
+            printf("[Shell] Assembly Failed.\n");
+            update_process_state(pid, STATE_FAILED);
+            return 1;
+        }
     }
 
     // STEP B: Run VM
@@ -284,9 +395,9 @@ int handle_run(char **args) {
     
     update_process_state(pid, STATE_RUNNING);
     
-    // Pass the .byc file to the VM
-    snprintf(cmd, sizeof(cmd), "'%s' '%s'", VM_BIN, proc->bytecode_file);
-    int vm_ret = system(cmd);
+    // The VM runs in-process on its own heap (no bvm child)
+    int vm_ret = run_bytecode(proc->bytecode_file);
+    fflush(stdout);
     
     printf("--------------------------------------------------\n");
 
@@ -318,20 +429,14 @@ int handle_kill(char **args) {
         return 1;
     }
 
-    // Delete .asm file
-    if (remove(proc->output_file) == 0) {
+    // Delete .asm file (none unless submitted with --asm)
+    if (proc->output_file[0] && remove(proc->output_file) == 0) {
         printf("[Kill] Deleted %s\n", proc->output_file);
     }
 
     // Delete .byc file
-    char bytecode_file[256];
-    strcpy(bytecode_file, proc->output_file);
-    char *dot = strrchr(bytecode_file, '.');
-    if (dot) strcpy(dot, ".byc");
-    else strcat(bytecode_file, ".byc");
-
-    if (remove(bytecode_file) == 0) {
-        printf("[Kill] Deleted %s\n", bytecode_file);
+    if (remove(proc->bytecode_file) == 0) {
+        printf("[Kill] Deleted %s\n", proc->bytecode_file);
     }
 
     // Free Process Table Entry
@@ -358,43 +463,39 @@ void debug_program(int pid) {
         signal(SIGINT, SIG_DFL);
         // signal(SIGQUIT, SIG_DFL);
 
-        // Run the Assembler before starting the debugger
+        // Run the Assembler before starting the debugger (`submit --asm` only)
         // We now use both proc->output_file (.asm) and proc->bytecode_file (.byc)
-        char assemble_cmd[1024];
-        sprintf(assemble_cmd, "'../5.VM(ASS)withGC/assembler' '%s' '%s'", 
-                proc->output_file, proc->bytecode_file);
-
-        printf("[Debugger] Syncing: Assembling %s -> %s...\n", 
-                proc->output_file, proc->bytecode_file);
+        if (proc->output_file[0]) {
+            printf("[Debugger] Syncing: Assembling %s -> %s...\n", 
+                    proc->output_file, proc->bytecode_file);
+        }
 
-        // Execute assembly. system() returns 0 on success.
-        if (system(assemble_cmd) != 0) {
+        if (proc->output_file[0] && build_bytecode(proc) != 0) {
             fprintf(stderr, "Debugger Error: Assembly failed. Check if path/file exists.\n");
             exit(1);
         }
 
-        // Load the freshly generated bytecode directly from the struct
-        int size = 0;
-        unsigned char *code = load_bytecode(proc->bytecode_file, &size);
-        if (!code) {
+        // Map the freshly generated bytecode and start the VM on it
+        Program prog;
+        Heap *heap = heap_create();
+        if (!heap || !vm_load(&prog, heap, proc->bytecode_file)) {
             fprintf(stderr, "Debugger Error: Could not load bytecode file %s\n", proc->bytecode_file);
             exit(1);
         }
-
-        // Initialize VM and start
-        Program prog;
-        vm_init(&prog, code, size);
+        vm_decode(&prog);
         debug_start(&prog);
 
         vm_free(&prog);
+        heap_destroy(heap);
         exit(0); 
 
     } else if (child_pid > 0) {
         /* --- PARENT PROCESS (The Shell) --- */
-        signal(SIGINT, SIG_IGN);
+        // give the shell's own handler back afterwards: it also stops `run` (vm_interrupt)
+        void (*shell_sigint)(int) = signal(SIGINT, SIG_IGN);
         waitpid(child_pid, NULL, 0);
         signal(SIGCHLD, handle_zoombi);
-        signal(SIGINT, sigint_handle); 
+        signal(SIGINT, shell_sigint);
 
         printf("[Shell] Debug session for PID %d ended.\n", pid);
     } else {
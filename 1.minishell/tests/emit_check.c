@@ -0,0 +1,106 @@
+/*
+ * Checks the compiler's direct bytecode backend against the text pipeline:
+ * every program is compiled to assembly and assembled, then compiled straight
+ * to a container, and the two code sections must match byte for byte (or both
+ * compiles must fail). run_parser writes output.asm / output.byc into the
+ * current directory; `make test` runs this from tests/.
+ */
+#include "lab_parser.h"
+#include "assembler_c/assembler.h"
+#include "byc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+static int read_u32(const unsigned char *p) {
+    return (int)((unsigned)p[0] | (unsigned)p[1] << 8 | (unsigned)p[2] << 16 | (unsigned)p[3] << 24);
+}
+
+/* the code section of a container file, copied into code; 0 if unreadable */
+static int code_section(const char *file, ByteBuf *code) {
+    FILE *in = fopen(file, "rb");
+    if (!in) return 0;
+    ByteBuf img = { 0 };
+    int ch;
+    while ((ch = fgetc(in)) != EOF) bytebuf_put(&img, ch);
+    fclose(in);
+
+    int found = 0;
+    if (!img.failed && img.size >= BYC_HEADER_SIZE) {
+        int sections = img.data[10] | img.data[11] << 8;
+        for (int i = 0; i < sections && !found; i++) {
+            int at = BYC_HEADER_SIZE + i * BYC_SECTION_SIZE;
+            if (at + BYC_SECTION_SIZE > img.size) break;
+            int off = read_u32(img.data + at + 4), len = read_u32(img.data + at + 8);
+            if (read_u32(img.data + at) != BYC_SEC_CODE || off < 0 || len < 0 || off > img.size - len) continue;
+            for (int k = 0; k < len; k++) bytebuf_put(code, img.data[off + k]);
+            found = !code->failed;
+        }
+    }
+    free(img.data);
+    return found;
+}
+
+/* the compiler and assembler narrate every step; keep only our verdicts */
+static int quiet_begin(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    if (null >= 0) {
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+    return saved;
+}
+
+static void quiet_end(int saved) {
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+static int check(const char *src) {
+    ByteBuf text = { 0 }, direct = { 0 };
+    remove("output.asm");
+    remove("output.byc");
+    remove("text.byc");
+
+    int saved = quiet_begin();
+    int text_rc = run_parser(src, 0, PARSER_EMIT_ASM) != 0 || assemble("output.asm", "text.byc") != 0;
+    int direct_rc = run_parser(src, 0, PARSER_EMIT_BYC) != 0;
+    quiet_end(saved);
+
+    int ok;
+    if (text_rc || direct_rc) {
+        ok = text_rc == direct_rc;
+        printf("%s: %s (%s)\n", ok ? "PASS" : "FAIL", src,
+               ok ? "rejected by both" : text_rc ? "only the text pipeline failed" : "only the direct backend failed");
+    } else if (!code_section("text.byc", &text) || !code_section("output.byc", &direct)) {
+        ok = 0;
+        printf("FAIL: %s (unreadable container)\n", src);
+    } else {
+        ok = text.size == direct.size && memcmp(text.data, direct.data, (size_t)text.size) == 0;
+        printf("%s: %s (%d code bytes)\n", ok ? "PASS" : "FAIL", src, direct.size);
+    }
+
+    free(text.data);
+    free(direct.data);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!check(argv[i])) failed = 1;
+    }
+    remove("output.asm");
+    remove("output.byc");
+    remove("text.byc");
+
+    printf(failed ? "Emitter check failed.\n" : "Direct backend matches the text pipeline.\n");
+    return failed;
+}
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+# Ctrl-C must stop a job that `run` executes inside the shell, also after a
+# `debug` session (which swaps the SIGINT handler while the debugger runs).
+# usage: sigint_check.sh <mini-shell>
+set -u
+
+SHELL_BIN="$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+tmp_dir="$(mktemp -d)"
+trap 'exec 3>&-; kill "$shell_pid" 2>/dev/null; rm -rf "$tmp_dir"' EXIT
+
+printf 'var i = 0;\nwhile (1)\n    i = i + 1;\n' > "$tmp_dir/forever.txt"
+mkfifo "$tmp_dir/in"
+
+cd "$tmp_dir"
+"$SHELL_BIN" <"$tmp_dir/in" >"$tmp_dir/out" 2>&1 &
+shell_pid=$!
+exec 3>"$tmp_dir/in"
+
+send() {
+    echo "$1" >&3
+    sleep "${2:-0.5}"
+}
+
+send "submit $tmp_dir/forever.txt" 1
+send "debug 100"
+send "exit" 1
+send "run 100" 1
+kill -INT "$shell_pid"
+sleep 1
+send "exit" 1
+
+if kill -0 "$shell_pid" 2>/dev/null; then
+    echo "FAIL: shell still running; Ctrl-C did not stop the job after debug"
+    exit 1
+fi
+wait "$shell_pid"
+if ! grep -q "Debug session for PID 100 ended" "$tmp_dir/out"; then
+    echo "FAIL: debug session did not run"
+    exit 1
+fi
+if ! grep -q "error: interrupted" "$tmp_dir/out"; then
+    echo "FAIL: job was not interrupted"
+    exit 1
+fi
+echo "PASS: Ctrl-C stops run after debug"
@@ -5,9 +5,70 @@
 #include "ast.h"
 #include "../build/parser.tab.h"
 #include "symtab.h"
+#include "../../5.VM(ASS)withGC/assembler_c/assembler.h"
+
+/* opcodes, as assigned by the assembler's lookup_opcode */
+enum {
+    OP_PUSH = 0x01,
+    OP_ADD = 0x10, OP_SUB, OP_MUL, OP_DIV, OP_EQ, OP_NEQ, OP_LT, OP_GT, OP_LE, OP_GE,
+    OP_JMP = 0x20, OP_JZ, OP_JNZ,
+    OP_STORE = 0x30, OP_LOAD,
+    OP_HALT = 0xFF
+};
+
+static const char *mnemonic(int op) {
+    switch (op) {
+        case OP_PUSH:  return "PUSH";
+        case OP_ADD:   return "ADD";
+        case OP_SUB:   return "SUB";
+        case OP_MUL:   return "MUL";
+        case OP_DIV:   return "DIV";
+        case OP_EQ:    return "EQ";
+        case OP_NEQ:   return "NEQ";
+        case OP_LT:    return "LT";
+        case OP_GT:    return "GT";
+        case OP_LE:    return "LE";
+        case OP_GE:    return "GE";
+        case OP_JMP:   return "JMP";
+        case OP_JZ:    return "JZ";
+        case OP_JNZ:   return "JNZ";
+        case OP_STORE: return "STORE";
+        case OP_LOAD:  return "LOAD";
+        default:       return "HALT";
+    }
+}
+
+static int is_jump(int op) {
+    return op == OP_JMP || op == OP_JZ || op == OP_JNZ;
+}
+
+static int has_operand(int op) {
+    return op == OP_PUSH || op == OP_STORE || op == OP_LOAD || is_jump(op);
+}
 
 static int label_counter = 0;
-static FILE *out_file = NULL;
+
+/* --- OUTPUTS: either or both may be set --- */
+static FILE *out_file = NULL;       /* text assembly */
+static ByteBuf *out_code = NULL;    /* bytecode */
+static ByteBuf out_lines;           /* (code offset, source line) pairs */
+static ByteBuf out_symbols;         /* label names */
+
+/* --- LABELS (bytecode): address by id, -1 until placed --- */
+static int *label_addr = NULL;
+static int label_cap = 0;
+
+/* jumps emitted before their label, patched once it is placed */
+typedef struct {
+    int at;      /* offset of the 4-byte operand */
+    int label;
+} Patch;
+
+static Patch *patches = NULL;
+static int patch_count = 0;
+static int patch_cap = 0;
+
+static int current_line = 0;        /* source line of the node being generated */
 
 /* --- SYMBOL TABLE STATE --- */
 static SymTab *current_scope = NULL;
@@ -16,41 +77,79 @@ static int global_stack_index = 0;
 /* --- ADDRESS TRACKING STATE --- */
 static int current_pc = 0; 
 
+static void *realloc_or_die(void *mem, size_t size) {
+    mem = realloc(mem, size);
+    if (!mem) {
+        fprintf(stderr, "Error: out of memory\n");
+        exit(1);
+    }
+    return mem;
+}
+
 static int new_label() {
-    return ++label_counter;
+    ++label_counter;
+    if (out_code) {
+        if (label_counter >= label_cap) {
+            label_cap = label_cap ? label_cap * 2 : 64;
+            label_addr = realloc_or_die(label_addr, (size_t)label_cap * sizeof(int));
+        }
+        label_addr[label_counter] = -1;
+    }
+    return label_counter;
 }
 
+static void put_int32_at(ByteBuf *b, int at, int val) {
+    for (int i = 0; i < 4; i++) b->data[at + i] = (unsigned char)(val >> (8 * i));
+}
 
-static void emit(const char *instr, int val, const char *comment) {
-   //instruction size is calculated based on instruction type
-    int size = 0;
-    if (strcmp(instr, "JMP") == 0 || strcmp(instr, "JZ") == 0 || strcmp(instr, "JNZ") == 0 ||
-        strcmp(instr, "PUSH") == 0 || strcmp(instr, "STORE") == 0 || strcmp(instr, "LOAD") == 0) {
-        size = 5; // Opcode (1) + Operand (4)
-    } else {
-        size = 1; // Opcode only (ADD, SUB, HALT, etc.)
-    }
+// Jumps take a label id as val; instructions without an operand ignore it.
+static void emit(int op, int val, const char *comment) {
+    int size = has_operand(op) ? 5 : 1; // Opcode (1) + Operand (4)
 
-    //Print Instruction
-    if (strcmp(instr, "JMP") == 0 || strcmp(instr, "JZ") == 0 || strcmp(instr, "JNZ") == 0) {
-        fprintf(out_file, "%s L%03d", instr, val);
-    } 
-    else if (val == -1) {
-        fprintf(out_file, "%s", instr);
-    } 
-    else {
-        fprintf(out_file, "%s %d", instr, val);
+    if (out_file) {
+        //Print Instruction
+        if (is_jump(op)) {
+            fprintf(out_file, "%s L%03d", mnemonic(op), val);
+        } 
+        else if (!has_operand(op)) {
+            fprintf(out_file, "%s", mnemonic(op));
+        } 
+        else {
+            fprintf(out_file, "%s %d", mnemonic(op), val);
+        }
+        
+        // Print Address Comment
+        fprintf(out_file, "\t\t; Address %d", current_pc);
+        
+        // Add custom comment if exists
+        if (comment) {
+            fprintf(out_file, " (%s)", comment);
+        }
+        
+        fprintf(out_file, "\n");
     }
-    
-    // Print Address Comment
-    fprintf(out_file, "\t\t; Address %d", current_pc);
-    
-    // Add custom comment if exists
-    if (comment) {
-        fprintf(out_file, " (%s)", comment);
+
+    if (out_code) {
+        bytebuf_put_int32(&out_lines, current_pc);
+        bytebuf_put_int32(&out_lines, current_line);
+
+        bytebuf_put(out_code, op);
+        if (is_jump(op) && label_addr[val] == -1) {
+            // Forward jump: the label is not placed yet
+            if (patch_count == patch_cap) {
+                patch_cap = patch_cap ? patch_cap * 2 : 64;
+                patches = realloc_or_die(patches, (size_t)patch_cap * sizeof(Patch));
+            }
+            patches[patch_count].at = out_code->size;
+            patches[patch_count].label = val;
+            patch_count++;
+            bytebuf_put_int32(out_code, 0);
+        } else if (is_jump(op)) {
+            bytebuf_put_int32(out_code, label_addr[val]);
+        } else if (has_operand(op)) {
+            bytebuf_put_int32(out_code, val);
+        }
     }
-    
-    fprintf(out_file, "\n");
 
     // Update PC for next instruction
     current_pc += size;
@@ -58,12 +157,26 @@ static void emit(const char *instr, int val, const char *comment) {
 
 static void emit_label(int label_id) {
     // Labels occupy 0 bytes, so we don't increment current_pc
-    fprintf(out_file, "L%03d:\n", label_id);
+    if (out_file) {
+        fprintf(out_file, "L%03d:\n", label_id);
+    }
+
+    if (out_code) {
+        char name[16];
+        snprintf(name, sizeof(name), "L%03d", label_id);
+        bytebuf_put_int32(&out_symbols, current_pc);
+        for (const char *c = name; ; c++) {
+            bytebuf_put(&out_symbols, *c);
+            if (!*c) break;
+        }
+        label_addr[label_id] = current_pc;
+    }
 }
 
 // --- Recursive Traversal ---
 static void gen(ASTNode *node) {
     if (!node) return;
+    if (node->line > 0) current_line = node->line;
 
     switch (node->type) {
         case AST_PROGRAM:
@@ -86,7 +199,7 @@ static void gen(ASTNode *node) {
             if (node->as.var_decl.init) {
                 gen(node->as.var_decl.init);
             } else {
-                emit("PUSH", 0, "default init");
+                emit(OP_PUSH, 0, "default init");
             }
 
             int slot = global_stack_index++;
@@ -94,7 +207,7 @@ static void gen(ASTNode *node) {
                 fprintf(stderr, "Error: Redeclaration of '%s'\n", node->as.var_decl.name);
             }
             symtab_set(current_scope, node->as.var_decl.name, slot);
-            emit("STORE", slot, node->as.var_decl.name);
+            emit(OP_STORE, slot, node->as.var_decl.name);
             break;
 
         case AST_ASSIGN:
@@ -104,11 +217,11 @@ static void gen(ASTNode *node) {
                  fprintf(stderr, "Error: Undeclared variable '%s'\n", node->as.assign.name);
                  assign_slot = 0; 
             }
-            emit("STORE", assign_slot, node->as.assign.name);
+            emit(OP_STORE, assign_slot, node->as.assign.name);
             break;
 
         case AST_INT:
-            emit("PUSH", node->as.int_lit.value, NULL);
+            emit(OP_PUSH, node->as.int_lit.value, NULL);
             break;
 
         case AST_IDENT:
@@ -117,23 +230,23 @@ static void gen(ASTNode *node) {
                  fprintf(stderr, "Error: Undeclared variable '%s'\n", node->as.ident.name);
                  load_slot = 0;
             }
-            emit("LOAD", load_slot, node->as.ident.name);
+            emit(OP_LOAD, load_slot, node->as.ident.name);
             break;
 
         case AST_BINOP:
             gen(node->as.binop.left);
             gen(node->as.binop.right);
             switch (node->as.binop.op) {
-                case '+': emit("ADD", -1, NULL); break;
-                case '-': emit("SUB", -1, NULL); break;
-                case '*': emit("MUL", -1, NULL); break;
-                case '/': emit("DIV", -1, NULL); break;
-                case '<': emit("LT", -1, NULL); break;
-                case '>': emit("GT", -1, NULL); break;
-                case LE:  emit("LE", -1, NULL); break;
-                case GE:  emit("GE", -1, NULL); break;
-                case EQ:  emit("EQ", -1, NULL); break;
-                case NEQ: emit("NEQ", -1, NULL); break;
+                case '+': emit(OP_ADD, -1, NULL); break;
+                case '-': emit(OP_SUB, -1, NULL); break;
+                case '*': emit(OP_MUL, -1, NULL); break;
+                case '/': emit(OP_DIV, -1, NULL); break;
+                case '<': emit(OP_LT, -1, NULL); break;
+                case '>': emit(OP_GT, -1, NULL); break;
+                case LE:  emit(OP_LE, -1, NULL); break;
+                case GE:  emit(OP_GE, -1, NULL); break;
+                case EQ:  emit(OP_EQ, -1, NULL); break;
+                case NEQ: emit(OP_NEQ, -1, NULL); break;
             }
             break;
 
@@ -141,9 +254,9 @@ static void gen(ASTNode *node) {
             int L_else = new_label();
             int L_end  = new_label();
             gen(node->as.if_stmt.cond);
-            emit("JZ", L_else, "if false jump");
+            emit(OP_JZ, L_else, "if false jump");
             gen(node->as.if_stmt.then_branch);
-            emit("JMP", L_end, "jump over else");
+            emit(OP_JMP, L_end, "jump over else");
             emit_label(L_else);
             if (node->as.if_stmt.else_branch) {
                 gen(node->as.if_stmt.else_branch);
@@ -157,9 +270,9 @@ static void gen(ASTNode *node) {
             int L_end   = new_label();
             emit_label(L_start);
             gen(node->as.while_stmt.cond);
-            emit("JZ", L_end, "exit loop");
+            emit(OP_JZ, L_end, "exit loop");
             gen(node->as.while_stmt.body);
-            emit("JMP", L_start, "loop back");
+            emit(OP_JMP, L_start, "loop back");
             emit_label(L_end);
             break;
         }
@@ -169,27 +282,88 @@ static void gen(ASTNode *node) {
     }
 }
 
-void generate_asm(ASTNode *root, const char *filename) {
-    out_file = fopen(filename, "w");
-    if (!out_file) {
-        perror("Failed to open output .asm file");
-        return;
-    }
-
-    // Reset State
+// Reset State and walk the tree into whichever outputs are set
+static void generate(ASTNode *root) {
     label_counter = 0;
     global_stack_index = 0;
     current_scope = NULL;
+    current_line = 0;
+    patch_count = 0;
     
     // Reset PC to 0 for new file
     current_pc = 0;
 
+    gen(root);
+
+    emit(OP_HALT, -1, NULL);
+}
+
+void generate_asm(ASTNode *root, const char *filename) {
+    out_file = fopen(filename, "w");
+    if (!out_file) {
+        perror("Failed to open output .asm file");
+        return;
+    }
+
     printf("[IR] Generating assembly to %s ...\n", filename);
     
-    gen(root);
+    generate(root);
 
-    emit("HALT", -1, NULL);
     fclose(out_file);
+    out_file = NULL;
     printf("[IR] Done.\n");
 }
 
+int generate_bytecode(ASTNode *root, const char *filename, const char *asm_filename) {
+    ByteBuf code = { 0 }, container = { 0 };
+
+    if (asm_filename) {
+        out_file = fopen(asm_filename, "w");
+        if (!out_file) {
+            perror("Failed to open output .asm file");
+            return 1;
+        }
+    }
+    out_code = &code;
+    out_lines.size = 0;
+    out_lines.failed = 0;
+    out_symbols.size = 0;
+    out_symbols.failed = 0;
+
+    printf("[IR] Generating bytecode to %s ...\n", filename);
+
+    generate(root);
+
+    int failed = code.failed || out_lines.failed || out_symbols.failed;
+    if (failed) {
+        fprintf(stderr, "Error: out of memory\n");
+    } else {
+        // Backpatch forward jumps now that every label is placed
+        for (int i = 0; i < patch_count; i++) {
+            put_int32_at(&code, patches[i].at, label_addr[patches[i].label]);
+        }
+        failed = assemble_container(&code, &out_lines, &out_symbols, &container) != 0;
+    }
+
+    if (out_file) {
+        fclose(out_file);
+        out_file = NULL;
+    }
+    out_code = NULL;
+    if (failed) {
+        free(code.data);
+        return 1;
+    }
+
+    FILE *out = fopen(filename, "wb");
+    int written = out ? (int)fwrite(container.data, 1, (size_t)container.size, out) : 0;
+    failed = !out || fclose(out) != 0 || written != container.size;
+    if (failed) {
+        perror("Failed to write output .byc file");
+    } else {
+        printf("[IR] Done (%d bytes).\n", container.size);
+    }
+    free(code.data);
+    free(container.data);
+    return failed;
+}
@@ -8,4 +8,9 @@
 // filename: The output file name (e.g., "output.asm")
 void generate_asm(ASTNode *root, const char *filename);
 
+// Emits a .byc container straight from the AST, with no assembly text in
+// between; asm_filename (may be NULL) also gets the text, as a debug artifact.
+// Returns 0 on success.
+int generate_bytecode(ASTNode *root, const char *filename, const char *asm_filename);
+
 #endif
\ No newline at end of file
@@ -2,8 +2,13 @@
 #ifndef LAB_PARSER_H
 #define LAB_PARSER_H
 
+// What run_parser writes to the current directory
+#define PARSER_EMIT_ASM 0x1   // output.asm: text assembly
+#define PARSER_EMIT_BYC 0x2   // output.byc: bytecode, generated without the assembler
+
 // This function will parse the given filename and print the AST.
+// emit is a mask of PARSER_EMIT_*; 0 means PARSER_EMIT_ASM.
 // Returns 0 on success, non-zero on failure.
-int run_parser(const char *filename, int do_eval);
+int run_parser(const char *filename, int do_eval, int emit);
 
 #endif
\ No newline at end of file
@@ -101,7 +101,7 @@ extern ASTNode *root;
 extern int yylineno;
 extern void yyrestart(FILE *input_file); // Needed to reset lexer
 
-int run_parser(const char *filename, int do_eval) {
+int run_parser(const char *filename, int do_eval, int emit) {
     // 1. Reset Globals (Crucial for repeated calls)
     root = NULL;
     yylineno = 1;
@@ -120,6 +120,7 @@ int run_parser(const char *filename, int do_eval) {
     // 4. Parse
     int rc = yyparse();
     int eval_rc = 0;
+    int gen_rc = 0;
     SymTab *globals = NULL;
 
     // 5. Process AST if successful
@@ -130,7 +131,12 @@ int run_parser(const char *filename, int do_eval) {
         }
         
         ast_pretty_print(root);
-        generate_asm(root, "output.asm");
+        if (emit & PARSER_EMIT_BYC) {
+            gen_rc = generate_bytecode(root, "output.byc",
+                                       (emit & PARSER_EMIT_ASM) ? "output.asm" : NULL);
+        } else {
+            generate_asm(root, "output.asm");
+        }
         
         if (do_eval && eval_rc == 0) {
             symtab_dump(globals);
@@ -145,5 +151,5 @@ int run_parser(const char *filename, int do_eval) {
         globals = symtab_pop(globals);
     }
 
-    return (rc == 0 && (!do_eval || eval_rc == 0)) ? 0 : 1;
+    return (rc == 0 && gen_rc == 0 && (!do_eval || eval_rc == 0)) ? 0 : 1;
 }
\ No newline at end of file
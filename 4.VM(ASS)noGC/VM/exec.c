@@ -5,19 +5,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-static int needs_operand(unsigned char op) {
-    /* instructions that carry a 4-byte operand */
-    return (
-        op == 0x01 ||  /* PUSH */
-        op == 0x20 ||  /* JMP */
-        op == 0x21 ||  /* JZ */
-        op == 0x22 ||  /* JNZ */
-        op == 0x30 ||  /* STORE */
-        op == 0x31 ||  /* LOAD */
-        op == 0x40     /* CALL */
-    );
-}
-
 static int read_int32(const unsigned char *code, int offset) {
     /* little-endian 4-byte integer */
     uint32_t b0 = (uint32_t)code[offset];
@@ -27,6 +14,233 @@ static int read_int32(const unsigned char *code, int offset) {
     return (int)(int32_t)(b0 | b1 | b2 | b3);
 }
 
+static int compare(unsigned char op, int a, int b) {
+    switch (op) {
+        case 0x14: return a == b;
+        case 0x15: return a != b;
+        case 0x16: return a < b;
+        case 0x17: return a > b;
+        case 0x18: return a <= b;
+        default:   return a >= b;
+    }
+}
+
+#if defined(VM_THREADED_DISPATCH) && defined(__GNUC__)
+
+static int jump_target(Program *p, int addr) {
+    if (addr < 0 || addr >= p->code_size) {
+        fprintf(stderr, "error: invalid jump address %d\n", addr);
+        exit(1);
+    }
+    return addr;
+}
+
+static int mem_index(int idx) {
+    if (idx < 0 || idx >= MEM_SIZE) {
+        fprintf(stderr, "error: invalid memory index %d\n", idx);
+        exit(1);
+    }
+    return idx;
+}
+
+static void stack_underflow(void) {
+    fprintf(stderr, "error: stack underflow\n");
+    exit(1);
+}
+
+static void stack_overflow(void) {
+    fprintf(stderr, "error: stack overflow\n");
+    exit(1);
+}
+
+/*
+ * Direct-threaded run loop (GCC labels-as-values). The jump table sends every
+ * opcode to its handler and each handler ends with its own indirect jump, so
+ * the branch predictor learns per-opcode successors instead of sharing one
+ * switch branch. Each handler knows its own width (no needs_operand()), and
+ * running off the end of the code hits the loader's zero pad byte, so
+ * pc < code_size is only checked on the invalid-opcode path.
+ *
+ * The top of the operand stack is cached in tos and the rest lives in a local
+ * array behind sp (stack[0] is a spill slot for the empty stack), so the
+ * arithmetic handlers neither call vm_push/vm_pop nor touch p->sp. The stack,
+ * memory index and jump checks only run when vm_validate could not prove the
+ * code with stack_flow; p->stack and p->sp are written back on exit.
+ */
+void vm_run(Program *p) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+    static void *const dispatch[256] = {
+        [0 ... 255] = &&op_invalid,
+        [0x01] = &&op_push,  [0x02] = &&op_pop,  [0x03] = &&op_dup,
+        [0x10] = &&op_add,   [0x11] = &&op_sub,  [0x12] = &&op_mul,  [0x13] = &&op_div,
+        [0x14] = &&op_eq,    [0x15] = &&op_neq,  [0x16] = &&op_lt,
+        [0x17] = &&op_gt,    [0x18] = &&op_le,   [0x19] = &&op_ge,
+        [0x20] = &&op_jmp,   [0x21] = &&op_jz,   [0x22] = &&op_jnz,
+        [0x30] = &&op_store, [0x31] = &&op_load,
+        [0x40] = &&op_call,  [0x41] = &&op_ret,
+        [OP_LOAD_LOAD_ADD] = &&op_load_load_add, [OP_ADDI] = &&op_addi,
+        [OP_CMP_JZ] = &&op_cmp_jz,               [OP_INC_MEM] = &&op_inc_mem,
+        [0xFF] = &&op_halt,
+    };
+#pragma GCC diagnostic pop
+    const unsigned char *code = p->code;
+    const int checked = !p->depth_proven;
+    int pc = p->pc;
+    int a, b;
+
+    int stack[STACK_MAX + 1];
+    int *sp = stack + p->sp;   /* depth = sp - stack; stack[i + 1] holds slot i */
+    int tos = 0;
+    stack[0] = 0;
+    for (int i = 0; i + 1 < p->sp; i++) stack[i + 1] = p->stack[i];
+    if (p->sp > 0) tos = p->stack[p->sp - 1];
+
+#define DISPATCH()     do { p->instr_count++; goto *dispatch[code[pc]]; } while (0)
+#define NEXT(width)    do { pc += (width); DISPATCH(); } while (0)
+#define OPERAND()      read_int32(code, pc + 1)
+#define NEED(n)        do { if (checked && sp - stack < (n)) stack_underflow(); } while (0)
+#define ROOM()         do { if (checked && sp - stack >= STACK_MAX) stack_overflow(); } while (0)
+#define PUSH(value)    do { ROOM(); *sp++ = tos; tos = (value); } while (0)
+#define DROP()         (tos = *--sp)
+#define MEM(idx)       (checked ? mem_index(idx) : (idx))
+#define TARGET(addr)   (checked ? jump_target(p, addr) : (addr))
+#define BINARY(expr)   do { NEED(2); b = tos; a = *--sp; tos = (expr); NEXT(1); } while (0)
+
+    DISPATCH();
+
+op_push:  PUSH(OPERAND()); NEXT(5);
+op_pop:   NEED(1); DROP(); NEXT(1);
+op_dup:   NEED(1); PUSH(tos); NEXT(1);
+
+op_add:   BINARY(a + b);
+op_sub:   BINARY(a - b);
+op_mul:   BINARY(a * b);
+op_div:
+    NEED(2);
+    b = tos;
+    a = *--sp;
+    if (b == 0) {
+        fprintf(stderr, "error: division by zero\n");
+        exit(1);
+    }
+    tos = a / b;
+    NEXT(1);
+op_eq:    BINARY(a == b);
+op_neq:   BINARY(a != b);
+op_lt:    BINARY(a < b);
+op_gt:    BINARY(a > b);
+op_le:    BINARY(a <= b);
+op_ge:    BINARY(a >= b);
+
+op_jmp:
+    pc = TARGET(OPERAND());
+    DISPATCH();
+op_jz:
+    NEED(1);
+    a = tos;
+    DROP();
+    if (a == 0) { pc = TARGET(OPERAND()); DISPATCH(); }
+    NEXT(5);
+op_jnz:
+    NEED(1);
+    a = tos;
+    DROP();
+    if (a != 0) { pc = TARGET(OPERAND()); DISPATCH(); }
+    NEXT(5);
+
+op_store: NEED(1); p->memory[MEM(OPERAND())] = tos; DROP(); NEXT(5);
+op_load:  PUSH(p->memory[MEM(OPERAND())]); NEXT(5);
+
+op_call:
+    a = TARGET(OPERAND());
+    vm_push_ret(p, pc + 5);
+    pc = a;
+    DISPATCH();
+op_ret:
+    pc = vm_pop_ret(p);
+    DISPATCH();
+
+op_load_load_add:
+    a = p->memory[MEM(OPERAND())];
+    b = p->memory[MEM(read_int32(code, pc + 6))];
+    PUSH(a + b);
+    NEXT(11);
+op_addi:  NEED(1); tos += OPERAND(); NEXT(6);
+op_cmp_jz:
+    NEED(2);
+    b = tos;
+    a = *--sp;
+    DROP();
+    if (!compare(code[pc + 1], a, b)) { pc = TARGET(read_int32(code, pc + 2)); DISPATCH(); }
+    NEXT(6);
+op_inc_mem:
+    a = MEM(OPERAND());
+    p->memory[a] += read_int32(code, pc + 6);
+    NEXT(16);
+
+op_halt:
+    p->pc = pc + 1;
+    printf("Instruction count: %d\n", p->instr_count);
+    goto done;
+
+op_invalid:
+    if (pc >= p->code_size) {   /* ran off the end: stop like the switch loop */
+        p->instr_count--;
+        p->pc = pc;
+        goto done;
+    }
+    fprintf(stderr, "error: invalid opcode 0x%x at pc=%d\n", code[pc], pc);
+    exit(1);
+
+done:
+    p->sp = (int)(sp - stack);
+    for (int i = 0; i + 1 < p->sp; i++) p->stack[i] = stack[i + 1];
+    if (p->sp > 0) p->stack[p->sp - 1] = tos;
+
+#undef DISPATCH
+#undef NEXT
+#undef OPERAND
+#undef NEED
+#undef ROOM
+#undef PUSH
+#undef DROP
+#undef MEM
+#undef TARGET
+#undef BINARY
+}
+
+#else /* portable switch dispatch */
+
+static int instr_width(unsigned char op) {
+    switch (op) {
+        /* instructions that carry a 4-byte operand */
+        case 0x01:  /* PUSH */
+        case 0x20:  /* JMP */
+        case 0x21:  /* JZ */
+        case 0x22:  /* JNZ */
+        case 0x30:  /* STORE */
+        case 0x31:  /* LOAD */
+        case 0x40:  /* CALL */
+            return 5;
+        /* superinstructions keep the length of what they replaced */
+        case OP_LOAD_LOAD_ADD: return 11;
+        case OP_ADDI:          return 6;
+        case OP_CMP_JZ:        return 6;
+        case OP_INC_MEM:       return 16;
+        default:
+            return 1;
+    }
+}
+
+static int mem_index(int idx) {
+    if (idx < 0 || idx >= MEM_SIZE) {
+        fprintf(stderr, "error: invalid memory index %d\n", idx);
+        exit(1);
+    }
+    return idx;
+}
+
 void vm_run(Program *p) {
    
     while (p->pc < p->code_size) {
@@ -38,10 +252,7 @@ void vm_run(Program *p) {
         p->instr_count++;
 
         
-        if (needs_operand(op))
-            p->pc = pc + 5;
-        else
-            p->pc = pc + 1;
+        p->pc = pc + instr_width(op);
 
         switch (op) {
             case 0x01: { /* PUSH */
@@ -188,6 +399,33 @@ void vm_run(Program *p) {
                 p->pc = vm_pop_ret(p);
                 break;
             }
+            case OP_LOAD_LOAD_ADD: {
+                int a = p->memory[mem_index(read_int32(p->code, pc + 1))];
+                int b = p->memory[mem_index(read_int32(p->code, pc + 6))];
+                vm_push(p, a + b);
+                break;
+            }
+            case OP_ADDI:
+                vm_push(p, vm_pop(p) + read_int32(p->code, pc + 1));
+                break;
+            case OP_CMP_JZ: {
+                int b = vm_pop(p);
+                int a = vm_pop(p);
+                if (!compare(p->code[pc + 1], a, b)) {
+                    int addr = read_int32(p->code, pc + 2);
+                    if (addr < 0 || addr >= p->code_size) {
+                        fprintf(stderr, "error: invalid jump address %d\n", addr);
+                        exit(1);
+                    }
+                    p->pc = addr;
+                }
+                break;
+            }
+            case OP_INC_MEM: {
+                int idx = mem_index(read_int32(p->code, pc + 1));
+                p->memory[idx] += read_int32(p->code, pc + 6);
+                break;
+            }
             case 0xFF: /* HALT */
                 printf("Instruction count: %d\n", p->instr_count);
                 return;
@@ -197,3 +435,5 @@ void vm_run(Program *p) {
         }
     }
 }
+
+#endif /* VM_THREADED_DISPATCH */
@@ -0,0 +1,185 @@
+#include "flow.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+static int read_int32(const unsigned char *code, int offset) {
+    /* little-endian 4-byte integer */
+    uint32_t b0 = (uint32_t)code[offset];
+    uint32_t b1 = (uint32_t)code[offset + 1] << 8;
+    uint32_t b2 = (uint32_t)code[offset + 2] << 16;
+    uint32_t b3 = (uint32_t)code[offset + 3] << 24;
+    return (int)(int32_t)(b0 | b1 | b2 | b3);
+}
+
+static int needs_operand(unsigned char op) {
+    return (op == 0x01 || op == 0x20 || op == 0x21 || op == 0x22 ||
+            op == 0x30 || op == 0x31 || op == 0x40);
+}
+
+static int is_binary(unsigned char op) {
+    return op >= 0x10 && op <= 0x19;   /* ADD .. GE */
+}
+
+static void *alloc_or_die(size_t count, size_t size) {
+    void *mem = calloc(count ? count : 1, size);
+    if (!mem) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+    return mem;
+}
+
+/*
+ * Worklist pass computing the stack depth before every reachable
+ * instruction and the function (CALL target) it runs in. A CALL continues
+ * at its return site with the depth its callee has at RET.
+ */
+typedef struct {
+    const unsigned char *code;
+    int size;
+    int *depth;
+    int *func;
+    int *ret_depth;     /* indexed by function entry address */
+    int *work;
+    int work_count;
+    const char *error;
+    int error_pc;
+} Flow;
+
+static int flow_fail(Flow *f, const char *why, int pc) {
+    if (!f->error) {
+        f->error = why;
+        f->error_pc = pc;
+    }
+    return 0;
+}
+
+static int flow_reach(Flow *f, int pc, int depth, int func, int from) {
+    if (pc < 0 || pc >= f->size) return flow_fail(f, "invalid jump address", from);
+
+    if (f->depth[pc] == FLOW_UNKNOWN) {
+        f->depth[pc] = depth;
+        f->func[pc] = func;
+        f->work[f->work_count++] = pc;
+        return 1;
+    }
+    if (f->depth[pc] != depth || f->func[pc] != func) {
+        return flow_fail(f, "stack depth differs between paths", pc);
+    }
+    return 1;
+}
+
+/* fall through to pc; running off the end is allowed */
+static int flow_next(Flow *f, int pc, int depth, int func) {
+    if (pc >= f->size) return 1;
+    return flow_reach(f, pc, depth, func, pc);
+}
+
+static int flow_step(Flow *f, int pc) {
+    const unsigned char *code = f->code;
+    unsigned char op = code[pc];
+    int d = f->depth[pc];
+    int fn = f->func[pc];
+    int width = needs_operand(op) ? 5 : 1;
+    int arg = 0;
+
+    if (pc + width > f->size) return flow_fail(f, "truncated instruction", pc);
+    if (width == 5) arg = read_int32(code, pc + 1);
+
+    switch (op) {
+        case 0x01: /* PUSH */
+        case 0x03: /* DUP */
+        case 0x31: /* LOAD */
+            if (op == 0x03 && d < 1) return flow_fail(f, "stack underflow", pc);
+            if (op == 0x31 && (arg < 0 || arg >= MEM_SIZE)) return flow_fail(f, "invalid memory index", pc);
+            if (d + 1 > STACK_MAX) return flow_fail(f, "stack overflow", pc);
+            return flow_next(f, pc + width, d + 1, fn);
+
+        case 0x02: /* POP */
+        case 0x30: /* STORE */
+            if (d < 1) return flow_fail(f, "stack underflow", pc);
+            if (op == 0x30 && (arg < 0 || arg >= MEM_SIZE)) return flow_fail(f, "invalid memory index", pc);
+            return flow_next(f, pc + width, d - 1, fn);
+
+        case 0x20: /* JMP */
+            return flow_reach(f, arg, d, fn, pc);
+
+        case 0x21: /* JZ */
+        case 0x22: /* JNZ */
+            if (d < 1) return flow_fail(f, "stack underflow", pc);
+            return flow_reach(f, arg, d - 1, fn, pc) && flow_next(f, pc + 5, d - 1, fn);
+
+        case 0x40: /* CALL */
+            if (!flow_reach(f, arg, d, arg, pc)) return 0;
+            if (f->ret_depth[arg] != FLOW_UNKNOWN) return flow_next(f, pc + 5, f->ret_depth[arg], fn);
+            return 1;
+
+        case 0x41: /* RET */
+            if (fn == FLOW_TOP_LEVEL) return flow_fail(f, "RET outside a function", pc);
+            if (f->ret_depth[fn] != FLOW_UNKNOWN) {
+                return f->ret_depth[fn] == d ? 1 : flow_fail(f, "function returns with different depths", pc);
+            }
+            f->ret_depth[fn] = d;
+
+            /* resume every call site already seen */
+            for (int q = 0; q + 5 <= f->size; q++) {
+                if (f->depth[q] != FLOW_UNKNOWN && code[q] == 0x40 && read_int32(code, q + 1) == fn) {
+                    if (!flow_next(f, q + 5, d, f->func[q])) return 0;
+                }
+            }
+            return 1;
+
+        case 0xFF: /* HALT */
+            return 1;
+
+        default:
+            if (is_binary(op)) {
+                if (d < 2) return flow_fail(f, "stack underflow", pc);
+                return flow_next(f, pc + 1, d - 1, fn);
+            }
+            return flow_fail(f, "invalid opcode", pc);
+    }
+}
+
+int stack_flow(const Program *p, StackFlow *out) {
+    const unsigned char *code = p->code;
+    int size = p->code_size;
+
+    Flow f = { code, size, NULL, NULL, NULL, NULL, 0, NULL, 0 };
+    f.depth = alloc_or_die((size_t)size, sizeof(int));
+    f.func = alloc_or_die((size_t)size, sizeof(int));
+    f.ret_depth = alloc_or_die((size_t)size, sizeof(int));
+    f.work = alloc_or_die((size_t)size, sizeof(int));
+    for (int i = 0; i < size; i++) f.depth[i] = f.ret_depth[i] = FLOW_UNKNOWN;
+
+    if (size > 0) flow_reach(&f, 0, 0, FLOW_TOP_LEVEL, 0);
+    while (f.work_count > 0 && !f.error) {
+        flow_step(&f, f.work[--f.work_count]);
+    }
+
+    /* reached code must line up with the linear decoding */
+    for (int pc = 0, next = 0; pc < size && !f.error; pc++) {
+        if (pc < next) {
+            if (f.depth[pc] != FLOW_UNKNOWN) flow_fail(&f, "jump into an instruction", pc);
+            continue;
+        }
+        next = pc + (needs_operand(code[pc]) ? 5 : 1);
+    }
+
+    free(f.ret_depth);
+    free(f.work);
+    out->depth = f.depth;
+    out->func = f.func;
+    out->error = f.error;
+    out->error_pc = f.error_pc;
+    return f.error == NULL;
+}
+
+void stack_flow_free(StackFlow *f) {
+    free(f->depth);
+    free(f->func);
+    f->depth = NULL;
+    f->func = NULL;
+}
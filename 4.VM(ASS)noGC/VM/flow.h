@@ -0,0 +1,28 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+#include "vm.h"
+
+#define FLOW_UNKNOWN   (-1)   /* instruction not reached */
+#define FLOW_TOP_LEVEL (-1)   /* not inside any CALLed function */
+
+/*
+ * Static stack depths. stack_flow follows every path from address 0
+ * (through CALL/RET) and records the operand stack depth before each
+ * reachable instruction. It succeeds when every reachable instruction has
+ * one depth that fits in [needed, STACK_MAX], every LOAD/STORE index and
+ * jump target is valid, and no jump lands inside an instruction. Otherwise
+ * error and error_pc describe the first problem found.
+ */
+typedef struct {
+    int *depth;          /* per byte offset, FLOW_UNKNOWN if not reached */
+    int *func;           /* entry of the function it runs in, or FLOW_TOP_LEVEL */
+    const char *error;   /* NULL on success */
+    int error_pc;
+} StackFlow;
+
+/* fills f (release with stack_flow_free); returns 1 on success */
+int stack_flow(const Program *p, StackFlow *f);
+void stack_flow_free(StackFlow *f);
+
+#endif
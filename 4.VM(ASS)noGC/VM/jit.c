@@ -0,0 +1,431 @@
+#define _DEFAULT_SOURCE   /* MAP_ANONYMOUS */
+#include "jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+
+#include <sys/mman.h>
+
+/*
+ * Register use in generated code:
+ *   rdi  JitState*            rbx  &stack[0]        rbp  &stack[STACK_MAX]
+ *   r12  next free stack slot r13  memory           r14  call depth
+ *   r15  instruction count    eax/ecx/edx scratch
+ * The code never calls out, so rsp only holds the native return addresses.
+ */
+typedef struct {
+    int *stack;
+    int *stack_top;      /* in/out */
+    int *memory;
+    long count;          /* out */
+    void *saved_rsp;     /* rsp after the prologue, restored on exit */
+} JitState;
+
+/* exit status of the generated code (eax) */
+enum {
+    JIT_HALT,
+    JIT_END,             /* ran off the end of the code */
+    JIT_STACK_OVERFLOW,
+    JIT_STACK_UNDERFLOW,
+    JIT_DIV_ZERO,
+    JIT_CALL_OVERFLOW,
+    JIT_CALL_UNDERFLOW,
+    JIT_STATUS_COUNT
+};
+
+static const char *jit_errors[JIT_STATUS_COUNT] = {
+    [JIT_STACK_OVERFLOW]  = "stack overflow",
+    [JIT_STACK_UNDERFLOW] = "stack underflow",
+    [JIT_DIV_ZERO]        = "division by zero",
+    [JIT_CALL_OVERFLOW]   = "call stack overflow",
+    [JIT_CALL_UNDERFLOW]  = "call stack underflow",
+};
+
+struct JitCode {
+    unsigned char *code;  /* executable mapping */
+    size_t size;
+};
+
+/*    CODE BUFFER    */
+
+typedef struct {
+    int at;       /* offset of the rel32 field */
+    int target;   /* bytecode offset, or -1 - status for an exit stub */
+} Fixup;
+
+typedef struct {
+    unsigned char *buf;
+    int len, cap;
+    Fixup *fixups;
+    int fixup_count, fixup_cap;
+} Asm;
+
+static void *grow_or_die(void *array, int *cap, size_t elem) {
+    int new_cap = *cap ? *cap * 2 : 256;
+    void *grown = realloc(array, (size_t)new_cap * elem);
+    if (!grown) {
+        fprintf(stderr, "error: out of memory in JIT\n");
+        exit(1);
+    }
+    *cap = new_cap;
+    return grown;
+}
+
+static void put(Asm *a, const unsigned char *bytes, int n) {
+    while (a->len + n > a->cap) a->buf = grow_or_die(a->buf, &a->cap, 1);
+    memcpy(a->buf + a->len, bytes, (size_t)n);
+    a->len += n;
+}
+
+#define EMIT(a, ...) do { \
+        const unsigned char bytes_[] = { __VA_ARGS__ }; \
+        put((a), bytes_, (int)sizeof(bytes_)); \
+    } while (0)
+
+static void put32(Asm *a, int32_t v) {
+    unsigned char b[4] = { v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, ((uint32_t)v >> 24) & 0xFF };
+    put(a, b, 4);
+}
+
+/* rel32 filled in after all code is emitted */
+static void rel32_to(Asm *a, int target) {
+    if (a->fixup_count == a->fixup_cap) {
+        a->fixups = grow_or_die(a->fixups, &a->fixup_cap, sizeof(Fixup));
+    }
+    a->fixups[a->fixup_count++] = (Fixup){ a->len, target };
+    put32(a, 0);
+}
+
+#define STUB(status) (-1 - (status))
+
+/* jcc rel32 (cc = second opcode byte) to an exit stub */
+static void jcc_exit(Asm *a, unsigned char cc, int status) {
+    unsigned char op[2] = { 0x0F, cc };
+    put(a, op, 2);
+    rel32_to(a, STUB(status));
+}
+
+#define JB   0x82
+#define JAE  0x83
+#define JZ   0x84
+#define JNZ  0x85
+#define JBE  0x86
+
+/* at least n slots on the stack */
+static void need(Asm *a, int n) {
+    if (n == 1) {
+        EMIT(a, 0x49, 0x39, 0xDC);                 /* cmp r12, rbx */
+        jcc_exit(a, JBE, JIT_STACK_UNDERFLOW);
+    } else {
+        EMIT(a, 0x48, 0x8D, 0x43, (unsigned char)(4 * n)); /* lea rax, [rbx + 4n] */
+        EMIT(a, 0x49, 0x39, 0xC4);                 /* cmp r12, rax */
+        jcc_exit(a, JB, JIT_STACK_UNDERFLOW);
+    }
+}
+
+/* room for one more slot */
+static void room(Asm *a) {
+    EMIT(a, 0x49, 0x39, 0xEC);                     /* cmp r12, rbp */
+    jcc_exit(a, JAE, JIT_STACK_OVERFLOW);
+}
+
+static void push_eax(Asm *a) {
+    EMIT(a, 0x41, 0x89, 0x04, 0x24);               /* mov [r12], eax */
+    EMIT(a, 0x49, 0x83, 0xC4, 0x04);               /* add r12, 4 */
+}
+
+static void pop_eax(Asm *a) {
+    EMIT(a, 0x49, 0x83, 0xEC, 0x04);               /* sub r12, 4 */
+    EMIT(a, 0x41, 0x8B, 0x04, 0x24);               /* mov eax, [r12] */
+}
+
+static void exit_with(Asm *a, int status) {
+    EMIT(a, 0xB8);                                 /* mov eax, status */
+    put32(a, status);
+    EMIT(a, 0xE9);                                 /* jmp exit */
+    rel32_to(a, STUB(JIT_HALT));
+}
+
+/*    TRANSLATION    */
+
+static int read_int32(const unsigned char *code, int offset) {
+    /* little-endian 4-byte integer */
+    uint32_t b0 = (uint32_t)code[offset];
+    uint32_t b1 = (uint32_t)code[offset + 1] << 8;
+    uint32_t b2 = (uint32_t)code[offset + 2] << 16;
+    uint32_t b3 = (uint32_t)code[offset + 3] << 24;
+    return (int)(int32_t)(b0 | b1 | b2 | b3);
+}
+
+static int needs_operand(unsigned char op) {
+    return (op == 0x01 || op == 0x20 || op == 0x21 || op == 0x22 ||
+            op == 0x30 || op == 0x31 || op == 0x40);
+}
+
+/* setcc opcode byte for the compare opcodes 0x14 .. 0x19 */
+static const unsigned char setcc[6] = { 0x94, 0x95, 0x9C, 0x9F, 0x9E, 0x9D };
+
+static void emit_prologue(Asm *a) {
+    EMIT(a, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55,    /* push rbx, rbp, r12, r13, */
+            0x41, 0x56, 0x41, 0x57);               /*      r14, r15 */
+    EMIT(a, 0x48, 0x89, 0x67, offsetof(JitState, saved_rsp)); /* mov [rdi+..], rsp */
+    EMIT(a, 0x48, 0x8B, 0x5F, offsetof(JitState, stack));     /* mov rbx, [rdi+..] */
+    EMIT(a, 0x4C, 0x8B, 0x67, offsetof(JitState, stack_top)); /* mov r12, [rdi+..] */
+    EMIT(a, 0x4C, 0x8B, 0x6F, offsetof(JitState, memory));    /* mov r13, [rdi+..] */
+    EMIT(a, 0x48, 0x8D, 0xAB);                     /* lea rbp, [rbx + 4 * STACK_MAX] */
+    put32(a, 4 * STACK_MAX);
+    EMIT(a, 0x45, 0x31, 0xF6);                     /* xor r14d, r14d */
+    EMIT(a, 0x45, 0x31, 0xFF);                     /* xor r15d, r15d */
+}
+
+/* exit: status in eax; unwinds any native call frames */
+static void emit_epilogue(Asm *a) {
+    EMIT(a, 0x48, 0x8B, 0x67, offsetof(JitState, saved_rsp)); /* mov rsp, [rdi+..] */
+    EMIT(a, 0x4C, 0x89, 0x67, offsetof(JitState, stack_top)); /* mov [rdi+..], r12 */
+    EMIT(a, 0x4C, 0x89, 0x7F, offsetof(JitState, count));     /* mov [rdi+..], r15 */
+    EMIT(a, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D,    /* pop r15, r14, r13, */
+            0x41, 0x5C, 0x5D, 0x5B);               /*     r12, rbp, rbx */
+    EMIT(a, 0xC3);                                 /* ret */
+}
+
+static void emit_instruction(Asm *a, unsigned char op, int arg) {
+    EMIT(a, 0x49, 0xFF, 0xC7);                     /* inc r15 */
+
+    switch (op) {
+        case 0x01: /* PUSH */
+            room(a);
+            EMIT(a, 0x41, 0xC7, 0x04, 0x24);       /* mov dword [r12], imm32 */
+            put32(a, arg);
+            EMIT(a, 0x49, 0x83, 0xC4, 0x04);       /* add r12, 4 */
+            break;
+        case 0x02: /* POP */
+            need(a, 1);
+            EMIT(a, 0x49, 0x83, 0xEC, 0x04);       /* sub r12, 4 */
+            break;
+        case 0x03: /* DUP */
+            need(a, 1);
+            room(a);
+            EMIT(a, 0x41, 0x8B, 0x44, 0x24, 0xFC); /* mov eax, [r12-4] */
+            push_eax(a);
+            break;
+
+        case 0x10: case 0x11: case 0x12: case 0x13:
+        case 0x14: case 0x15: case 0x16: case 0x17: case 0x18: case 0x19:
+            need(a, 2);
+            EMIT(a, 0x41, 0x8B, 0x44, 0x24, 0xF8); /* mov eax, [r12-8] */
+            EMIT(a, 0x41, 0x8B, 0x4C, 0x24, 0xFC); /* mov ecx, [r12-4] */
+            if (op == 0x10) {
+                EMIT(a, 0x01, 0xC8);               /* add eax, ecx */
+            } else if (op == 0x11) {
+                EMIT(a, 0x29, 0xC8);               /* sub eax, ecx */
+            } else if (op == 0x12) {
+                EMIT(a, 0x0F, 0xAF, 0xC1);         /* imul eax, ecx */
+            } else if (op == 0x13) {
+                EMIT(a, 0x85, 0xC9);               /* test ecx, ecx */
+                jcc_exit(a, JZ, JIT_DIV_ZERO);
+                EMIT(a, 0x99, 0xF7, 0xF9);         /* cdq; idiv ecx */
+            } else {
+                unsigned char set[3] = { 0x0F, setcc[op - 0x14], 0xC0 };
+                EMIT(a, 0x39, 0xC8);               /* cmp eax, ecx */
+                put(a, set, 3);                    /* setcc al */
+                EMIT(a, 0x0F, 0xB6, 0xC0);         /* movzx eax, al */
+            }
+            EMIT(a, 0x41, 0x89, 0x44, 0x24, 0xF8); /* mov [r12-8], eax */
+            EMIT(a, 0x49, 0x83, 0xEC, 0x04);       /* sub r12, 4 */
+            break;
+
+        case 0x20: /* JMP */
+            EMIT(a, 0xE9);
+            rel32_to(a, arg);
+            break;
+        case 0x21: /* JZ */
+        case 0x22: /* JNZ */
+            need(a, 1);
+            pop_eax(a);
+            EMIT(a, 0x85, 0xC0, 0x0F, op == 0x21 ? JZ : JNZ); /* test eax, eax; jcc */
+            rel32_to(a, arg);
+            break;
+
+        case 0x30: /* STORE */
+            need(a, 1);
+            pop_eax(a);
+            EMIT(a, 0x41, 0x89, 0x85);             /* mov [r13 + 4 * idx], eax */
+            put32(a, 4 * arg);
+            break;
+        case 0x31: /* LOAD */
+            room(a);
+            EMIT(a, 0x41, 0x8B, 0x85);             /* mov eax, [r13 + 4 * idx] */
+            put32(a, 4 * arg);
+            push_eax(a);
+            break;
+
+        case 0x40: /* CALL */
+            EMIT(a, 0x49, 0x81, 0xFE);             /* cmp r14, STACK_MAX */
+            put32(a, STACK_MAX);
+            jcc_exit(a, JAE, JIT_CALL_OVERFLOW);
+            EMIT(a, 0x49, 0xFF, 0xC6);             /* inc r14 */
+            EMIT(a, 0xE8);                         /* call target */
+            rel32_to(a, arg);
+            break;
+        case 0x41: /* RET */
+            EMIT(a, 0x4D, 0x85, 0xF6);             /* test r14, r14 */
+            jcc_exit(a, JZ, JIT_CALL_UNDERFLOW);
+            EMIT(a, 0x49, 0xFF, 0xCE);             /* dec r14 */
+            EMIT(a, 0xC3);                         /* ret */
+            break;
+
+        case 0xFF: /* HALT */
+            exit_with(a, JIT_HALT);
+            break;
+    }
+}
+
+static int valid_opcode(unsigned char op) {
+    return op == 0x01 || op == 0x02 || op == 0x03 || (op >= 0x10 && op <= 0x19) ||
+           op == 0x20 || op == 0x21 || op == 0x22 || op == 0x30 || op == 0x31 ||
+           op == 0x40 || op == 0x41 || op == 0xFF;
+}
+
+static JitCode *jit_fail(const char *why, int pc, Asm *a, int *native) {
+    fprintf(stderr, "note: JIT unavailable (%s at pc=%d); using the interpreter\n", why, pc);
+    free(a->buf);
+    free(a->fixups);
+    free(native);
+    return NULL;
+}
+
+JitCode *jit_compile(Program *p) {
+    const unsigned char *code = p->code;
+    int size = p->code_size;
+    Asm a = { 0 };
+
+    /* native offset of each bytecode instruction, -1 inside one */
+    int *native = malloc(((size_t)size + 1) * sizeof(int));
+    if (!native) {
+        fprintf(stderr, "error: out of memory in JIT\n");
+        exit(1);
+    }
+    for (int i = 0; i <= size; i++) native[i] = -1;
+
+    emit_prologue(&a);
+
+    for (int pc = 0; pc < size; ) {
+        unsigned char op = code[pc];
+        int width = needs_operand(op) ? 5 : 1;
+        int arg = 0;
+
+        if (!valid_opcode(op)) return jit_fail("invalid opcode", pc, &a, native);
+        if (pc + width > size) return jit_fail("truncated instruction", pc, &a, native);
+        if (width == 5) arg = read_int32(code, pc + 1);
+        if ((op == 0x30 || op == 0x31) && (arg < 0 || arg >= MEM_SIZE)) {
+            return jit_fail("invalid memory index", pc, &a, native);
+        }
+
+        native[pc] = a.len;
+        emit_instruction(&a, op, arg);
+        pc += width;
+    }
+
+    /* falling off the end stops like the interpreter */
+    native[size] = a.len;
+    exit_with(&a, JIT_END);
+
+    int stub[JIT_STATUS_COUNT];
+    for (int s = JIT_STACK_OVERFLOW; s < JIT_STATUS_COUNT; s++) {
+        stub[s] = a.len;
+        EMIT(&a, 0xB8);                            /* mov eax, status */
+        put32(&a, s);
+        EMIT(&a, 0xE9);                            /* jmp exit */
+        rel32_to(&a, STUB(JIT_HALT));
+    }
+    stub[JIT_HALT] = a.len;                        /* the common exit */
+    emit_epilogue(&a);
+
+    for (int i = 0; i < a.fixup_count; i++) {
+        int target = a.fixups[i].target;
+        int dest;
+        if (target < 0) {
+            dest = stub[-1 - target];
+        } else if (target < size && native[target] >= 0) {
+            dest = native[target];
+        } else {
+            int pc = 0;   /* report the branch, not its target */
+            while (pc < size && native[pc] < a.fixups[i].at - 1) pc++;
+            while (pc > 0 && (native[pc] < 0 || native[pc] > a.fixups[i].at)) pc--;
+            return jit_fail("invalid jump address", pc, &a, native);
+        }
+        int32_t rel = (int32_t)(dest - (a.fixups[i].at + 4));
+        memcpy(a.buf + a.fixups[i].at, &rel, 4);
+    }
+
+    unsigned char *mem = mmap(NULL, (size_t)a.len, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return jit_fail("mmap failed", 0, &a, native);
+    memcpy(mem, a.buf, (size_t)a.len);
+    if (mprotect(mem, (size_t)a.len, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, (size_t)a.len);
+        return jit_fail("mprotect failed", 0, &a, native);
+    }
+
+    JitCode *jit = malloc(sizeof(JitCode));
+    if (!jit) {
+        fprintf(stderr, "error: out of memory in JIT\n");
+        exit(1);
+    }
+    jit->code = mem;
+    jit->size = (size_t)a.len;
+
+    free(a.buf);
+    free(a.fixups);
+    free(native);
+    return jit;
+}
+
+void jit_run(JitCode *jit, Program *p) {
+    JitState s = { p->stack, p->stack + p->sp, p->memory, 0, NULL };
+    int (*entry)(JitState *);
+
+    /* object pointer -> function pointer, as dlsym users do */
+    memcpy(&entry, &jit->code, sizeof(entry));
+    int status = entry(&s);
+
+    p->sp = (int)(s.stack_top - p->stack);
+    p->instr_count += (int)s.count;
+
+    if (status == JIT_HALT) {
+        printf("Instruction count: %d\n", p->instr_count);
+    } else if (status != JIT_END) {
+        fprintf(stderr, "error: %s\n", jit_errors[status]);
+        exit(1);
+    }
+}
+
+void jit_free(JitCode *jit) {
+    if (!jit) return;
+    munmap(jit->code, jit->size);
+    free(jit);
+}
+
+#else /* not x86-64 */
+
+JitCode *jit_compile(Program *p) {
+    (void)p;
+    fprintf(stderr, "note: JIT unavailable (x86-64 only); using the interpreter\n");
+    return NULL;
+}
+
+void jit_run(JitCode *jit, Program *p) {
+    (void)jit;
+    (void)p;
+}
+
+void jit_free(JitCode *jit) {
+    (void)jit;
+}
+
+#endif /* __x86_64__ */
@@ -0,0 +1,24 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "vm.h"
+
+/*
+ * Baseline JIT (x86-64 only): every bytecode instruction becomes a fixed
+ * template of machine code in an mmap'd buffer, bytecode jump targets are
+ * native labels and CALL/RET use the native call/ret. The operand stack,
+ * memory and the instruction count live in p, so results, errors and the
+ * final report match the interpreter.
+ *
+ * jit_compile returns NULL (after a note on stderr) when it cannot compile
+ * the program: another architecture, an invalid opcode, jump target or
+ * memory index, or truncated code. The caller then runs the interpreter,
+ * which reports such errors as before.
+ */
+typedef struct JitCode JitCode;
+
+JitCode *jit_compile(Program *p);
+void jit_run(JitCode *jit, Program *p);
+void jit_free(JitCode *jit);
+
+#endif
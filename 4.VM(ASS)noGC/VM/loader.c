@@ -1,7 +1,11 @@
 #include "loader.h"
+#include "flow.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
 
 static int valid_opcode(unsigned char op) {
     /* whitelist of supported opcodes */
@@ -66,7 +70,8 @@ unsigned char *load_bytecode(const char *file, int *size) {
     long file_size = ftell(f);
     fseek(f, 0, SEEK_SET);
 
-    unsigned char *buf = malloc(file_size);
+    /* zero pad after the code: see VM_CODE_PAD */
+    unsigned char *buf = malloc(file_size + VM_CODE_PAD);
     if (!buf) {
         fprintf(stderr, "error: out of memory\n");
         fclose(f);
@@ -79,11 +84,139 @@ unsigned char *load_bytecode(const char *file, int *size) {
         return NULL;
     }
     fclose(f);
+    memset(buf + file_size, 0, VM_CODE_PAD);
 
     *size = (int)file_size;
     return buf;
 }
 
+/*    SUPERINSTRUCTIONS    */
+
+enum { FUSE_LOAD_LOAD_ADD, FUSE_ADDI, FUSE_CMP_JZ, FUSE_INC_MEM, FUSE_KINDS };
+
+static const char *fusion_names[FUSE_KINDS] = {
+    "LOAD_LOAD_ADD", "ADDI", "CMP_JZ", "INC_MEM"
+};
+static int fusion_counts[FUSE_KINDS];
+static int fusion_before = 0, fusion_after = 0;
+
+static int read_int32(const unsigned char *code, int offset) {
+    /* little-endian 4-byte integer */
+    uint32_t b0 = (uint32_t)code[offset];
+    uint32_t b1 = (uint32_t)code[offset + 1] << 8;
+    uint32_t b2 = (uint32_t)code[offset + 2] << 16;
+    uint32_t b3 = (uint32_t)code[offset + 3] << 24;
+    return (int)(int32_t)(b0 | b1 | b2 | b3);
+}
+
+static void write_int32(unsigned char *code, int offset, int value) {
+    uint32_t v = (uint32_t)value;
+    code[offset]     = (unsigned char)(v & 0xFF);
+    code[offset + 1] = (unsigned char)((v >> 8) & 0xFF);
+    code[offset + 2] = (unsigned char)((v >> 16) & 0xFF);
+    code[offset + 3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+static int is_compare(unsigned char op) {
+    return op >= 0x14 && op <= 0x19;   /* EQ .. GE */
+}
+
+/* PUSH k at at[0], ADD|SUB at at[1]: the constant added (SUB of INT_MIN has no negation) */
+static int push_addend(const unsigned char *code, const int *at, int *k) {
+    if (code[at[0]] != 0x01) return 0;
+    int value = read_int32(code, at[0] + 1);
+    if (code[at[1]] == 0x10) { *k = value; return 1; }
+    if (code[at[1]] == 0x11 && value != INT_MIN) { *k = -value; return 1; }
+    return 0;
+}
+
+/* rewrite the instructions at at[0..len) if they start a pattern; returns how many were used */
+static int fuse_at(unsigned char *code, const int *at, int len, int *kind) {
+    int k;
+
+    if (len >= 4 && code[at[0]] == 0x31 && push_addend(code, at + 1, &k) &&
+        code[at[3]] == 0x30 && read_int32(code, at[3] + 1) == read_int32(code, at[0] + 1)) {
+        code[at[0]] = OP_INC_MEM;
+        write_int32(code, at[1] + 1, k);
+        *kind = FUSE_INC_MEM;
+        return 4;
+    }
+    if (len >= 3 && code[at[0]] == 0x31 && code[at[1]] == 0x31 && code[at[2]] == 0x10) {
+        code[at[0]] = OP_LOAD_LOAD_ADD;
+        *kind = FUSE_LOAD_LOAD_ADD;
+        return 3;
+    }
+    if (len >= 2 && push_addend(code, at, &k)) {
+        code[at[0]] = OP_ADDI;
+        write_int32(code, at[0] + 1, k);
+        *kind = FUSE_ADDI;
+        return 2;
+    }
+    if (len >= 2 && is_compare(code[at[0]]) && code[at[1]] == 0x21) {
+        code[at[1]] = code[at[0]];   /* compare opcode moves to +1 */
+        code[at[0]] = OP_CMP_JZ;
+        *kind = FUSE_CMP_JZ;
+        return 2;
+    }
+    return 0;
+}
+
+void vm_fuse(Program *p) {
+    unsigned char *code = p->code;
+    int size = p->code_size;
+
+    char *is_target = calloc((size_t)size + 1, 1);
+    if (!is_target) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+    for (int pc = 0; pc < size; pc += needs_operand(code[pc]) ? 5 : 1) {
+        unsigned char op = code[pc];
+        if (needs_operand(op) && pc + 5 > size) break;
+        if (op == 0x20 || op == 0x21 || op == 0x22 || op == 0x40) {
+            int target = read_int32(code, pc + 1);
+            if (target >= 0 && target <= size) is_target[target] = 1;
+        }
+    }
+
+    for (int k = 0; k < FUSE_KINDS; k++) fusion_counts[k] = 0;
+    fusion_before = fusion_after = 0;
+
+    int pc = 0;
+    while (pc < size) {
+        /* next up to 4 complete instructions, none but the first a jump target */
+        int at[4], len = 0, end = pc;
+        while (len < 4 && end < size && (len == 0 || !is_target[end])) {
+            int width = needs_operand(code[end]) ? 5 : 1;
+            if (end + width > size) break;
+            at[len++] = end;
+            end += width;
+        }
+        if (len == 0) break;
+
+        int kind;
+        int used = fuse_at(code, at, len, &kind);
+        if (used == 0) {
+            used = 1;
+        } else {
+            fusion_counts[kind]++;
+        }
+
+        fusion_before += used;
+        fusion_after++;
+        pc = used < len ? at[used] : end;
+    }
+
+    free(is_target);
+}
+
+void vm_fusion_report() {
+    printf("Fusion: %d -> %d instructions\n", fusion_before, fusion_after);
+    for (int k = 0; k < FUSE_KINDS; k++) {
+        printf("  %-14s %d\n", fusion_names[k], fusion_counts[k]);
+    }
+}
+
 int vm_validate(Program *p) {
     int pc = 0;
 
@@ -108,6 +241,10 @@ int vm_validate(Program *p) {
 
         /* HALT stops program */
         if (op == 0xFF) {
+            /* static depths let vm_run skip its stack, memory and jump checks */
+            StackFlow flow;
+            p->depth_proven = stack_flow(p, &flow);
+            stack_flow_free(&flow);
             return 1;  /* valid bytecode */
         }
     }
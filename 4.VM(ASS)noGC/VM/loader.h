@@ -7,4 +7,12 @@
 unsigned char *load_bytecode(const char *file, int *size);
 int vm_validate(Program *p);
 
+/*
+ * Peephole pass over validated code: rewrites common sequences in place into
+ * the superinstructions listed in vm.h, never across a jump target.
+ * vm_fusion_report prints what fired in the last vm_fuse.
+ */
+void vm_fuse(Program *p);
+void vm_fusion_report();
+
 #endif
@@ -0,0 +1,413 @@
+#include "reg.h"
+#include "flow.h"
+#include "stack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define R_TMP(i)   (MEM_SIZE + (i))
+#define R_CONST(i) (MEM_SIZE + STACK_MAX + (i))
+
+static int read_int32(const unsigned char *code, int offset) {
+    /* little-endian 4-byte integer */
+    uint32_t b0 = (uint32_t)code[offset];
+    uint32_t b1 = (uint32_t)code[offset + 1] << 8;
+    uint32_t b2 = (uint32_t)code[offset + 2] << 16;
+    uint32_t b3 = (uint32_t)code[offset + 3] << 24;
+    return (int)(int32_t)(b0 | b1 | b2 | b3);
+}
+
+static int needs_operand(unsigned char op) {
+    return (op == 0x01 || op == 0x20 || op == 0x21 || op == 0x22 ||
+            op == 0x30 || op == 0x31 || op == 0x40);
+}
+
+static void *alloc_or_die(size_t count, size_t size) {
+    void *mem = calloc(count ? count : 1, size);
+    if (!mem) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(1);
+    }
+    return mem;
+}
+
+/*    TRANSLATION    */
+
+typedef struct {
+    RegProgram *rp;
+    int cap;
+    int const_cap;
+    int sym[STACK_MAX];  /* register holding each stack slot */
+    int depth;
+    int block_start;     /* first instruction of the current block */
+    int producer;        /* last binary instruction, -1 if none since block start */
+} Emitter;
+
+static int emit(Emitter *e, int op, int a, int b, int c) {
+    RegProgram *rp = e->rp;
+    if (rp->count == e->cap) {
+        e->cap = e->cap ? e->cap * 2 : 64;
+        rp->code = realloc(rp->code, (size_t)e->cap * sizeof(RegInstr));
+        if (!rp->code) {
+            fprintf(stderr, "error: out of memory\n");
+            exit(1);
+        }
+    }
+    rp->code[rp->count] = (RegInstr){ (unsigned char)op, 0, 0, a, b, c };
+    e->producer = -1;
+    return rp->count++;
+}
+
+static int const_reg(Emitter *e, int value) {
+    RegProgram *rp = e->rp;
+    for (int i = 0; i < rp->const_count; i++) {
+        if (rp->consts[i] == value) return R_CONST(i);
+    }
+    if (rp->const_count == e->const_cap) {
+        e->const_cap = e->const_cap ? e->const_cap * 2 : 16;
+        rp->consts = realloc(rp->consts, (size_t)e->const_cap * sizeof(int));
+        if (!rp->consts) {
+            fprintf(stderr, "error: out of memory\n");
+            exit(1);
+        }
+    }
+    rp->consts[rp->const_count] = value;
+    return R_CONST(rp->const_count++);
+}
+
+/* put every stack slot in its own temporary (the state at block boundaries) */
+static void materialize(Emitter *e) {
+    for (int i = 0; i < e->depth; i++) {
+        if (e->sym[i] != R_TMP(i)) {
+            emit(e, R_MOV, R_TMP(i), e->sym[i], 0);
+            e->sym[i] = R_TMP(i);
+        }
+    }
+}
+
+static void start_block(Emitter *e, int depth) {
+    e->depth = depth;
+    for (int i = 0; i < depth; i++) e->sym[i] = R_TMP(i);
+    e->block_start = e->rp->count;
+    e->producer = -1;
+}
+
+/* memory slot reg is about to change: copy out stack slots still reading it */
+static void flush_reads(Emitter *e, int reg) {
+    for (int i = 0; i < e->depth; i++) {
+        if (e->sym[i] == reg) {
+            emit(e, R_MOV, R_TMP(i), reg, 0);
+            e->sym[i] = R_TMP(i);
+        }
+    }
+}
+
+static int referenced(Emitter *e, int reg) {
+    for (int i = 0; i < e->depth; i++) {
+        if (e->sym[i] == reg) return 1;
+    }
+    return 0;
+}
+
+static void emit_store(Emitter *e, int slot) {
+    int v = e->sym[--e->depth];
+    int producer = e->producer;
+
+    flush_reads(e, slot);
+
+    /* the value was computed right before: write it to the slot directly */
+    if (producer >= 0 && e->rp->count == producer + 1 &&
+        e->rp->code[producer].a == v && !referenced(e, v)) {
+        e->rp->code[producer].a = slot;
+        e->producer = -1;
+        return;
+    }
+    emit(e, R_MOV, slot, v, 0);
+}
+
+static void emit_cond_jump(Emitter *e, int want, int target) {
+    int cond = e->sym[--e->depth];
+    int producer = e->producer;
+    int before = e->rp->count;
+
+    materialize(e);
+
+    /* <compare>; JZ/JNZ with no moves between: one compare-and-branch */
+    if (producer >= 0 && before == producer + 1 && e->rp->count == before) {
+        RegInstr *in = &e->rp->code[producer];
+        if (in->op >= R_EQ && in->op <= R_GE && in->a == cond && !referenced(e, cond)) {
+            in->cmp = (unsigned char)(0x14 + (in->op - R_EQ));
+            in->want = (unsigned char)want;
+            in->op = R_BR_CMP;
+            in->a = in->b;
+            in->b = in->c;
+            in->c = target;
+            e->producer = -1;
+            return;
+        }
+    }
+    emit(e, want ? R_JNZ : R_JZ, cond, 0, target);
+}
+
+RegProgram *reg_translate(Program *p) {
+    const unsigned char *code = p->code;
+    int size = p->code_size;
+
+    StackFlow f;
+    stack_flow(p, &f);
+
+    /* block leaders: branch targets and return sites */
+    char *leader = alloc_or_die((size_t)size + 1, 1);
+    for (int pc = 0; pc < size && !f.error; pc += needs_operand(code[pc]) ? 5 : 1) {
+        if (f.depth[pc] == FLOW_UNKNOWN) continue;
+
+        unsigned char op = code[pc];
+        int next = pc + (needs_operand(op) ? 5 : 1);
+        if (op == 0x20 || op == 0x21 || op == 0x22 || op == 0x40) {
+            leader[read_int32(code, pc + 1)] = 1;
+        }
+        if (op == 0x40 && next <= size) leader[next] = 1;   /* return site */
+    }
+
+    if (f.error) {
+        fprintf(stderr, "note: register mode unavailable (%s at pc=%d); using the stack VM\n",
+                f.error, f.error_pc);
+        stack_flow_free(&f);
+        free(leader);
+        return NULL;
+    }
+
+    RegProgram *rp = alloc_or_die(1, sizeof(RegProgram));
+    int *reg_addr = alloc_or_die((size_t)size + 1, sizeof(int));
+    Emitter e = { .rp = rp, .producer = -1 };
+    int live = 0;   /* the previous instruction falls through */
+
+    for (int pc = 0; pc < size; pc += needs_operand(code[pc]) ? 5 : 1) {
+        if (f.depth[pc] == FLOW_UNKNOWN) {
+            live = 0;
+            continue;
+        }
+        if (leader[pc] || !live) {
+            if (live) materialize(&e);
+            start_block(&e, f.depth[pc]);
+        }
+        reg_addr[pc] = rp->count;
+        rp->stack_count++;
+        live = 1;
+
+        unsigned char op = code[pc];
+        int arg = needs_operand(op) ? read_int32(code, pc + 1) : 0;
+
+        switch (op) {
+            case 0x01: e.sym[e.depth++] = const_reg(&e, arg); break;       /* PUSH */
+            case 0x31: e.sym[e.depth++] = arg; break;                      /* LOAD */
+            case 0x03: e.sym[e.depth] = e.sym[e.depth - 1]; e.depth++; break; /* DUP */
+            case 0x02: e.depth--; break;                                   /* POP */
+            case 0x30: emit_store(&e, arg); break;                         /* STORE */
+
+            case 0x20: /* JMP */
+                materialize(&e);
+                emit(&e, R_JMP, 0, 0, arg);
+                live = 0;
+                break;
+            case 0x21: emit_cond_jump(&e, 0, arg); break;                  /* JZ */
+            case 0x22: emit_cond_jump(&e, 1, arg); break;                  /* JNZ */
+
+            case 0x40: /* CALL */
+                materialize(&e);
+                emit(&e, R_CALL, 0, 0, arg);
+                live = 0;
+                break;
+            case 0x41: /* RET */
+                materialize(&e);
+                emit(&e, R_RET, 0, 0, 0);
+                live = 0;
+                break;
+            case 0xFF: /* HALT */
+                materialize(&e);
+                emit(&e, R_HALT, e.depth, 0, 0);
+                live = 0;
+                break;
+
+            default: { /* binary: slot depth-2 gets the result */
+                int b = e.sym[--e.depth];
+                int a = e.sym[e.depth - 1];
+                int dst = R_TMP(e.depth - 1);
+                int idx = emit(&e, R_ADD + (op - 0x10), dst, a, b);
+                e.sym[e.depth - 1] = dst;
+                e.producer = idx;
+                break;
+            }
+        }
+    }
+    if (live) {
+        materialize(&e);
+        emit(&e, R_END, e.depth, 0, 0);
+    }
+
+    /* branch targets: byte address -> register instruction */
+    for (int i = 0; i < rp->count; i++) {
+        RegInstr *in = &rp->code[i];
+        if (in->op == R_JMP || in->op == R_JZ || in->op == R_JNZ ||
+            in->op == R_BR_CMP || in->op == R_CALL) {
+            in->c = reg_addr[in->c];
+        }
+    }
+
+    stack_flow_free(&f);
+    free(leader);
+    free(reg_addr);
+    return rp;
+}
+
+void reg_free(RegProgram *rp) {
+    if (!rp) return;
+    free(rp->code);
+    free(rp->consts);
+    free(rp);
+}
+
+/*    EXECUTION    */
+
+static int compare(unsigned char op, int a, int b) {
+    switch (op) {
+        case 0x14: return a == b;
+        case 0x15: return a != b;
+        case 0x16: return a < b;
+        case 0x17: return a > b;
+        case 0x18: return a <= b;
+        default:   return a >= b;
+    }
+}
+
+static int divide(int a, int b) {
+    if (b == 0) {
+        fprintf(stderr, "error: division by zero\n");
+        exit(1);
+    }
+    return a / b;
+}
+
+/* stack slots and memory go back into p so the usual report works */
+static void reg_finish(Program *p, const int *r, int depth) {
+    for (int i = 0; i < MEM_SIZE; i++) p->memory[i] = r[i];
+    for (int i = 0; i < depth; i++) p->stack[i] = r[R_TMP(i)];
+    p->sp = depth;
+}
+
+#if defined(VM_THREADED_DISPATCH) && defined(__GNUC__)
+
+void reg_run(RegProgram *rp, Program *p) {
+    static void *const dispatch[] = {
+        [R_MOV] = &&r_mov,
+        [R_ADD] = &&r_add, [R_SUB] = &&r_sub, [R_MUL] = &&r_mul, [R_DIV] = &&r_div,
+        [R_EQ] = &&r_eq,   [R_NEQ] = &&r_neq, [R_LT] = &&r_lt,
+        [R_GT] = &&r_gt,   [R_LE] = &&r_le,   [R_GE] = &&r_ge,
+        [R_JMP] = &&r_jmp, [R_JZ] = &&r_jz,   [R_JNZ] = &&r_jnz,
+        [R_BR_CMP] = &&r_br_cmp,
+        [R_CALL] = &&r_call, [R_RET] = &&r_ret,
+        [R_HALT] = &&r_halt, [R_END] = &&r_end,
+    };
+    int *r = alloc_or_die((size_t)R_CONST(rp->const_count), sizeof(int));
+    const RegInstr *code = rp->code;
+    const RegInstr *in = code;
+
+    for (int i = 0; i < MEM_SIZE; i++) r[i] = p->memory[i];
+    for (int i = 0; i < rp->const_count; i++) r[R_CONST(i)] = rp->consts[i];
+
+#define DISPATCH()    do { p->instr_count++; goto *dispatch[in->op]; } while (0)
+#define NEXT()        do { in++; DISPATCH(); } while (0)
+#define JUMP(index)   do { in = code + (index); DISPATCH(); } while (0)
+#define BINARY(expr)  do { int a = r[in->b], b = r[in->c]; r[in->a] = (expr); NEXT(); } while (0)
+
+    DISPATCH();
+
+r_mov:    r[in->a] = r[in->b]; NEXT();
+r_add:    BINARY(a + b);
+r_sub:    BINARY(a - b);
+r_mul:    BINARY(a * b);
+r_div:    BINARY(divide(a, b));
+r_eq:     BINARY(a == b);
+r_neq:    BINARY(a != b);
+r_lt:     BINARY(a < b);
+r_gt:     BINARY(a > b);
+r_le:     BINARY(a <= b);
+r_ge:     BINARY(a >= b);
+
+r_jmp:    JUMP(in->c);
+r_jz:     if (r[in->a] == 0) JUMP(in->c); NEXT();
+r_jnz:    if (r[in->a] != 0) JUMP(in->c); NEXT();
+r_br_cmp: if (compare(in->cmp, r[in->a], r[in->b]) == in->want) JUMP(in->c); NEXT();
+
+r_call:   vm_push_ret(p, (int)(in - code) + 1); JUMP(in->c);
+r_ret:    JUMP(vm_pop_ret(p));
+
+r_halt:
+    reg_finish(p, r, in->a);
+    printf("Instruction count: %d\n", p->instr_count);
+    free(r);
+    return;
+
+r_end:
+    p->instr_count--;   /* not an instruction */
+    reg_finish(p, r, in->a);
+    free(r);
+
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef BINARY
+}
+
+#else /* portable switch dispatch */
+
+void reg_run(RegProgram *rp, Program *p) {
+    int *r = alloc_or_die((size_t)R_CONST(rp->const_count), sizeof(int));
+    int ip = 0;
+
+    for (int i = 0; i < MEM_SIZE; i++) r[i] = p->memory[i];
+    for (int i = 0; i < rp->const_count; i++) r[R_CONST(i)] = rp->consts[i];
+
+    for (;;) {
+        const RegInstr *in = &rp->code[ip++];
+        p->instr_count++;
+
+        switch (in->op) {
+            case R_MOV: r[in->a] = r[in->b]; break;
+            case R_ADD: r[in->a] = r[in->b] + r[in->c]; break;
+            case R_SUB: r[in->a] = r[in->b] - r[in->c]; break;
+            case R_MUL: r[in->a] = r[in->b] * r[in->c]; break;
+            case R_DIV: r[in->a] = divide(r[in->b], r[in->c]); break;
+            case R_EQ:  r[in->a] = r[in->b] == r[in->c]; break;
+            case R_NEQ: r[in->a] = r[in->b] != r[in->c]; break;
+            case R_LT:  r[in->a] = r[in->b] < r[in->c]; break;
+            case R_GT:  r[in->a] = r[in->b] > r[in->c]; break;
+            case R_LE:  r[in->a] = r[in->b] <= r[in->c]; break;
+            case R_GE:  r[in->a] = r[in->b] >= r[in->c]; break;
+
+            case R_JMP: ip = in->c; break;
+            case R_JZ:  if (r[in->a] == 0) ip = in->c; break;
+            case R_JNZ: if (r[in->a] != 0) ip = in->c; break;
+            case R_BR_CMP:
+                if (compare(in->cmp, r[in->a], r[in->b]) == in->want) ip = in->c;
+                break;
+
+            case R_CALL: vm_push_ret(p, ip); ip = in->c; break;
+            case R_RET:  ip = vm_pop_ret(p); break;
+
+            case R_HALT:
+                reg_finish(p, r, in->a);
+                printf("Instruction count: %d\n", p->instr_count);
+                free(r);
+                return;
+            default: /* R_END */
+                p->instr_count--;
+                reg_finish(p, r, in->a);
+                free(r);
+                return;
+        }
+    }
+}
+
+#endif /* VM_THREADED_DISPATCH */
@@ -0,0 +1,53 @@
+#ifndef REG_H
+#define REG_H
+
+#include "vm.h"
+
+/*
+ * Register execution mode. reg_translate turns validated stack bytecode into
+ * three-address code over one register file:
+ *   [0, MEM_SIZE)                          the LOAD/STORE memory slots
+ *   [MEM_SIZE, MEM_SIZE + STACK_MAX)       stack slot i as a temporary
+ *   [MEM_SIZE + STACK_MAX, ...)            constants from PUSH
+ * PUSH and LOAD produce no instruction: their register becomes an operand
+ * of the instruction that consumes it, and a STORE retargets the result of
+ * the instruction before it. Between blocks the stack lives in its slot
+ * temporaries, so this needs a static stack depth at every instruction
+ * (each label/function always entered with the same depth).
+ */
+
+/* register opcodes */
+enum {
+    R_MOV,                      /* r[a] = r[b] */
+    R_ADD, R_SUB, R_MUL, R_DIV, /* r[a] = r[b] op r[c] */
+    R_EQ, R_NEQ, R_LT, R_GT, R_LE, R_GE,
+    R_JMP,                      /* goto c */
+    R_JZ, R_JNZ,                /* if r[a] == 0 / != 0 goto c */
+    R_BR_CMP,                   /* if (r[a] cmp r[b]) == want goto c */
+    R_CALL,                     /* push return, goto c */
+    R_RET,
+    R_HALT,                     /* stop; a = stack depth */
+    R_END                       /* ran off the end of the code; a = stack depth */
+};
+
+typedef struct {
+    unsigned char op;
+    unsigned char cmp;   /* R_BR_CMP: stack compare opcode (0x14 .. 0x19) */
+    unsigned char want;  /* R_BR_CMP: branch when the compare gives this */
+    int a, b, c;
+} RegInstr;
+
+typedef struct {
+    RegInstr *code;
+    int count;
+    int *consts;
+    int const_count;
+    int stack_count;     /* stack instructions that were translated */
+} RegProgram;
+
+/* NULL (after a note on stderr) when the program has no static stack depth */
+RegProgram *reg_translate(Program *p);
+void reg_run(RegProgram *rp, Program *p);
+void reg_free(RegProgram *rp);
+
+#endif
@@ -5,6 +5,21 @@
 #define MEM_SIZE  256   /* global memory slots */
 #define VM_EXIT_OK  0   /* normal termination */
 #define VM_EXIT_ERR 1   /* runtime / usage error */
+#define VM_CODE_PAD 1   /* zero bytes the loader appends after the code */
+
+/*
+ * Superinstructions written over the code by vm_fuse (never valid in a .byc
+ * file). The fused sequence keeps its length and its operands stay where
+ * they were, so no address in the program changes:
+ *   0x60 LOAD_LOAD_ADD  LOAD a; LOAD b; ADD          a at +1, b at +6, 11 bytes
+ *   0x61 ADDI           PUSH k; ADD|SUB              k at +1 (negated for SUB), 6 bytes
+ *   0x62 CMP_JZ         <compare>; JZ t              compare opcode at +1, t at +2, 6 bytes
+ *   0x63 INC_MEM        LOAD x; PUSH k; ADD|SUB; STORE x   x at +1, k at +6, 16 bytes
+ */
+#define OP_LOAD_LOAD_ADD 0x60
+#define OP_ADDI          0x61
+#define OP_CMP_JZ        0x62
+#define OP_INC_MEM       0x63
 
 /* Program = runtime state of the VM */
 typedef struct {
@@ -22,6 +37,8 @@ typedef struct {
     int csp;                   /* next free slot for call stack */
 
     int instr_count;         /* instruction count for benchmarks */
+
+    int depth_proven;        /* vm_validate: stack_flow proved the code (flow.h) */
 } Program;
 
 /* VM interface */
@@ -5,6 +5,8 @@
 #include "VM/vm.h"
 #include "VM/loader.h"
 #include "VM/exec.h"
+#include "VM/reg.h"
+#include "VM/jit.h"
 
 
 void print_stack(Program *p) {
@@ -25,12 +27,31 @@ void print_stack(Program *p) {
 int main(int argc, char **argv) {
 
     /* CLI rule */
-    if (argc != 2) {
-        fprintf(stderr, "usage: %s <bytecode_file>\n", argv[0]);
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <bytecode_file> [--no-fuse] [--fusion-report] [--reg] [--jit]\n", argv[0]);
         return VM_EXIT_ERR;
     }
 
     const char *file = argv[1];
+    int fuse = 1;
+    int fusion_report = 0;
+    int use_reg = 0;
+    int use_jit = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--no-fuse") == 0) {
+            fuse = 0;
+        } else if (strcmp(argv[i], "--fusion-report") == 0) {
+            fusion_report = 1;
+        } else if (strcmp(argv[i], "--reg") == 0) {
+            use_reg = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            use_jit = 1;
+        } else {
+            fprintf(stderr, "usage: %s <bytecode_file> [--no-fuse] [--fusion-report] [--reg] [--jit]\n", argv[0]);
+            return VM_EXIT_ERR;
+        }
+    }
 
     /* enforce .byc extension */
     const char *ext = strrchr(file, '.');
@@ -52,12 +73,31 @@ int main(int argc, char **argv) {
     vm_validate(&prog);
     vm_dump_bytecode(&prog);
 
+    /* the JIT and register mode translate the code as written, before fusion */
+    JitCode *jit = use_jit ? jit_compile(&prog) : NULL;
+    RegProgram *rp = (!jit && use_reg) ? reg_translate(&prog) : NULL;
+    if (rp) {
+        printf("Register code: %d instructions (from %d stack instructions)\n",
+               rp->count, rp->stack_count);
+    }
+
+    /* after the dump, which shows the file as written */
+    if (!jit && !rp && fuse) {
+        vm_fuse(&prog);
+        if (fusion_report) vm_fusion_report();
+    }
+
 
     // clocking the execution
     clock_t start = clock();
 
 
-    vm_run(&prog);
+    if (jit)
+        jit_run(jit, &prog);
+    else if (rp)
+        reg_run(rp, &prog);
+    else
+        vm_run(&prog);
 
 
     clock_t end = clock();
@@ -67,6 +107,8 @@ int main(int argc, char **argv) {
 
     print_stack(&prog);
 
+    jit_free(jit);
+    reg_free(rp);
     vm_free(&prog);
     return VM_EXIT_OK;
 }
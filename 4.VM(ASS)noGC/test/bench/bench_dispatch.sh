@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+# Compare two VM builds (switch vs direct-threaded dispatch) on test/bench/*.asm.
+# usage: [ASM_BIN=<assembler>] bench_dispatch.sh <switch_bvm> <threaded_bvm> [runs]
+# Both VMs' `make bench` use this copy; the GC VM passes its own assembler.
+set -u
+set -o pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+ASM_BIN="${ASM_BIN:-$ROOT_DIR/assembler}"
+runs="${3:-5}"
+
+if [[ $# -lt 2 || ! -x "$1" || ! -x "$2" || ! -x "$ASM_BIN" ]]; then
+    echo "usage: $0 <switch_bvm> <threaded_bvm> [runs]  (run 'make bench')"
+    exit 1
+fi
+
+tmp_dir="$(mktemp -d)"
+trap 'rm -rf "$tmp_dir"' EXIT
+
+# best wall-clock time of $runs runs, in ms
+best_ms() {
+    local vm="$1" prog="$2" best=-1
+    for ((i = 0; i < runs; i++)); do
+        local start end ms
+        start=$(date +%s%N)
+        if ! "$vm" "$prog" >/dev/null 2>&1; then
+            echo "error: $vm failed on $prog" >&2
+            exit 1
+        fi
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [[ $best -lt 0 || $ms -lt $best ]]; then best=$ms; fi
+    done
+    echo "$best"
+}
+
+printf "%-16s %10s %10s %8s\n" "program" "switch" "threaded" "speedup"
+for asm in "$ROOT_DIR"/test/bench/*.asm; do
+    name="$(basename "$asm" .asm)"
+    prog="$tmp_dir/$name.byc"
+    "$ASM_BIN" "$asm" "$prog" >/dev/null || exit 1
+
+    sw=$(best_ms "$1" "$prog") || exit 1
+    th=$(best_ms "$2" "$prog") || exit 1
+    speedup=$(awk -v a="$sw" -v b="$th" 'BEGIN { if (b > 0) printf "%.2fx", a / b; else print "-" }')
+    printf "%-16s %8d ms %8d ms %8s\n" "$name" "$sw" "$th" "$speedup"
+done
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+# Run test/bench/*.asm and the loop programs in test/ on the interpreter and
+# on the JIT of one VM build. The JIT runs the code unfused, so its output
+# (minus the timing line) must match --no-fuse; the timings compare it with
+# the default, fused interpreter.
+# usage: bench_jit.sh <bvm> [runs]
+set -u
+set -o pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+ASM_BIN="$ROOT_DIR/assembler"
+runs="${2:-5}"
+
+if [[ $# -lt 1 || ! -x "$1" || ! -x "$ASM_BIN" ]]; then
+    echo "usage: $0 <bvm> [runs]  (run 'make bench_jit')"
+    exit 1
+fi
+
+tmp_dir="$(mktemp -d)"
+trap 'rm -rf "$tmp_dir"' EXIT
+
+# best wall-clock time of $runs runs, in ms
+best_ms() {
+    local best=-1
+    for ((i = 0; i < runs; i++)); do
+        local start end ms
+        start=$(date +%s%N)
+        if ! "$@" >/dev/null 2>&1; then
+            echo "error: $* failed" >&2
+            exit 1
+        fi
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [[ $best -lt 0 || $ms -lt $best ]]; then best=$ms; fi
+    done
+    echo "$best"
+}
+
+output() {
+    "$@" 2>&1 | grep -v '^Execution time:'
+}
+
+status=0
+printf "%-20s %8s %9s %9s\n" "program" "output" "interp" "jit"
+for asm in "$ROOT_DIR"/test/bench/*.asm "$ROOT_DIR"/test/{factorial,power,nested_loop}.asm; do
+    name="${asm#"$ROOT_DIR"/test/}"
+    name="${name%.asm}"
+    prog="$tmp_dir/${name//\//_}.byc"
+    "$ASM_BIN" "$asm" "$prog" >/dev/null || exit 1
+
+    same="same"
+    if ! diff <(output "$1" "$prog" --no-fuse) <(output "$1" "$prog" --jit) >/dev/null; then
+        same="DIFFERS"
+        status=1
+    fi
+    it=$(best_ms "$1" "$prog") || exit 1
+    jt=$(best_ms "$1" "$prog" --jit) || exit 1
+    printf "%-20s %8s %6d ms %6d ms\n" "$name" "$same" "$it" "$jt"
+done
+exit $status
@@ -0,0 +1,83 @@
+#!/usr/bin/env bash
+# Compare the stack and register execution modes of one VM build on
+# test/bench/*.asm and the loop programs in test/. Register mode must print
+# what --no-fuse prints (minus counts and timing); test/reg/*.asm are small
+# cases for the translator, checked for that only.
+# usage: bench_reg.sh <bvm> [runs]
+set -u
+set -o pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
+ASM_BIN="$ROOT_DIR/assembler"
+runs="${2:-5}"
+
+if [[ $# -lt 1 || ! -x "$1" || ! -x "$ASM_BIN" ]]; then
+    echo "usage: $0 <bvm> [runs]  (run 'make bench_reg')"
+    exit 1
+fi
+
+tmp_dir="$(mktemp -d)"
+trap 'rm -rf "$tmp_dir"' EXIT
+
+# best wall-clock time of $runs runs, in ms
+best_ms() {
+    local best=-1
+    for ((i = 0; i < runs; i++)); do
+        local start end ms
+        start=$(date +%s%N)
+        if ! "$@" >/dev/null 2>&1; then
+            echo "error: $* failed" >&2
+            exit 1
+        fi
+        end=$(date +%s%N)
+        ms=$(( (end - start) / 1000000 ))
+        if [[ $best -lt 0 || $ms -lt $best ]]; then best=$ms; fi
+    done
+    echo "$best"
+}
+
+count() {
+    "$@" 2>/dev/null | sed -n 's/^Instruction count: //p'
+}
+
+output() {
+    "$@" 2>&1 | grep -v -e '^Instruction count:' -e '^Execution time:' -e '^Register code:' -e '^note: register mode'
+}
+
+status=0
+for asm in "$ROOT_DIR"/test/reg/*.asm; do
+    name="$(basename "$asm" .asm)"
+    prog="$tmp_dir/reg_$name.byc"
+    "$ASM_BIN" "$asm" "$prog" >/dev/null || exit 1
+
+    if ! diff <(output "$1" "$prog" --no-fuse) <(output "$1" "$prog" --reg) >/dev/null; then
+        echo "FAIL: $name: --reg output differs from --no-fuse"
+        status=1
+    fi
+done
+# no static stack depth: translation must give up, not guess
+if ! "$1" "$tmp_dir/reg_dynamic_depth.byc" --reg 2>&1 | grep '^note: register mode unavailable' >/dev/null; then
+    echo "FAIL: dynamic_depth: --reg should fall back to the stack VM"
+    status=1
+fi
+
+printf "%-20s %8s %12s %12s %7s %9s %9s\n" "program" "output" "stack instr" "reg instr" "saved" "stack" "reg"
+for asm in "$ROOT_DIR"/test/bench/*.asm "$ROOT_DIR"/test/{factorial,power,nested_loop}.asm; do
+    name="${asm#"$ROOT_DIR"/test/}"
+    name="${name%.asm}"
+    prog="$tmp_dir/${name//\//_}.byc"
+    "$ASM_BIN" "$asm" "$prog" >/dev/null || exit 1
+
+    same="same"
+    if ! diff <(output "$1" "$prog" --no-fuse) <(output "$1" "$prog" --reg) >/dev/null; then
+        same="DIFFERS"
+        status=1
+    fi
+    si=$(count "$1" "$prog" --no-fuse)
+    ri=$(count "$1" "$prog" --reg)
+    st=$(best_ms "$1" "$prog" --no-fuse) || exit 1
+    rt=$(best_ms "$1" "$prog" --reg) || exit 1
+    saved=$(awk -v a="$si" -v b="$ri" 'BEGIN { if (a > 0) printf "%.0f%%", 100 * (a - b) / a; else print "-" }')
+    printf "%-20s %8s %12d %12d %7s %6d ms %6d ms\n" "$name" "$same" "$si" "$ri" "$saved" "$st" "$rt"
+done
+exit $status
@@ -0,0 +1,40 @@
+; dispatch benchmark: 1M calls of a small compare-and-add function
+PUSH 1000000
+STORE 0        ; n
+
+PUSH 0
+STORE 1        ; acc
+
+loop:
+LOAD 0
+CALL step
+LOAD 0
+PUSH 1
+SUB
+DUP
+STORE 0
+JNZ loop
+
+LOAD 1
+HALT
+
+; acc += (n % 2 == 0) ? 2 : 1   (n on the stack)
+step:
+DUP
+PUSH 2
+DIV
+PUSH 2
+MUL
+EQ
+JZ odd
+LOAD 1
+PUSH 2
+ADD
+STORE 1
+RET
+odd:
+LOAD 1
+PUSH 1
+ADD
+STORE 1
+RET
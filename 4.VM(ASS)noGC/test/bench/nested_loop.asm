@@ -0,0 +1,37 @@
+; dispatch benchmark: 2000 x 2000 nested counting loop (about 44M instructions)
+PUSH 2000
+STORE 0        ; i
+
+PUSH 0
+STORE 2        ; sum
+
+outer:
+LOAD 0
+JZ end_outer
+
+PUSH 2000
+STORE 1        ; j
+
+inner:
+LOAD 2
+PUSH 1
+ADD
+STORE 2        ; sum++
+
+LOAD 1
+PUSH 1
+SUB
+DUP
+STORE 1
+JNZ inner
+
+LOAD 0
+PUSH 1
+SUB
+STORE 0
+
+JMP outer
+
+end_outer:
+LOAD 2
+HALT
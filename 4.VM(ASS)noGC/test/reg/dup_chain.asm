@@ -0,0 +1,21 @@
+; DUP chains: several stack slots name one register, and a STORE into a
+; duplicated slot (or of a duplicated result) must copy it out first
+PUSH 3
+DUP
+DUP
+MUL
+ADD            ; 3 + 3 * 3
+
+DUP
+DUP
+STORE 1        ; the result is also still on the stack twice
+LOAD 1
+MUL            ; 12 * 12
+
+LOAD 1
+DUP
+PUSH 0
+STORE 1        ; both copies read m1
+ADD            ; 12 + 12
+LOAD 1
+HALT           ; 12 144 24 0
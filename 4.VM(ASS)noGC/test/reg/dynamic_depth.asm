@@ -0,0 +1,13 @@
+; the join at skip is reached with one or two values on the stack, so there
+; is no static depth: --reg must fall back to the stack VM
+PUSH 1
+PUSH 5
+STORE 0
+LOAD 0
+PUSH 3
+GT
+JZ skip
+PUSH 2
+
+skip:
+HALT           ; 1 2
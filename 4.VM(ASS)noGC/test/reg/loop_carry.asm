@@ -0,0 +1,21 @@
+; stack values carried across the back edge: the loop is entered with a
+; marker and the running sum on the stack, the counter lives in memory
+PUSH 99
+PUSH 0
+PUSH 10
+STORE 0
+
+loop:
+LOAD 0
+ADD            ; sum += n
+LOAD 0
+PUSH 1
+SUB
+DUP
+STORE 0
+PUSH 0
+GT
+JNZ loop
+
+LOAD 0
+HALT           ; 99 55 0
@@ -0,0 +1,17 @@
+; STORE to a slot whose old value is still on the stack: the stack must keep
+; the old value, also when the STORE retargets the ADD right before it
+PUSH 7
+STORE 0
+LOAD 0         ; 7 stays on the stack
+PUSH 9
+STORE 0
+LOAD 0
+ADD            ; 7 + 9
+
+LOAD 0         ; 9 stays on the stack
+LOAD 0
+PUSH 1
+ADD
+STORE 0        ; m0 = 10
+LOAD 0
+HALT           ; 16 9 10
@@ -0,0 +1,17 @@
+; recursive sum 10 + 9 + ... + 1 with the partial sums on the stack: every
+; CALL enters sum one slot deeper, so there is no static stack depth and
+; vm_run must keep its checks
+PUSH 10
+CALL sum
+HALT
+
+sum:
+DUP
+JZ done
+DUP
+PUSH 1
+SUB
+CALL sum
+ADD
+done:
+RET
@@ -2,16 +2,18 @@
 set -u
 set -o pipefail
 
-ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/../.." && pwd)"
 ASM_BIN="$ROOT_DIR/assembler"
 VM_BIN="$ROOT_DIR/bvm"
+TEST_DIR="$ROOT_DIR/test/simple"
+ROOT_TEST_DIR="$ROOT_DIR/test"
 
 if [[ ! -x "$ASM_BIN" || ! -x "$VM_BIN" ]]; then
     echo "error: missing binaries; run 'make' first."
     exit 1
 fi
 
-tmp_dir="$(mktemp -d "$ROOT_DIR/test/simpple/tmp.XXXXXX")"
+tmp_dir="$(mktemp -d "$ROOT_DIR/test/simple/tmp.XXXXXX")"
 trap 'rm -rf "$tmp_dir"' EXIT
 
 fail=0
@@ -25,9 +27,14 @@ fail_case() {
     fail=1
 }
 
+# what a run prints, minus the lines that differ between execution modes
+output() {
+    "$@" 2>&1 | grep -v -e '^Instruction count:' -e '^Execution time:' -e '^Register code:' -e '^note: '
+}
+
 # Test 1: simple program assembles and dumps expected bytes.
 simple_bin="$tmp_dir/simple.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/test.asm" "$simple_bin" >"$tmp_dir/asm_simple.out" 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/test.asm" "$simple_bin" >"$tmp_dir/asm_simple.out" 2>&1; then
     fail_case "assemble simple program"
 else
     if ! "$VM_BIN" "$simple_bin" >"$tmp_dir/vm_simple.out" 2>"$tmp_dir/vm_simple.err"; then
@@ -41,7 +48,7 @@ fi
 
 # Test 2: missing HALT should be rejected by VM validation.
 nohalt_bin="$tmp_dir/nohalt.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/nohalt.asm" "$nohalt_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$ROOT_TEST_DIR/nohalt.asm" "$nohalt_bin" >/dev/null 2>&1; then
     fail_case "assemble nohalt program"
 else
     if "$VM_BIN" "$nohalt_bin" >/dev/null 2>"$tmp_dir/nohalt.err"; then
@@ -65,7 +72,7 @@ fi
 
 # Test 4: stack program runs without errors.
 stack_ok_bin="$tmp_dir/stack_ok.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/stack_ok.asm" "$stack_ok_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/stack_ok.asm" "$stack_ok_bin" >/dev/null 2>&1; then
     fail_case "assemble stack_ok program"
 else
     if ! "$VM_BIN" "$stack_ok_bin" >/dev/null 2>"$tmp_dir/stack_ok.err"; then
@@ -77,7 +84,7 @@ fi
 
 # Test 5: stack underflow is trapped.
 stack_underflow_bin="$tmp_dir/stack_underflow.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/stack_underflow.asm" "$stack_underflow_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/stack_underflow.asm" "$stack_underflow_bin" >/dev/null 2>&1; then
     fail_case "assemble stack_underflow program"
 else
     if "$VM_BIN" "$stack_underflow_bin" >/dev/null 2>"$tmp_dir/stack_underflow.err"; then
@@ -91,7 +98,7 @@ fi
 
 # Test 6: arithmetic program runs without errors.
 arith_bin="$tmp_dir/arith.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/arith.asm" "$arith_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/arith.asm" "$arith_bin" >/dev/null 2>&1; then
     fail_case "assemble arith program"
 else
     if ! "$VM_BIN" "$arith_bin" >/dev/null 2>"$tmp_dir/arith.err"; then
@@ -103,7 +110,7 @@ fi
 
 # Test 7: division by zero is trapped.
 div_zero_bin="$tmp_dir/div_zero.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/div_zero.asm" "$div_zero_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/div_zero.asm" "$div_zero_bin" >/dev/null 2>&1; then
     fail_case "assemble div_zero program"
 else
     if "$VM_BIN" "$div_zero_bin" >/dev/null 2>"$tmp_dir/div_zero.err"; then
@@ -117,7 +124,7 @@ fi
 
 # Test 8: JMP skips over bytes correctly.
 jmp_bin="$tmp_dir/jmp.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/jmp.asm" "$jmp_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/jmp.asm" "$jmp_bin" >/dev/null 2>&1; then
     fail_case "assemble jmp program"
 else
     if ! "$VM_BIN" "$jmp_bin" >/dev/null 2>"$tmp_dir/jmp.err"; then
@@ -129,7 +136,7 @@ fi
 
 # Test 9: JZ takes jump on zero.
 jz_bin="$tmp_dir/jz.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/jz.asm" "$jz_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/jz.asm" "$jz_bin" >/dev/null 2>&1; then
     fail_case "assemble jz program"
 else
     if ! "$VM_BIN" "$jz_bin" >/dev/null 2>"$tmp_dir/jz.err"; then
@@ -141,7 +148,7 @@ fi
 
 # Test 10: JNZ takes jump on non-zero.
 jnz_bin="$tmp_dir/jnz.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/jnz.asm" "$jnz_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/jnz.asm" "$jnz_bin" >/dev/null 2>&1; then
     fail_case "assemble jnz program"
 else
     if ! "$VM_BIN" "$jnz_bin" >/dev/null 2>"$tmp_dir/jnz.err"; then
@@ -153,7 +160,7 @@ fi
 
 # Test 11: STORE/LOAD works with valid index.
 mem_ok_bin="$tmp_dir/mem_ok.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/mem_ok.asm" "$mem_ok_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/mem_ok.asm" "$mem_ok_bin" >/dev/null 2>&1; then
     fail_case "assemble mem_ok program"
 else
     if ! "$VM_BIN" "$mem_ok_bin" >/dev/null 2>"$tmp_dir/mem_ok.err"; then
@@ -165,7 +172,7 @@ fi
 
 # Test 12: invalid memory index is trapped.
 mem_bad_bin="$tmp_dir/mem_bad.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/mem_bad.asm" "$mem_bad_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/mem_bad.asm" "$mem_bad_bin" >/dev/null 2>&1; then
     fail_case "assemble mem_bad program"
 else
     if "$VM_BIN" "$mem_bad_bin" >/dev/null 2>"$tmp_dir/mem_bad.err"; then
@@ -179,7 +186,7 @@ fi
 
 # Test 13: CALL/RET runs without errors.
 call_bin="$tmp_dir/call.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/call.asm" "$call_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$TEST_DIR/call.asm" "$call_bin" >/dev/null 2>&1; then
     fail_case "assemble call program"
 else
     if ! "$VM_BIN" "$call_bin" >/dev/null 2>"$tmp_dir/call.err"; then
@@ -211,7 +218,7 @@ fi
 
 # Test 16: loop with JNZ runs without errors.
 loop_bin="$tmp_dir/loop.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/loop.asm" "$loop_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$ROOT_TEST_DIR/loop.asm" "$loop_bin" >/dev/null 2>&1; then
     fail_case "assemble loop program"
 else
     if ! "$VM_BIN" "$loop_bin" >/dev/null 2>"$tmp_dir/loop.err"; then
@@ -223,7 +230,7 @@ fi
 
 # Test 17: nested CALL/RET runs without errors.
 nested_bin="$tmp_dir/nested_call.byc"
-if ! "$ASM_BIN" "$ROOT_DIR/test/nested_call.asm" "$nested_bin" >/dev/null 2>&1; then
+if ! "$ASM_BIN" "$ROOT_TEST_DIR/function_call.asm" "$nested_bin" >/dev/null 2>&1; then
     fail_case "assemble nested_call program"
 else
     if ! "$VM_BIN" "$nested_bin" >/dev/null 2>"$tmp_dir/nested_call.err"; then
@@ -243,6 +250,79 @@ else
     pass "truncated rejected"
 fi
 
+# Test 19: a recursive CALL enters its function one slot deeper each time,
+# so stack_flow fails and vm_run keeps its checks: the sum must still come
+# out, and runaway recursion must stop at the stack limit, in every mode.
+recursive_bin="$tmp_dir/recursive_call.byc"
+runaway_bin="$tmp_dir/runaway_call.byc"
+if ! "$ASM_BIN" "$TEST_DIR/recursive_call.asm" "$recursive_bin" >/dev/null 2>&1 ||
+   ! "$ASM_BIN" "$TEST_DIR/runaway_call.asm" "$runaway_bin" >/dev/null 2>&1; then
+    fail_case "assemble recursive_call programs"
+else
+    for mode in "" --no-fuse --jit --reg; do
+        "$VM_BIN" "$runaway_bin" $mode >/dev/null 2>"$tmp_dir/runaway.err"
+        status=$?
+        if ! "$VM_BIN" "$recursive_bin" $mode >"$tmp_dir/recursive.out" 2>&1; then
+            fail_case "recursive_call ${mode:-(fused)} should run"
+        elif ! grep -q "\[0\] 55$" "$tmp_dir/recursive.out"; then
+            fail_case "recursive_call ${mode:-(fused)} result"
+        elif [[ $status -ne 1 ]] || ! grep -q "error: stack overflow" "$tmp_dir/runaway.err"; then
+            fail_case "runaway_call ${mode:-(fused)} should stop with stack overflow"
+        else
+            pass "recursive_call ${mode:-(fused)}"
+        fi
+    done
+fi
+
+# Test 20: runtime errors are the same whichever mode runs the program
+# (JIT and register mode may fall back, but must not change the outcome).
+for name in stack_underflow mem_bad div_zero; do
+    bin="$tmp_dir/$name.byc"
+    if [[ ! -f "$bin" ]]; then
+        fail_case "$name program missing"
+        continue
+    fi
+    output "$VM_BIN" "$bin" >"$tmp_dir/$name.fused"
+    differs=""
+    for mode in --no-fuse --jit --reg; do
+        "$VM_BIN" "$bin" $mode >/dev/null 2>&1
+        status=$?
+        if [[ $status -ne 1 ]] || ! diff <(output "$VM_BIN" "$bin" $mode) "$tmp_dir/$name.fused" >/dev/null; then
+            differs="$differs $mode"
+        fi
+    done
+    if [[ -n "$differs" ]]; then
+        fail_case "$name differs with$differs"
+    else
+        pass "$name in every mode"
+    fi
+done
+
+# Test 21: the fused interpreter (default), --no-fuse, --jit and --reg print
+# the same stack for every program that runs.
+mismatch=""
+for asm in "$ROOT_TEST_DIR"/*.asm "$ROOT_TEST_DIR"/reg/*.asm \
+           "$TEST_DIR"/{test,stack_ok,arith,jmp,jz,jnz,mem_ok,call,recursive_call}.asm; do
+    [[ "$asm" == */nohalt.asm ]] && continue
+    name="${asm#"$ROOT_TEST_DIR"/}"
+    bin="$tmp_dir/modes_${name//\//_}.byc"
+    if ! "$ASM_BIN" "$asm" "$bin" >/dev/null 2>&1; then
+        mismatch="$mismatch ${name%.asm}(assemble)"
+        continue
+    fi
+    output "$VM_BIN" "$bin" >"$tmp_dir/modes.fused"
+    for mode in --no-fuse --jit --reg; do
+        if ! diff <(output "$VM_BIN" "$bin" $mode) "$tmp_dir/modes.fused" >/dev/null; then
+            mismatch="$mismatch ${name%.asm}($mode)"
+        fi
+    done
+done
+if [[ -n "$mismatch" ]]; then
+    fail_case "execution modes differ:$mismatch"
+else
+    pass "fused, --no-fuse, --jit and --reg agree"
+fi
+
 if [[ $fail -ne 0 ]]; then
     echo "VM tests failed."
     exit 1
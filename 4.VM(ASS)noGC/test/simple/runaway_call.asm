@@ -0,0 +1,11 @@
+; unbounded recursion that pushes two values per call: the value stack
+; fills before the call stack, and vm_run must stop with a VM error instead
+; of writing past it
+CALL grow
+HALT
+
+grow:
+PUSH 1
+PUSH 1
+CALL grow
+RET
@@ -0,0 +1,47 @@
+#ifndef BYC_H
+#define BYC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * .byc container, written by the assembler and read by vm_load. A file that
+ * does not start with BYC_MAGIC is headerless: all of it is the code. 0x42
+ * ('B') is not an opcode, so no valid headerless file starts with the magic.
+ * Every field is little-endian.
+ *
+ *   offset  size
+ *   0       4     magic "BYC\x1A"
+ *   4       4     CRC-32 of bytes 8 .. end of file
+ *   8       2     version (BYC_VERSION)
+ *   10      2     section count
+ *   12      4     flags (BYC_VERIFIED)
+ *   16      4     entry: code offset execution starts at
+ *   20      4     max_stack: deepest operand stack, 0 = unknown
+ *   24      4     mem_slots: LOAD / STORE slots used
+ *   28      4     reserved, 0
+ *   32      12*n  section table: kind, offset (from the start of the file), size
+ *
+ * The checksum detects damaged files, not forged ones: a file with
+ * BYC_VERIFIED runs without vm_verify, so only run containers you built
+ * (bvm --verify checks them anyway).
+ */
+#define BYC_MAGIC        "BYC\x1A"
+#define BYC_VERSION      1
+#define BYC_HEADER_SIZE  32
+#define BYC_SECTION_SIZE 12
+
+/* flags */
+#define BYC_VERIFIED 0x1   /* max_stack and every LOAD / STORE slot proven in bounds */
+
+/* section kinds; readers skip kinds they do not know */
+enum {
+    BYC_SEC_CODE    = 1,  /* opcode stream, exactly one */
+    BYC_SEC_CONST   = 2,  /* int32 constant pool (reserved: PUSH carries immediates) */
+    BYC_SEC_LINES   = 3,  /* debug line map: (code offset, source line) int32 pairs */
+    BYC_SEC_SYMBOLS = 4,  /* symbol table: code offset int32 + NUL-terminated name, repeated */
+};
+
+uint32_t byc_crc32(const unsigned char *data, size_t size);
+
+#endif
@@ -1,227 +1,425 @@
-#include "exec.h"
-#include "stack.h"
-#include "include/object.h"
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdint.h>
-
-/* --- Helper Functions (Your Original Logic) --- */
-
-static int pop_int(Program *p) {
-    Value v = vm_pop(p);
-    if (v.type != VAL_OBJ || v.obj == NULL || v.obj->type != OBJ_INT) {
-        fprintf(stderr, "error: expected integer object on stack\n");
-        exit(1);
-    }
-    return ((ObjInt *)v.obj)->value;
-}
-
-static void push_int(Program *p, int value) {
-    vm_push(p, make_int(value));
-}
-
-static ObjPair *pop_pair(Program *p) {
-    Value v = vm_pop(p);
-    if (v.type != VAL_OBJ || v.obj == NULL || v.obj->type != OBJ_PAIR) {
-        fprintf(stderr, "error: expected pair object on stack\n");
-        exit(1);
-    }
-    return (ObjPair *)v.obj;
-}
-
-static int needs_operand(unsigned char op) {
-    return (op == 0x01 || op == 0x20 || op == 0x21 || op == 0x22 || 
-            op == 0x30 || op == 0x31 || op == 0x40);
-}
-
-static int read_int32(const unsigned char *code, int offset) {
-    uint32_t b0 = (uint32_t)code[offset];
-    uint32_t b1 = (uint32_t)code[offset + 1] << 8;
-    uint32_t b2 = (uint32_t)code[offset + 2] << 16;
-    uint32_t b3 = (uint32_t)code[offset + 3] << 24;
-    return (int)(int32_t)(b0 | b1 | b2 | b3);
-}
-
-/**
- * vm_step executes exactly one instruction.
- * Returns 1 if execution should continue, 0 if HALT or error.
- */
-int vm_step(Program *p) {
-    if (p->pc >= p->code_size) return 0;
-
-    int pc = p->pc;
-    unsigned char op = p->code[pc];
-    p->instr_count++;
-
-    // Advance PC before execution to handle jumps correctly
-    if (needs_operand(op))
-        p->pc = pc + 5;
-    else
-        p->pc = pc + 1;
-
-    switch (op) {
-        case 0x01: { /* PUSH */
-            int value = read_int32(p->code, pc + 1);
-            push_int(p, value);
-            break;
-        }
-        case 0x02: /* POP */
-            (void)vm_pop(p);
-            break;
-
-
-        case 0x03: { /* DUP */
-            Value value = vm_pop(p);
-            vm_push(p, value);
-            vm_push(p, value);
-            break;
-        }
-
-
-        case 0x10: // ADD
-            push_int(p, pop_int(p) + pop_int(p)); 
-            break; 
-
-
-        case 0x11: { // SUB
-            int b = pop_int(p); 
-            int a = pop_int(p); 
-            push_int(p, a - b); 
-            break; 
-        }
-        
-        case 0x12:  // MUL
-            push_int(p, pop_int(p) * pop_int(p)); 
-            break;
-
-
-        case 0x13: { // DIV
-            int b = pop_int(p); 
-            int a = pop_int(p);
-            if (b == 0) { fprintf(stderr, "error: div by zero\n"); exit(1); }
-            push_int(p, a / b); 
-            break; 
-        }
-
-
-        case 0x14: { // EQ
-            int b = pop_int(p);
-            int a = pop_int(p); 
-            push_int(p, (a == b)); 
-            break; 
-        }
-
-
-        case 0x15: { // NEQ
-            int b = pop_int(p); 
-            int a = pop_int(p); 
-            push_int(p, (a != b)); 
-            break; 
-        }
-
-
-        case 0x16: { // LT
-            int b = pop_int(p); 
-            int a = pop_int(p); 
-            push_int(p, (a < b)); 
-            break; 
-        }
-        
-        case 0x17: { // GT
-            int b = pop_int(p); 
-            int a = pop_int(p); 
-            push_int(p, (a > b)); 
-            break; 
-        }
-        case 0x18: { // LE
-            int b = pop_int(p); 
-            int a = pop_int(p); 
-            push_int(p, (a <= b)); 
-            break; 
-        }
-        case 0x19: { // GE
-            int b = pop_int(p); 
-            int a = pop_int(p); 
-            push_int(p, (a >= b)); 
-            break; 
-        }
-
-        case 0x20: { /* JMP */
-            p->pc = read_int32(p->code, pc + 1);
-            break;
-        }
-
-
-        case 0x21: { /* JZ */
-            int addr = read_int32(p->code, pc + 1);
-            if (pop_int(p) == 0) p->pc = addr;
-            break;
-        }
-
-
-        case 0x22: { /* JNZ */
-            int addr = read_int32(p->code, pc + 1);
-            if (pop_int(p) != 0) p->pc = addr;
-            break;
-        }
-
-
-        case 0x30: { /* STORE */
-            int idx = read_int32(p->code, pc + 1);
-            p->memory[idx] = vm_pop(p);
-            break;
-        }
-
-
-        case 0x31: { /* LOAD */
-            int idx = read_int32(p->code, pc + 1);
-            vm_push(p, p->memory[idx]);
-            break;
-        }
-
-
-        case 0x40: { /* CALL */
-            vm_push_ret(p, p->pc);
-            p->pc = read_int32(p->code, pc + 1);
-            break;
-        }
-
-
-        case 0x41: 
-            p->pc = vm_pop_ret(p); 
-            break; /* RET */
-
-
-        case 0x50: { /* PAIR */
-            Value r = vm_pop(p); Value l = vm_pop(p);
-            vm_push(p, make_obj((Obj *)new_pair(l, r)));
-            break;
-        }
-
-
-        case 0x51: // LEFT
-            vm_push(p, pop_pair(p)->left); 
-            break;
-
-
-        case 0x52: // RIGHT
-            vm_push(p, pop_pair(p)->right); 
-            break;
-
-        case 0xFF: /* HALT */
-            printf("Instruction count: %d\n", p->instr_count);
-            return 0; 
-        default:
-            fprintf(stderr, "error: invalid opcode 0x%x at pc=%d\n", op, pc);
-            exit(1);
-    }
-    return 1; 
-}
-
-/* Original run loop now uses the stepping engine */
-void vm_run(Program *p) {
-    while (p->pc < p->code_size) {
-        if (!vm_step(p)) break;
-    }
-}
\ No newline at end of file
+#include "exec.h"
+#include "stack.h"
+#include "tier.h"
+#include "include/object.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+
+/* --- Helper Functions (Your Original Logic) --- */
+
+static int value_int(Program *p, Value v) {
+    if (v.type == VAL_INT) return v.num;
+
+    /* boxed integers are still accepted (e.g. built by the GC test harness) */
+    if (v.type != VAL_OBJ || v.obj == NULL || v.obj->type != OBJ_INT) {
+        vm_error(p, "expected integer on stack");
+    }
+    return ((ObjInt *)v.obj)->value;
+}
+
+static int pop_int(Program *p) {
+    return value_int(p, vm_pop(p));
+}
+
+static int compare(int op, int a, int b) {
+    switch (op) {
+        case 0x14: return a == b;
+        case 0x15: return a != b;
+        case 0x16: return a < b;
+        case 0x17: return a > b;
+        case 0x18: return a <= b;
+        default:   return a >= b;
+    }
+}
+
+static void push_int(Program *p, int value) {
+    vm_push(p, make_int(value));
+}
+
+static ObjPair *pop_pair(Program *p) {
+    Value v = vm_pop(p);
+    if (v.type != VAL_OBJ || v.obj == NULL || v.obj->type != OBJ_PAIR) {
+        vm_error(p, "expected pair object on stack");
+    }
+    return (ObjPair *)v.obj;
+}
+
+_Noreturn static void bad_jump(Program *p, int addr) {
+    vm_error(p, "invalid jump address %d", addr);
+}
+
+_Noreturn static void bad_memory(Program *p, int pc, int idx) {
+    vm_error(p, "invalid memory index %d at pc=%d", idx, vm_code_offset(p, pc));
+}
+
+_Noreturn static void invalid_opcode(Program *p, int pc) {
+    int offset = vm_code_offset(p, pc);
+    vm_error(p, "invalid opcode 0x%x at pc=%d", p->code[offset], offset);
+}
+
+/* taken branch: in tiered mode back-edges are counted and the tier may change */
+static int branch(Program *p, int from, int target) {
+    return p->tier ? tier_jump(p, from, target) : target;
+}
+
+/* the call stack holds tier-0 indices whenever tiering is on */
+static int return_address(Program *p, int index) {
+    return p->tier ? tier_base(p, index) : index;
+}
+
+static int call_target(Program *p, int target) {
+    return p->tier ? tier_enter(p, tier_base(p, target)) : target;
+}
+
+static int return_target(Program *p, int address) {
+    return p->tier ? tier_enter(p, address) : address;
+}
+
+/**
+ * vm_step executes exactly one instruction.
+ * Returns 1 if execution should continue, 0 if HALT or error.
+ */
+int vm_step(Program *p) {
+    const Instr *in = &p->insns[p->pc];
+    if (in->op == OP_END) return 0;
+
+    p->instr_count++;
+    p->pc++;   /* jumps overwrite it */
+
+    switch (in->op) {
+        case 0x01: { /* PUSH */
+            push_int(p, in->arg);
+            break;
+        }
+        case 0x02: /* POP */
+            (void)vm_pop(p);
+            break;
+
+
+        case 0x03: { /* DUP */
+            Value value = vm_pop(p);
+            vm_push(p, value);
+            vm_push(p, value);
+            break;
+        }
+
+
+        case 0x10: // ADD
+            push_int(p, pop_int(p) + pop_int(p)); 
+            break; 
+
+
+        case 0x11: { // SUB
+            int b = pop_int(p); 
+            int a = pop_int(p); 
+            push_int(p, a - b); 
+            break; 
+        }
+        
+        case 0x12:  // MUL
+            push_int(p, pop_int(p) * pop_int(p)); 
+            break;
+
+
+        case 0x13: { // DIV
+            int b = pop_int(p); 
+            int a = pop_int(p);
+            if (b == 0) vm_error(p, "div by zero");
+            if (b == -1 && a == INT_MIN) vm_error(p, "div overflow");
+            push_int(p, a / b); 
+            break; 
+        }
+
+
+        case 0x14: { // EQ
+            int b = pop_int(p);
+            int a = pop_int(p); 
+            push_int(p, (a == b)); 
+            break; 
+        }
+
+
+        case 0x15: { // NEQ
+            int b = pop_int(p); 
+            int a = pop_int(p); 
+            push_int(p, (a != b)); 
+            break; 
+        }
+
+
+        case 0x16: { // LT
+            int b = pop_int(p); 
+            int a = pop_int(p); 
+            push_int(p, (a < b)); 
+            break; 
+        }
+        
+        case 0x17: { // GT
+            int b = pop_int(p); 
+            int a = pop_int(p); 
+            push_int(p, (a > b)); 
+            break; 
+        }
+        case 0x18: { // LE
+            int b = pop_int(p); 
+            int a = pop_int(p); 
+            push_int(p, (a <= b)); 
+            break; 
+        }
+        case 0x19: { // GE
+            int b = pop_int(p); 
+            int a = pop_int(p); 
+            push_int(p, (a >= b)); 
+            break; 
+        }
+
+        case 0x20: { /* JMP */
+            p->pc = branch(p, p->pc - 1, in->arg);
+            break;
+        }
+
+
+        case 0x21: { /* JZ */
+            if (pop_int(p) == 0) p->pc = branch(p, p->pc - 1, in->arg);
+            break;
+        }
+
+
+        case 0x22: { /* JNZ */
+            if (pop_int(p) != 0) p->pc = branch(p, p->pc - 1, in->arg);
+            break;
+        }
+
+
+        case 0x30: { /* STORE */
+            vm_store(p, in->arg, vm_pop(p));
+            break;
+        }
+
+
+        case 0x31: { /* LOAD */
+            vm_push(p, p->memory[in->arg]);
+            break;
+        }
+
+
+        case 0x40: { /* CALL */
+            vm_push_ret(p, return_address(p, p->pc));
+            p->pc = call_target(p, in->arg);
+            break;
+        }
+
+
+        case 0x41: 
+            p->pc = return_target(p, vm_pop_ret(p));
+            break; /* RET */
+
+
+        case 0x50: { /* PAIR */
+            Value r = vm_pop(p); Value l = vm_pop(p);
+            vm_push(p, make_obj((Obj *)new_pair(p->heap, l, r)));
+            break;
+        }
+
+
+        case 0x51: // LEFT
+            vm_push(p, pop_pair(p)->left); 
+            break;
+
+
+        case 0x52: // RIGHT
+            vm_push(p, pop_pair(p)->right); 
+            break;
+
+        case 0xFF: /* HALT */
+            printf("Instruction count: %d\n", p->instr_count);
+            return 0; 
+        /* superinstructions (vm_fuse) */
+        case OP_LOAD_LOAD_ADD:
+            push_int(p, value_int(p, p->memory[in->arg]) + value_int(p, p->memory[in->arg2]));
+            break;
+
+        case OP_ADDI:
+            push_int(p, pop_int(p) + in->arg);
+            break;
+
+        case OP_CMP_JZ: {
+            int b = pop_int(p);
+            int a = pop_int(p);
+            if (!compare(in->arg2, a, b)) p->pc = branch(p, p->pc - 1, in->arg);
+            break;
+        }
+
+        case OP_INC_MEM:
+            vm_store(p, in->arg, make_int(value_int(p, p->memory[in->arg]) + in->arg2));
+            break;
+
+        case OP_BAD_JUMP:
+            bad_jump(p, in->arg);
+            break;
+        case OP_BAD_MEM:
+            bad_memory(p, p->pc - 1, in->arg);
+            break;
+        default:
+            invalid_opcode(p, p->pc - 1);
+    }
+
+    /* safepoint: allocator asked for a collection and all roots are in place */
+    if (p->heap->requested) gc_safepoint(p->heap);
+    if (vm_interrupt) vm_error(p, "interrupted");
+
+    return 1; 
+}
+
+#if defined(VM_THREADED_DISPATCH) && defined(__GNUC__)
+
+/*
+ * Direct-threaded run loop (GCC labels-as-values) over the decoded stream,
+ * same semantics as vm_step. Every handler ends in its own indirect jump, so
+ * the branch predictor sees per-opcode successors instead of one shared
+ * switch branch. Operands are pre-decoded and targets are instruction
+ * indices, so handlers neither read bytes nor check addresses. Only control
+ * transfers poll vm_interrupt: every loop has one. In tiered mode
+ * every control transfer goes through tier.c and reloads the stream.
+ */
+void vm_run(Program *p) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+    static void *const dispatch[256] = {
+        [0 ... 255] = &&op_invalid,
+        [0x01] = &&op_push,  [0x02] = &&op_pop,  [0x03] = &&op_dup,
+        [0x10] = &&op_add,   [0x11] = &&op_sub,  [0x12] = &&op_mul,  [0x13] = &&op_div,
+        [0x14] = &&op_eq,    [0x15] = &&op_neq,  [0x16] = &&op_lt,
+        [0x17] = &&op_gt,    [0x18] = &&op_le,   [0x19] = &&op_ge,
+        [0x20] = &&op_jmp,   [0x21] = &&op_jz,   [0x22] = &&op_jnz,
+        [0x30] = &&op_store, [0x31] = &&op_load,
+        [0x40] = &&op_call,  [0x41] = &&op_ret,
+        [0x50] = &&op_pair,  [0x51] = &&op_left, [0x52] = &&op_right,
+        [OP_LOAD_LOAD_ADD] = &&op_load_load_add, [OP_ADDI] = &&op_addi,
+        [OP_CMP_JZ] = &&op_cmp_jz,               [OP_INC_MEM] = &&op_inc_mem,
+        [OP_END] = &&op_end, [OP_BAD_JUMP] = &&op_bad_jump, [OP_BAD_MEM] = &&op_bad_mem,
+        [0xFF] = &&op_halt,
+    };
+#pragma GCC diagnostic pop
+    const Instr *code = p->insns;
+    const Instr *in = code + p->pc;
+    const int tiered = p->tier != NULL;
+    const int checked = !p->verified;   /* vm_verify proved the stack bounds */
+    Heap *const heap = p->heap;
+    int a, b;
+    Value v;
+
+#define FETCH()        do { p->instr_count++; goto *dispatch[in->op]; } while (0)
+#define DISPATCH()     do { if (heap->requested) gc_safepoint(heap); FETCH(); } while (0)
+#define NEXT()         do { in++; DISPATCH(); } while (0)
+#define JUMP(index)    do { if (vm_interrupt) vm_error(p, "interrupted"); in = code + (index); DISPATCH(); } while (0)
+#define RELOAD(index)  do { a = (index); code = p->insns; JUMP(a); } while (0)
+#define BRANCH(index)  do { if (tiered) RELOAD(tier_jump(p, (int)(in - code), (index))); JUMP(index); } while (0)
+#define POP()          (checked ? vm_pop(p) : p->stack[--p->sp])
+#define PUSH(value)    do { Value pushed = (value); if (checked) vm_push(p, pushed); else p->stack[p->sp++] = pushed; } while (0)
+#define POP_INT()      value_int(p, POP())
+#define PUSH_INT(n)    PUSH(make_int(n))
+#define BINARY(expr)   do { b = POP_INT(); a = POP_INT(); PUSH_INT(expr); NEXT(); } while (0)
+
+    FETCH();
+
+op_push:  PUSH_INT(in->arg); NEXT();
+op_pop:   (void)POP(); NEXT();
+op_dup:   v = POP(); PUSH(v); PUSH(v); NEXT();
+
+op_add:   BINARY(a + b);
+op_sub:   BINARY(a - b);
+op_mul:   BINARY(a * b);
+op_div:
+    b = POP_INT();
+    a = POP_INT();
+    if (b == 0) vm_error(p, "div by zero");
+    if (b == -1 && a == INT_MIN) vm_error(p, "div overflow");
+    PUSH_INT(a / b);
+    NEXT();
+op_eq:    BINARY(a == b);
+op_neq:   BINARY(a != b);
+op_lt:    BINARY(a < b);
+op_gt:    BINARY(a > b);
+op_le:    BINARY(a <= b);
+op_ge:    BINARY(a >= b);
+
+op_jmp:   BRANCH(in->arg);
+op_jz:    if (POP_INT() == 0) BRANCH(in->arg); NEXT();
+op_jnz:   if (POP_INT() != 0) BRANCH(in->arg); NEXT();
+
+op_store: vm_store(p, in->arg, POP()); NEXT();
+op_load:  PUSH(p->memory[in->arg]); NEXT();
+
+op_call:
+    vm_push_ret(p, return_address(p, (int)(in - code) + 1));
+    if (tiered) RELOAD(call_target(p, in->arg));
+    JUMP(in->arg);
+op_ret:
+    if (tiered) RELOAD(return_target(p, vm_pop_ret(p)));
+    JUMP(vm_pop_ret(p));
+
+op_pair: {
+    Value r = POP(); Value l = POP();
+    PUSH(make_obj((Obj *)new_pair(p->heap, l, r)));
+    NEXT();
+}
+op_left:  PUSH(pop_pair(p)->left); NEXT();
+op_right: PUSH(pop_pair(p)->right); NEXT();
+
+op_load_load_add:
+    PUSH_INT(value_int(p, p->memory[in->arg]) + value_int(p, p->memory[in->arg2]));
+    NEXT();
+op_addi:  PUSH_INT(POP_INT() + in->arg); NEXT();
+op_cmp_jz:
+    b = POP_INT();
+    a = POP_INT();
+    if (!compare(in->arg2, a, b)) BRANCH(in->arg);
+    NEXT();
+op_inc_mem:
+    vm_store(p, in->arg, make_int(value_int(p, p->memory[in->arg]) + in->arg2));
+    NEXT();
+
+op_halt:
+    p->pc = (int)(in - code) + 1;
+    printf("Instruction count: %d\n", p->instr_count);
+    return;
+
+op_end:
+    p->instr_count--;   /* not an instruction */
+    p->pc = (int)(in - code);
+    return;
+
+op_bad_jump:
+    bad_jump(p, in->arg);
+op_bad_mem:
+    bad_memory(p, (int)(in - code), in->arg);
+
+op_invalid:
+    invalid_opcode(p, (int)(in - code));
+
+#undef FETCH
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef RELOAD
+#undef BRANCH
+#undef POP
+#undef PUSH
+#undef POP_INT
+#undef PUSH_INT
+#undef BINARY
+}
+
+#else /* portable switch dispatch */
+
+/* Original run loop now uses the stepping engine */
+void vm_run(Program *p) {
+    while (vm_step(p)) {
+    }
+}
+
+#endif /* VM_THREADED_DISPATCH */
\ No newline at end of file
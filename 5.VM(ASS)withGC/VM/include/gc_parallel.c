@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L   /* pthreads, sched_yield */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gc_parallel.h"
+#include "vm.h"
+
+static void* grow_or_die(void* array, int* cap, size_t elem) {
+    int new_cap = *cap ? *cap * 2 : 256;
+    void* grown = realloc(array, (size_t)new_cap * elem);
+    if (!grown) {
+        fprintf(stderr, "error: out of memory in parallel GC\n");
+        exit(1);
+    }
+    *cap = new_cap;
+    return grown;
+}
+
+/*    WORKER POOL    */
+
+/*
+ * Workers are started on first use and then sleep on pool_wake between
+ * collections. Worker 0 is always the calling (VM) thread.
+ */
+typedef void (*PoolTask)(int id);
+
+static pthread_t pool_threads[GC_MAX_THREADS];
+static unsigned pool_seen[GC_MAX_THREADS];   /* last generation each worker ran */
+static int pool_size = 1;
+static int pool_active = 0;                  /* workers taking part in this task */
+static int pool_running = 0;                 /* helper workers still busy */
+static unsigned pool_generation = 0;
+static PoolTask pool_task = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t pool_owner = PTHREAD_MUTEX_INITIALIZER;  /* one collection at a time */
+
+static void* pool_main(void* arg) {
+    int id = (int)(intptr_t)arg;
+
+    pthread_mutex_lock(&pool_lock);
+    for (;;) {
+        while (pool_generation == pool_seen[id]) {
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        }
+        pool_seen[id] = pool_generation;
+        if (id >= pool_active) continue;
+
+        PoolTask task = pool_task;
+        pthread_mutex_unlock(&pool_lock);
+        task(id);
+        pthread_mutex_lock(&pool_lock);
+
+        if (--pool_running == 0) pthread_cond_signal(&pool_done);
+    }
+    return NULL;
+}
+
+/* start helpers up to threads; returns how many workers are available */
+static int pool_reserve(int threads) {
+    if (threads > GC_MAX_THREADS) threads = GC_MAX_THREADS;
+
+    while (pool_size < threads) {
+        pool_seen[pool_size] = pool_generation;
+        if (pthread_create(&pool_threads[pool_size], NULL, pool_main,
+                           (void*)(intptr_t)pool_size) != 0) {
+            break;   /* run with the workers we have */
+        }
+        pthread_detach(pool_threads[pool_size]);
+        pool_size++;
+    }
+    return threads < pool_size ? threads : pool_size;
+}
+
+/* run task on workers 0..threads-1 and wait for all of them */
+static void pool_run(int threads, PoolTask task) {
+    pthread_mutex_lock(&pool_lock);
+    pool_task = task;
+    pool_active = threads;
+    pool_running = threads - 1;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+
+    task(0);
+
+    pthread_mutex_lock(&pool_lock);
+    while (pool_running > 0) pthread_cond_wait(&pool_done, &pool_lock);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+/*    PARALLEL MARK    */
+
+/*
+ * Each worker traces from a private stack. When it holds more than
+ * SHARE_MIN entries and its shared queue is empty, it moves half of them to
+ * the shared queue, where idle workers steal half of whatever they find.
+ * Objects are marked when pushed (atomic fetch-or), so each is traced once.
+ * Termination: a worker with no local work and nothing to steal counts
+ * itself idle; once all workers are idle no queue can refill, so all stop.
+ */
+#define SHARE_MIN 64
+
+typedef struct {
+    Obj** local;
+    int local_top, local_cap;
+    pthread_mutex_t lock;                /* guards shared */
+    Obj** shared;
+    int shared_count, shared_cap;
+    int marked;
+} __attribute__((aligned(64))) MarkWorker;
+
+static MarkWorker mark_workers[GC_MAX_THREADS];
+static int mark_threads = 1;
+static int idle_workers = 0;
+static int next_root = 0;
+
+static void local_push(MarkWorker* w, Obj* o) {
+    if (w->local_top == w->local_cap) {
+        w->local = grow_or_die(w->local, &w->local_cap, sizeof(Obj*));
+    }
+    w->local[w->local_top++] = o;
+}
+
+static void par_push(void* worker, Obj* o) {
+    MarkWorker* w = worker;
+    if (!o || !slab_mark_atomic(o)) return;
+    w->marked++;
+    local_push(w, o);
+}
+
+/* roots are marked up front and dealt round-robin into the shared queues */
+static void root_push(void* ctx, Obj* o) {
+    (void)ctx;
+    if (!o || !slab_mark_atomic(o)) return;
+
+    MarkWorker* w = &mark_workers[next_root++ % mark_threads];
+    if (w->shared_count == w->shared_cap) {
+        w->shared = grow_or_die(w->shared, &w->shared_cap, sizeof(Obj*));
+    }
+    w->shared[w->shared_count++] = o;
+    w->marked++;
+}
+
+static void share_half(MarkWorker* w) {
+    int half = w->local_top / 2;
+
+    pthread_mutex_lock(&w->lock);
+    while (w->shared_count + half > w->shared_cap) {
+        w->shared = grow_or_die(w->shared, &w->shared_cap, sizeof(Obj*));
+    }
+    w->local_top -= half;
+    memcpy(w->shared + w->shared_count, w->local + w->local_top, (size_t)half * sizeof(Obj*));
+    __atomic_store_n(&w->shared_count, w->shared_count + half, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* move work from victim's shared queue (all of it if it is our own) */
+static int refill_from(MarkWorker* w, MarkWorker* victim) {
+    if (__atomic_load_n(&victim->shared_count, __ATOMIC_ACQUIRE) == 0) return 0;
+
+    pthread_mutex_lock(&victim->lock);
+    int n = victim->shared_count;
+    int take = victim == w ? n : (n + 1) / 2;
+    for (int i = 0; i < take; i++) {
+        local_push(w, victim->shared[n - 1 - i]);
+    }
+    __atomic_store_n(&victim->shared_count, n - take, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&victim->lock);
+    return take > 0;
+}
+
+static Obj* take_work(MarkWorker* w, int id) {
+    if (w->local_top == 0 && !refill_from(w, w)) {
+        for (int k = 1; k < mark_threads; k++) {
+            if (refill_from(w, &mark_workers[(id + k) % mark_threads])) break;
+        }
+    }
+    return w->local_top > 0 ? w->local[--w->local_top] : NULL;
+}
+
+static int any_shared_work() {
+    for (int i = 0; i < mark_threads; i++) {
+        if (__atomic_load_n(&mark_workers[i].shared_count, __ATOMIC_ACQUIRE) > 0) return 1;
+    }
+    return 0;
+}
+
+static void mark_task(int id) {
+    MarkWorker* w = &mark_workers[id];
+
+    for (;;) {
+        Obj* o;
+        while ((o = take_work(w, id)) != NULL) {
+            obj_visit_children(o, par_push, w);
+            if (w->local_top > SHARE_MIN &&
+                __atomic_load_n(&w->shared_count, __ATOMIC_ACQUIRE) == 0) {
+                share_half(w);
+            }
+        }
+
+        __atomic_add_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+        for (;;) {
+            if (__atomic_load_n(&idle_workers, __ATOMIC_SEQ_CST) == mark_threads) return;
+            if (any_shared_work()) {
+                __atomic_sub_fetch(&idle_workers, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+int gc_parallel_mark(Heap* h, int threads) {
+    static int locks_ready = 0;
+
+    pthread_mutex_lock(&pool_owner);
+    if (!locks_ready) {
+        for (int i = 0; i < GC_MAX_THREADS; i++) {
+            pthread_mutex_init(&mark_workers[i].lock, NULL);
+        }
+        locks_ready = 1;
+    }
+
+    mark_threads = pool_reserve(threads < 1 ? 1 : threads);
+    for (int i = 0; i < mark_threads; i++) {
+        mark_workers[i].local_top = 0;
+        mark_workers[i].shared_count = 0;
+        mark_workers[i].marked = 0;
+    }
+    idle_workers = 0;
+    next_root = 0;
+
+    vm_visit_roots(h->program, root_push, NULL);
+    pool_run(mark_threads, mark_task);
+
+    int marked = 0;
+    for (int i = 0; i < mark_threads; i++) {
+        marked += mark_workers[i].marked;
+    }
+    pthread_mutex_unlock(&pool_owner);
+    return marked;
+}
+
+/*    PARALLEL SWEEP    */
+
+/* slabs of all classes are swept in any order; free lists are relinked after */
+typedef struct {
+    int freed;
+    size_t bytes;
+} __attribute__((aligned(64))) SweepResult;
+
+static Slab** sweep_slabs = NULL;
+static int sweep_slab_count = 0;
+static int sweep_slab_cap = 0;
+static int sweep_next = 0;
+static SweepResult sweep_results[GC_MAX_THREADS];
+
+static void sweep_task(int id) {
+    for (;;) {
+        int i = __atomic_fetch_add(&sweep_next, 1, __ATOMIC_RELAXED);
+        if (i >= sweep_slab_count) break;
+
+        Slab* s = sweep_slabs[i];
+        int n = slab_sweep_one(s);
+        sweep_results[id].freed += n;
+        sweep_results[id].bytes += (size_t)n * s->cls->slot_size;
+    }
+}
+
+void gc_parallel_sweep(SizeClass* classes, int count, int threads, int* freed, size_t* bytes) {
+    pthread_mutex_lock(&pool_owner);
+    sweep_slab_count = 0;
+    for (int c = 0; c < count; c++) {
+        for (Slab* s = classes[c].slabs; s; s = s->next) {
+            if (sweep_slab_count == sweep_slab_cap) {
+                sweep_slabs = grow_or_die(sweep_slabs, &sweep_slab_cap, sizeof(Slab*));
+            }
+            sweep_slabs[sweep_slab_count++] = s;
+        }
+    }
+
+    threads = pool_reserve(threads < 1 ? 1 : threads);
+    memset(sweep_results, 0, sizeof(sweep_results));
+    sweep_next = 0;
+    pool_run(threads, sweep_task);
+
+    for (int i = 0; i < threads; i++) {
+        *freed += sweep_results[i].freed;
+        *bytes += sweep_results[i].bytes;
+    }
+    for (int c = 0; c < count; c++) {
+        slab_sweep_link(&classes[c]);
+    }
+    pthread_mutex_unlock(&pool_owner);
+}
@@ -0,0 +1,26 @@
+#ifndef GC_PARALLEL_H
+#define GC_PARALLEL_H
+
+#include <stddef.h>
+#include "object.h"
+#include "slab.h"
+
+/*
+ * Parallel stop-the-world phases for gc_collect().
+ * A persistent pool of threads - 1 pthreads plus the calling thread marks
+ * from the VM roots with per-thread mark stacks and work stealing (mark bits
+ * set with an atomic fetch-or), then sweeps the slabs of every size class,
+ * each worker claiming slabs from a shared counter.
+ * The nursery must be empty: only slab (old-space) objects are marked.
+ * The pool is shared by every heap in the process; collections that use it
+ * take turns.
+ */
+#define GC_MAX_THREADS 64
+
+/* Mark everything reachable from h's roots; returns objects marked */
+int gc_parallel_mark(Heap* h, int threads);
+
+/* Sweep classes[0..count); adds slots and bytes freed to *freed / *bytes */
+void gc_parallel_sweep(SizeClass* classes, int count, int threads, int* freed, size_t* bytes);
+
+#endif
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L   /* pthreads */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "gc_sweeper.h"
+#include "object.h"
+#include "vm.h"
+
+_Static_assert(HEAP_SIZE_CLASSES <= SWEEPER_MAX_CLASSES, "too many size classes for the sweeper");
+
+/* a slab is swept by whoever swaps the current cycle into it first */
+static int claim_slab(GcSweeper* sw, Slab* s) {
+    return __atomic_exchange_n(&s->sweep_claim, sw->cycle, __ATOMIC_ACQ_REL) != sw->cycle;
+}
+
+static void sweep_and_publish(GcSweeper* sw, Slab* s) {
+    int freed = slab_sweep_one(s);
+    SweptClass* sc = &sw->swept[s->cls - sw->classes];
+
+    pthread_mutex_lock(&sw->lock);
+    if (s->free_head) {
+        *sc->tail = s->free_head;
+        sc->tail = s->free_tail;
+    }
+    sw->pending_freed += freed;
+    sw->pending_bytes += (size_t)freed * s->cls->slot_size;
+    pthread_mutex_unlock(&sw->lock);
+}
+
+static void* sweeper_main(void* arg) {
+    GcSweeper* sw = arg;
+    for (int i = 0; i < sw->list_count; i++) {
+        if (claim_slab(sw, sw->list[i])) sweep_and_publish(sw, sw->list[i]);
+    }
+    __atomic_store_n(&sw->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void gc_sweeper_init(GcSweeper* sw) {
+    sw->classes = NULL;
+    sw->class_count = 0;
+    sw->list = NULL;
+    sw->list_count = 0;
+    sw->list_cap = 0;
+    sw->cycle = 0;
+    pthread_mutex_init(&sw->lock, NULL);
+    sw->active = 0;
+    sw->threaded = 0;
+    sw->finished = 0;
+    sw->pending_freed = 0;
+    sw->pending_bytes = 0;
+}
+
+void gc_sweeper_free(Heap* h) {
+    gc_sweeper_wait(h);
+    free(h->sweeper.list);
+    h->sweeper.list = NULL;
+    pthread_mutex_destroy(&h->sweeper.lock);
+}
+
+void gc_sweeper_start(Heap* h) {
+    GcSweeper* sw = &h->sweeper;
+    SizeClass* classes = h->size_classes;
+    int count = HEAP_SIZE_CLASSES;
+
+    sw->classes = classes;
+    sw->class_count = count;
+    sw->cycle++;
+    sw->list_count = 0;
+
+    for (int c = 0; c < count; c++) {
+        sw->swept[c].head = NULL;
+        sw->swept[c].tail = &sw->swept[c].head;
+        sw->swept[c].first = sw->list_count;
+
+        for (Slab* s = classes[c].slabs; s; s = s->next) {
+            if (sw->list_count == sw->list_cap) {
+                int cap = sw->list_cap ? sw->list_cap * 2 : 256;
+                Slab** grown = realloc(sw->list, (size_t)cap * sizeof(Slab*));
+                if (!grown) vm_error(h->program, "out of memory in GC sweeper");
+                sw->list = grown;
+                sw->list_cap = cap;
+            }
+            sw->list[sw->list_count++] = s;
+        }
+
+        sw->swept[c].end = sw->list_count;
+        sw->swept[c].help_cursor = sw->swept[c].first;
+
+        /* every free slot is rediscovered by sweeping its slab */
+        classes[c].free_list = NULL;
+    }
+
+    sw->active = 1;
+    sw->finished = 0;
+    sw->threaded = pthread_create(&sw->thread, NULL, sweeper_main, sw) == 0;
+    if (!sw->threaded) {
+        sweeper_main(sw);   /* no thread available: sweep right here */
+    }
+}
+
+/* move published chains onto the free lists and account for freed slots */
+static void take_published(GcSweeper* sw, int c) {
+    SweptClass* sc = &sw->swept[c];
+    SizeClass* cls = &sw->classes[c];
+
+    if (sc->head) {
+        *sc->tail = cls->free_list;
+        cls->free_list = sc->head;
+        sc->head = NULL;
+        sc->tail = &sc->head;
+    }
+}
+
+static void fold_counters(Heap* h) {
+    GcSweeper* sw = &h->sweeper;
+    h->objects_freed += sw->pending_freed;
+    h->bytes_allocated -= sw->pending_bytes;
+    sw->pending_freed = 0;
+    sw->pending_bytes = 0;
+}
+
+static int finish_if_done(Heap* h) {
+    GcSweeper* sw = &h->sweeper;
+    if (!__atomic_load_n(&sw->finished, __ATOMIC_ACQUIRE)) return 0;
+
+    if (sw->threaded) {
+        pthread_join(sw->thread, NULL);
+        sw->threaded = 0;
+    }
+    pthread_mutex_lock(&sw->lock);
+    for (int c = 0; c < sw->class_count; c++) {
+        take_published(sw, c);
+    }
+    fold_counters(h);
+    pthread_mutex_unlock(&sw->lock);
+
+    /* every slab is swept: hand surplus empty ones back, as a full sweep would */
+    for (int c = 0; c < sw->class_count; c++) {
+        slab_release_empty(&sw->classes[c]);
+    }
+
+    sw->active = 0;
+    return 1;
+}
+
+int gc_sweeper_refill(Heap* h, SizeClass* cls) {
+    GcSweeper* sw = &h->sweeper;
+    if (!sw->active) return 0;
+
+    int c = (int)(cls - sw->classes);
+    SweptClass* sc = &sw->swept[c];
+
+    pthread_mutex_lock(&sw->lock);
+    take_published(sw, c);
+    fold_counters(h);
+    pthread_mutex_unlock(&sw->lock);
+
+    /* nothing ready: sweep one of our own slabs rather than grow the heap */
+    while (!cls->free_list && sc->help_cursor < sc->end) {
+        Slab* s = sw->list[sc->help_cursor++];
+        if (!claim_slab(sw, s)) continue;
+
+        sweep_and_publish(sw, s);
+        pthread_mutex_lock(&sw->lock);
+        take_published(sw, c);
+        fold_counters(h);
+        pthread_mutex_unlock(&sw->lock);
+    }
+
+    return finish_if_done(h);
+}
+
+int gc_sweeper_wait(Heap* h) {
+    GcSweeper* sw = &h->sweeper;
+    if (!sw->active) return 0;
+
+    if (sw->threaded) {
+        pthread_join(sw->thread, NULL);
+        sw->threaded = 0;
+    }
+    return finish_if_done(h);
+}
+
+int gc_sweeper_active(const Heap* h) {
+    return h->sweeper.active;
+}
@@ -0,0 +1,59 @@
+#ifndef GC_SWEEPER_H
+#define GC_SWEEPER_H
+
+#include <pthread.h>
+#include "slab.h"
+
+/*
+ * Background sweeping for the old space.
+ * After marking, gc_sweeper_start hands every slab of the heap's size
+ * classes to a sweeper thread and empties the class free lists, so the
+ * allocator only gets slots from slabs that have already been swept. Swept
+ * slabs publish their free-slot chains; gc_sweeper_refill moves them onto
+ * cls->free_list (sweeping a slab of cls itself when none is ready yet).
+ * Freed counts are folded into h->objects_freed / h->bytes_allocated on the
+ * mutator thread. Empty slabs are kept until the next stop-the-world sweep.
+ *
+ * gc_sweeper_refill and gc_sweeper_wait return 1 when they finished the
+ * sweep (bytes_allocated is final again), 0 otherwise.
+ */
+#define SWEEPER_MAX_CLASSES 16
+
+typedef struct Heap Heap;   /* object.h */
+
+typedef struct {
+    FreeSlot* head;          /* swept, not yet handed to the allocator */
+    FreeSlot** tail;
+    int first, end;          /* this class's range in list */
+    int help_cursor;         /* next slab the mutator may sweep itself */
+} SweptClass;
+
+/* per-heap sweeper state (Heap.sweeper) */
+typedef struct {
+    SizeClass* classes;
+    int class_count;
+    SweptClass swept[SWEEPER_MAX_CLASSES];
+
+    Slab** list;             /* snapshot of the slabs to sweep */
+    int list_count, list_cap;
+    unsigned cycle;          /* claim token, see claim_slab */
+
+    pthread_t thread;
+    pthread_mutex_t lock;    /* swept[], counters */
+    int active;              /* mutator view: a sweep is in progress */
+    int threaded;            /* sweeper thread started (join it) */
+    int finished;            /* set by the sweeper thread */
+    int pending_freed;       /* guarded by lock */
+    size_t pending_bytes;
+} GcSweeper;
+
+void gc_sweeper_init(GcSweeper* s);
+/* waits for a running sweep */
+void gc_sweeper_free(Heap* h);
+
+void gc_sweeper_start(Heap* h);
+int gc_sweeper_refill(Heap* h, SizeClass* cls);
+int gc_sweeper_wait(Heap* h);
+int gc_sweeper_active(const Heap* h);
+
+#endif
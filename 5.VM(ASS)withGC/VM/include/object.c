@@ -1,213 +1,903 @@
-#include <stdlib.h>
-#include <stdio.h>
-#include "object.h"
-#include "vm.h"
-
-/*    MARK STACK (ITERATIVE GC)   */
-int stack_object_count = 0;
-
-#define MARK_STACK_MAX 1024
-static Obj* mark_stack[MARK_STACK_MAX];
-static int mark_stack_top = 0;
-int total_objects_created = 0;
-
-static void mark_push(Obj* o) {
-    if (!o) return;
-    if (mark_stack_top < MARK_STACK_MAX) {
-        mark_stack[mark_stack_top++] = o;
-    }
-}
-
-/*    HEAP LIST   */
-
-Obj* heap_objects = NULL;
-
-int no_of_object_freed = 0;
-
-void heap_register(Obj* o) {
-    o->next = heap_objects;
-    heap_objects = o;
-    total_objects_created++;
-}
-
-/*   ALLOCATION    */
-
-ObjPair* new_pair(Value l, Value r) {
-    ObjPair* pair = malloc(sizeof(ObjPair));
-    if (!pair) return NULL;
-
-    pair->base.type = OBJ_PAIR;
-    pair->base.marked = 0;
-    heap_register((Obj*)pair);
-
-    pair->left = l;
-    pair->right = r;
-    return pair;
-}
-
-ObjInt* new_int(int value) {
-    ObjInt* i = malloc(sizeof(ObjInt));
-    if (!i) return NULL;
-
-    i->base.type = OBJ_INT;
-    i->base.marked = 0;
-    heap_register((Obj*)i);
-
-    i->value = value;
-    return i;
-}
-
-Obj* new_function() {
-    ObjFunction* f = malloc(sizeof(ObjFunction));
-    if (!f) return NULL;
-
-    f->base.type = OBJ_FUNCTION;
-    f->base.marked = 0;
-
-    heap_register((Obj*)f);
-    return (Obj*)f;
-}
-
-Obj* new_closure(Obj* fn, Obj* env) {
-    ObjClosure* cl = malloc(sizeof(ObjClosure));
-    if (!cl) return NULL;
-
-    cl->base.type = OBJ_CLOSURE;
-    cl->base.marked = 0;
-    cl->function = fn;
-    cl->env = env;
-
-    heap_register((Obj*)cl);
-    return (Obj*)cl;
-}
-
-
-/*    OBJECT GRAPH TRAVERSAL    */
-
-void obj_visit_children(Obj* o, void (*visit)(Obj*)) {
-    if (!o) return;
-
-    switch (o->type) {
-        case OBJ_PAIR: {
-            ObjPair* p = (ObjPair*)o;
-            visit(p->left.obj);
-            visit(p->right.obj);
-            break;
-        }
-        case OBJ_INT:
-            /* boxed integer has no children */
-            break;
-        case OBJ_FUNCTION:
-            /* function has no children in this simple VM */
-            break;
-        case OBJ_CLOSURE:
-            {
-                ObjClosure* cl = (ObjClosure*)o;
-                visit(cl->function);
-                visit(cl->env);
-                break;
-            }
-        default:
-            break;
-    }
-}
-
-/*    DEBUG: HEAP PRINTER   */
-
-static void gc_print_heap(const char* phase) {
-    printf("\n[GC] HEAP DUMP (%s)\n", phase);
-
-    if (!heap_objects) {
-        printf("  <empty>\n");
-        return;
-    }
-
-    for (Obj* o = heap_objects; o; o = o->next) {
-        if (o->type == OBJ_INT) {
-            ObjInt* i = (ObjInt*)o;
-            printf("  ObjInt  %p | value=%d | marked=%d\n",
-                   (void*)i, i->value, i->base.marked);
-        } else if (o->type == OBJ_PAIR) {
-            ObjPair* p = (ObjPair*)o;
-            printf("  ObjPair %p | marked=%d | left=%p | right=%p\n",
-                   (void*)p, p->base.marked,
-                   (void*)p->left.obj, (void*)p->right.obj);
-        }
-    }
-}
-
-/*    MARK PHASE    */
-
-void gc_mark(Obj* root) {
-    if (!root) return;
-
-    mark_stack_top = 0;
-    mark_push(root);
-
-    while (mark_stack_top > 0) {
-        Obj* o = mark_stack[--mark_stack_top];
-        if (o->marked) continue;
-
-        o->marked = 1;
-        stack_object_count++;
-        obj_visit_children(o, mark_push);
-    }
-}
-
-void checkstack(){
-    gc_mark_from_roots();  
-}
-
-void gc_mark_from_roots(void) {
-    vm_visit_roots(gc_mark);
-}
-
-/*    SWEEP PHASE    */
-
-void gc_sweep(int show_debug) {
-    Obj** o = &heap_objects;
-
-    while (*o) {
-        if (!(*o)->marked) {
-            Obj* dead = *o;
-            *o = dead->next;
-            no_of_object_freed++;
-            
-            // CHANGED: Only print if flag is ON
-            if (show_debug) {
-                printf("[GC] freeing %p\n", (void*)dead);
-            }
-            
-            free(dead);
-        } else {
-            (*o)->marked = 0; /* reset for next GC */
-            o = &(*o)->next;
-        }
-    }
-    stack_object_count = 0;
-}
-
-/*    FULL GC    */
-
-void gc_collect(int show_debug) {
-   
-    if (show_debug) {
-        gc_print_heap("before mark");
-    }
-
-    gc_mark_from_roots();
-    
-    if (show_debug) {
-        gc_print_heap("after mark (before sweep)");
-    }
-
-    gc_sweep(show_debug); // Pass the flag down
-    
-    if (show_debug) {
-        gc_print_heap("after sweep");
-    }
-}
-
-void gc_start(){
-    gc_collect(0);
+#define _POSIX_C_SOURCE 200809L   /* clock_gettime */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "object.h"
+#include "slab.h"
+#include "gc_parallel.h"
+#include "gc_sweeper.h"
+#include "vm.h"
+
+/*    MARK STACK (ITERATIVE GC)   */
+
+/*
+ * The mark stack is a chain of fixed-size segments: the first one comes with
+ * the heap, further ones are malloc'd as the graph demands and cached when popped.
+ * If a segment cannot be obtained (out of memory or the optional segment
+ * limit), the push is dropped and mark_overflowed is set; the dropped object
+ * is always a child of an already-marked object, so gc_mark_recover() finds
+ * it again by rescanning the heap.
+ */
+#define MARK_SEGMENT_SLOTS 1024
+
+struct MarkSegment {
+    struct MarkSegment* prev;
+    int top;
+    Obj* slots[MARK_SEGMENT_SLOTS];
+};
+
+void gc_set_mark_stack_limit(Heap* h, int segments) {
+    h->mark_segment_limit = segments;   /* 0 = unlimited */
+}
+
+static int obj_is_marked(Heap* h, Obj* o);
+static int obj_mark(Heap* h, Obj* o);
+static int marking_incrementally(Heap* h);
+
+/* visitor: ctx is the heap */
+static void mark_push(void* ctx, Obj* o) {
+    Heap* h = ctx;
+    if (!o || obj_is_marked(h, o)) return;
+    /* the nursery is emptied before a cycle; later young objects are left
+     * to minor GCs, which promote survivors black */
+    if (marking_incrementally(h) && gc_is_young(h, o)) return;
+
+    MarkSegment* seg = h->mark_top;
+    if (seg->top == MARK_SEGMENT_SLOTS) {
+        MarkSegment* next = NULL;
+        if (h->mark_segment_limit == 0 || h->mark_segments < h->mark_segment_limit) {
+            next = h->mark_spare ? h->mark_spare : malloc(sizeof(MarkSegment));
+        }
+        if (!next) {
+            h->mark_overflowed = 1;
+            return;
+        }
+        if (next == h->mark_spare) h->mark_spare = NULL;
+
+        next->prev = seg;
+        next->top = 0;
+        h->mark_top = seg = next;
+        h->mark_segments++;
+    }
+    seg->slots[seg->top++] = o;
+}
+
+static Obj* mark_pop(Heap* h) {
+    MarkSegment* seg = h->mark_top;
+    while (seg->top == 0) {
+        if (!seg->prev) return NULL;
+
+        h->mark_top = seg->prev;
+        h->mark_segments--;
+        if (!h->mark_spare) h->mark_spare = seg;
+        else free(seg);
+        seg = h->mark_top;
+    }
+    return seg->slots[--seg->top];
+}
+
+/*    ALLOCATION ACCOUNTING (AUTOMATIC GC)   */
+
+/* incremental collector state (see INCREMENTAL GC below) */
+typedef enum { GC_IDLE, GC_MARKING, GC_SWEEPING } GcPhase;
+
+static int marking_incrementally(Heap* h) {
+    return h->phase == GC_MARKING;
+}
+
+static void update_request(Heap* h) {
+    h->requested = h->minor_requested || h->major_requested || h->phase != GC_IDLE;
+}
+
+/* bytes charged per object: the slot it occupies in its size class */
+static size_t obj_size(Heap* h, ObjType type) {
+    return h->size_classes[type].slot_size;
+}
+
+void gc_set_threshold(Heap* h, size_t initial_bytes, int grow_factor) {
+    h->min_threshold = initial_bytes;
+    h->grow_factor = grow_factor < 1 ? 1 : grow_factor;
+    h->next_gc = initial_bytes;
+}
+
+size_t gc_next_threshold(const Heap* h) {
+    return h->next_gc;
+}
+
+/*
+ * Collecting inside the allocator would free (or move) the operands of the
+ * instruction that is still allocating (e.g. PAIR has already popped
+ * left/right), so the allocator only raises a request; the interpreter
+ * services it between instructions via gc_safepoint(), when every live
+ * reference sits in the stack or memory.
+ */
+static void charge_old(Heap* h, size_t size) {
+    h->bytes_allocated += size;
+    if (h->min_threshold > 0 && h->bytes_allocated >= h->next_gc) {
+        h->major_requested = 1;
+        h->requested = 1;
+    }
+}
+
+/*    NURSERY (YOUNG GENERATION)   */
+
+/*
+ * New objects are bump-allocated in the nursery. A minor collection copies
+ * the survivors into the slab (old) space and resets the bump pointer, so it
+ * costs time proportional to what survives. Its roots are the operand stack,
+ * the memory slots written with young references since the last minor GC
+ * (tracked by vm_store) and the remembered set of old objects that were
+ * given young references (gc_write_barrier).
+ *
+ * Every young object takes at least 16 bytes so that, once copied, the
+ * forwarding pointer can sit at offset 8 while the header stays readable.
+ * nursery_marks has one bit per 8 bytes: "marked" for checkstack(),
+ * "forwarded" during a minor collection.
+ */
+#define YOUNG_ALIGN    8
+#define YOUNG_MIN_SIZE 16
+
+static size_t young_size(ObjType type) {
+    size_t size = sizeof(Obj);
+    switch (type) {
+        case OBJ_PAIR:     size = sizeof(ObjPair); break;
+        case OBJ_INT:      size = sizeof(ObjInt); break;
+        case OBJ_FUNCTION: size = sizeof(ObjFunction); break;
+        case OBJ_CLOSURE:  size = sizeof(ObjClosure); break;
+    }
+    size = (size + YOUNG_ALIGN - 1) & ~(size_t)(YOUNG_ALIGN - 1);
+    return size < YOUNG_MIN_SIZE ? YOUNG_MIN_SIZE : size;
+}
+
+static size_t nursery_mark_words(Heap* h) {
+    return (h->nursery_size / YOUNG_ALIGN + 63) / 64;
+}
+
+static void nursery_init(Heap* h) {
+    h->nursery = malloc(h->nursery_size);
+    h->nursery_marks = calloc(nursery_mark_words(h), sizeof(uint64_t));
+    if (!h->nursery || !h->nursery_marks) {
+        free(h->nursery);
+        free(h->nursery_marks);
+        h->nursery = NULL;
+        h->nursery_marks = NULL;
+        h->nursery_size = 0;   /* fall back to old-space allocation only */
+    }
+    h->nursery_top = 0;
+}
+
+void gc_set_nursery(Heap* h, size_t bytes) {
+    if (h->nursery && h->nursery_objects > 0) return;   /* only while empty */
+
+    free(h->nursery);
+    free(h->nursery_marks);
+    h->nursery = NULL;
+    h->nursery_marks = NULL;
+    h->nursery_size = bytes < GC_MIN_NURSERY ? 0 : bytes;
+}
+
+int gc_is_young(const Heap* h, const Obj* o) {
+    return h->nursery && (const unsigned char*)o >= h->nursery
+                      && (const unsigned char*)o < h->nursery + h->nursery_size;
+}
+
+static size_t young_bit(Heap* h, const Obj* o) {
+    return (size_t)((const unsigned char*)o - h->nursery) / YOUNG_ALIGN;
+}
+
+static int young_test_and_set(Heap* h, const Obj* o) {
+    size_t bit = young_bit(h, o);
+    uint64_t mask = (uint64_t)1 << (bit & 63);
+    if (h->nursery_marks[bit >> 6] & mask) return 0;
+    h->nursery_marks[bit >> 6] |= mask;
+    return 1;
+}
+
+static int young_is_set(Heap* h, const Obj* o) {
+    size_t bit = young_bit(h, o);
+    return (int)((h->nursery_marks[bit >> 6] >> (bit & 63)) & 1);
+}
+
+static Obj* young_alloc(Heap* h, ObjType type) {
+    if (!h->nursery && h->nursery_size > 0) nursery_init(h);
+    if (!h->nursery) return NULL;
+
+    size_t size = young_size(type);
+    if (h->nursery_top + size > h->nursery_size) {
+        /* nursery full: this object goes to old space, evacuate at the next safepoint */
+        h->minor_requested = 1;
+        h->requested = 1;
+        return NULL;
+    }
+
+    Obj* o = (Obj*)(h->nursery + h->nursery_top);
+    h->nursery_top += size;
+    h->nursery_objects++;
+    return o;
+}
+
+/* fn(h, obj) on every object allocated in the nursery (only valid outside a minor GC) */
+static void young_walk(Heap* h, int marked_only, void (*fn)(void*, void*)) {
+    size_t off = 0;
+    while (off < h->nursery_top) {
+        Obj* o = (Obj*)(h->nursery + off);
+        off += young_size(o->type);
+        if (!marked_only || young_is_set(h, o)) fn(h, o);
+    }
+}
+
+/* out of memory abandons the heap's program (vm_error), like a runtime error */
+static void* grow_array(Heap* h, void* array, int* cap, size_t elem) {
+    int new_cap = *cap ? *cap * 2 : 256;
+    void* grown = realloc(array, (size_t)new_cap * elem);
+    if (!grown) vm_error(h->program, "out of memory");
+    *cap = new_cap;
+    return grown;
+}
+
+void gc_shade(Heap* h, Value v) {
+    /* Dijkstra barrier: a stored reference never leaves a white object behind
+     * a black one. Young targets need no shading: survivors are promoted black. */
+    if (h->phase == GC_MARKING && v.type == VAL_OBJ && v.obj) {
+        mark_push(h, v.obj);
+    }
+}
+
+void gc_write_barrier(Heap* h, Obj* owner, Value v) {
+    if (v.type != VAL_OBJ || !v.obj) return;
+    gc_shade(h, v);
+    if (!gc_is_young(h, v.obj) || gc_is_young(h, owner)) return;
+
+    if (h->remembered_count == h->remembered_cap) {
+        h->remembered = grow_array(h, h->remembered, &h->remembered_cap, sizeof(Obj*));
+    }
+    h->remembered[h->remembered_count++] = owner;
+}
+
+static void set_next_threshold(Heap* h);
+
+/* old-space allocation; objects born during a cycle are allocated black */
+static Obj* old_alloc(Heap* h, ObjType type) {
+    SizeClass* cls = &h->size_classes[type];
+
+    /* while the background sweeper runs, reuse only slots it has swept */
+    if (!cls->free_list && gc_sweeper_refill(h, cls)) {
+        set_next_threshold(h);
+    }
+
+    Obj* o = slab_alloc(cls);
+    if (!o) return NULL;
+
+    if (h->phase == GC_MARKING || (h->phase == GC_SWEEPING && slab_sweep_pending(o))) {
+        slab_mark(o);
+    }
+    return o;
+}
+
+void heap_register(Heap* h, Obj* o) {
+    h->objects_created++;
+    if (!gc_is_young(h, o)) {
+        charge_old(h, obj_size(h, o->type));
+    }
+}
+
+/*   ALLOCATION    */
+
+static Obj* obj_alloc(Heap* h, ObjType type) {
+    Obj* o = young_alloc(h, type);
+    if (!o) o = old_alloc(h, type);
+    if (!o) return NULL;
+
+    o->type = type;
+    heap_register(h, o);
+    return o;
+}
+
+ObjPair* new_pair(Heap* h, Value l, Value r) {
+    ObjPair* pair = (ObjPair*)obj_alloc(h, OBJ_PAIR);
+    if (!pair) return NULL;
+
+    pair->left = l;
+    pair->right = r;
+
+    /* a pair placed straight in old space may point into the nursery */
+    gc_write_barrier(h, (Obj*)pair, l);
+    gc_write_barrier(h, (Obj*)pair, r);
+    return pair;
+}
+
+ObjInt* new_int(Heap* h, int value) {
+    ObjInt* i = (ObjInt*)obj_alloc(h, OBJ_INT);
+    if (!i) return NULL;
+
+    i->value = value;
+    return i;
+}
+
+Obj* new_function(Heap* h) {
+    return obj_alloc(h, OBJ_FUNCTION);
+}
+
+Obj* new_closure(Heap* h, Obj* fn, Obj* env) {
+    ObjClosure* cl = (ObjClosure*)obj_alloc(h, OBJ_CLOSURE);
+    if (!cl) return NULL;
+
+    cl->function = fn;
+    cl->env = env;
+
+    gc_write_barrier(h, (Obj*)cl, make_obj(fn));
+    gc_write_barrier(h, (Obj*)cl, make_obj(env));
+    return (Obj*)cl;
+}
+
+size_t heap_reserved_bytes(Heap* h) {
+    size_t total = 0;
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        total += (size_t)h->size_classes[c].slab_count * SLAB_BYTES;
+    }
+    return total;
+}
+
+
+/*    OBJECT GRAPH TRAVERSAL    */
+
+/* only VAL_OBJ cells hold references; immediates and nil are skipped */
+static void visit_value(Value v, void (*visit)(void*, Obj*), void* ctx) {
+    if (v.type == VAL_OBJ && v.obj) {
+        visit(ctx, v.obj);
+    }
+}
+
+void obj_visit_children(Obj* o, void (*visit)(void* ctx, Obj*), void* ctx) {
+    if (!o) return;
+
+    switch (o->type) {
+        case OBJ_PAIR: {
+            ObjPair* p = (ObjPair*)o;
+            visit_value(p->left, visit, ctx);
+            visit_value(p->right, visit, ctx);
+            break;
+        }
+        case OBJ_INT:
+            /* boxed integer has no children */
+            break;
+        case OBJ_FUNCTION:
+            /* function has no children in this simple VM */
+            break;
+        case OBJ_CLOSURE:
+            {
+                ObjClosure* cl = (ObjClosure*)o;
+                visit(ctx, cl->function);
+                visit(ctx, cl->env);
+                break;
+            }
+        default:
+            break;
+    }
+}
+
+/* rewrite every reference held by o to relocate(ctx, reference) */
+void obj_fix_children(Obj* o, Obj* (*relocate)(void* ctx, Obj*), void* ctx) {
+    switch (o->type) {
+        case OBJ_PAIR: {
+            ObjPair* p = (ObjPair*)o;
+            if (p->left.type == VAL_OBJ && p->left.obj) p->left.obj = relocate(ctx, p->left.obj);
+            if (p->right.type == VAL_OBJ && p->right.obj) p->right.obj = relocate(ctx, p->right.obj);
+            break;
+        }
+        case OBJ_CLOSURE: {
+            ObjClosure* cl = (ObjClosure*)o;
+            if (cl->function) cl->function = relocate(ctx, cl->function);
+            if (cl->env) cl->env = relocate(ctx, cl->env);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/*    DEBUG: HEAP PRINTER   */
+
+static void print_heap_object(void* ctx, void* obj) {
+    Heap* h = ctx;
+    Obj* o = obj;
+    if (o->type == OBJ_INT) {
+        ObjInt* i = (ObjInt*)o;
+        printf("  ObjInt  %p | value=%d | marked=%d\n",
+               (void*)i, i->value, obj_is_marked(h, o));
+    } else if (o->type == OBJ_PAIR) {
+        ObjPair* p = (ObjPair*)o;
+        printf("  ObjPair %p | %s | marked=%d | left=", (void*)p,
+               gc_is_young(h, o) ? "young" : "old", obj_is_marked(h, o));
+        value_print(p->left);
+        printf(" | right=");
+        value_print(p->right);
+        printf("\n");
+    }
+}
+
+static void gc_print_heap(Heap* h, const char* phase) {
+    printf("\n[GC] HEAP DUMP (%s)\n", phase);
+
+    if (h->bytes_allocated == 0 && h->nursery_objects == 0) {
+        printf("  <empty>\n");
+        return;
+    }
+
+    young_walk(h, 0, print_heap_object);
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        slab_walk(&h->size_classes[c], print_heap_object, h);
+    }
+}
+
+/*    MARK PHASE    */
+
+/* young objects keep their mark in nursery_marks, old ones in their slab */
+static int obj_mark(Heap* h, Obj* o) {
+    return gc_is_young(h, o) ? young_test_and_set(h, o) : slab_mark(o);
+}
+
+static int obj_is_marked(Heap* h, Obj* o) {
+    return gc_is_young(h, o) ? young_is_set(h, o) : slab_is_marked(o);
+}
+
+/* trace up to budget gray objects (budget < 0: all of them); returns work done */
+static int mark_drain_some(Heap* h, int budget) {
+    int work = 0;
+    Obj* o;
+    while (budget < 0 || work < budget) {
+        if ((o = mark_pop(h)) == NULL) break;
+        work++;
+        if (!obj_mark(h, o)) continue;   /* already black */
+
+        h->objects_reachable++;
+        obj_visit_children(o, mark_push, h);
+    }
+    return work;
+}
+
+static void mark_drain(Heap* h) {
+    mark_drain_some(h, -1);
+}
+
+static int mark_stack_empty(Heap* h) {
+    return h->mark_top->top == 0 && h->mark_top->prev == NULL;
+}
+
+/* overflow recovery: re-push unmarked children of every marked object */
+static void rescan_marked(void* ctx, void* obj) {
+    obj_visit_children((Obj*)obj, mark_push, ctx);
+    mark_drain(ctx);
+}
+
+static void gc_mark_recover(Heap* h) {
+    while (h->mark_overflowed) {
+        h->mark_overflowed = 0;
+        h->mark_overflows++;
+        if (h->nursery) young_walk(h, 1, rescan_marked);
+        for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+            slab_walk_marked(&h->size_classes[c], rescan_marked, h);
+        }
+    }
+}
+
+static void gc_mark(void* ctx, Obj* root) {
+    if (!root) return;
+
+    mark_push(ctx, root);
+    mark_drain(ctx);
+    gc_mark_recover(ctx);
+}
+
+static void gc_finish_cycle(Heap* h);
+
+/* count reachable objects without disturbing the next collection */
+void checkstack(Heap* h){
+    gc_finish_cycle(h);   /* the count reuses the mark bits */
+    gc_sweeper_wait(h);
+    h->objects_reachable = 0;
+    gc_mark_from_roots(h);
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        slab_clear_marks(&h->size_classes[c]);
+    }
+    if (h->nursery) memset(h->nursery_marks, 0, nursery_mark_words(h) * sizeof(uint64_t));
+}
+
+void gc_mark_from_roots(Heap* h) {
+    vm_visit_roots(h->program, gc_mark, h);
+}
+
+/*    SWEEP PHASE    */
+
+static void sweep_report(void* obj) {
+    printf("[GC] freeing %p\n", obj);
+}
+
+void gc_sweep(Heap* h, int show_debug) {
+    /* dead slots (used & ~mark) go back on their class free list */
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        int freed = slab_sweep(&h->size_classes[c], show_debug ? sweep_report : NULL);
+        h->objects_freed += freed;
+        h->bytes_allocated -= (size_t)freed * h->size_classes[c].slot_size;
+    }
+    h->objects_reachable = 0;
+}
+
+/*    PARALLEL FULL GC    */
+
+void gc_set_background_sweep(Heap* h, int enabled) {
+    h->background_sweep = enabled;
+}
+
+void gc_set_threads(Heap* h, int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > GC_MAX_THREADS) threads = GC_MAX_THREADS;
+    h->threads = threads;
+}
+
+static void gc_sweep_parallel(Heap* h) {
+    int freed = 0;
+    size_t bytes = 0;
+
+    gc_parallel_sweep(h->size_classes, HEAP_SIZE_CLASSES, h->threads, &freed, &bytes);
+    h->objects_freed += freed;
+    h->bytes_allocated -= bytes;
+    h->objects_reachable = 0;
+}
+
+/*    MARK-COMPACT    */
+
+/*
+ * Optional replacement for the sweep of a full collection: each size class is
+ * slid down so survivors are packed without holes, keeping their relative
+ * order in the slab list (better locality for lists), and emptied slabs go
+ * back to the system. The slab list is newest first and free slots are
+ * reused, so this is not allocation order. References are rewritten
+ * from the mark bits before anything moves (see slab_compact_plan).
+ */
+void gc_set_compact(Heap* h, int enabled) {
+    h->compacting = enabled;
+}
+
+static Obj* compact_forward(void* ctx, Obj* o) {
+    (void)ctx;
+    return slab_forward(o);
+}
+
+static void fix_moved_fields(void* ctx, void* obj) {
+    obj_fix_children((Obj*)obj, compact_forward, ctx);
+}
+
+/* call after marking, with an empty nursery */
+static void gc_compact(Heap* h) {
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        if (slab_compact_plan(&h->size_classes[c]) < 0) {
+            gc_sweep(h, 0);   /* no memory for the slab map: plain sweep */
+            return;
+        }
+    }
+
+    vm_fix_roots(h->program, compact_forward, h);
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        slab_walk_marked(&h->size_classes[c], fix_moved_fields, h);
+    }
+
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        int freed = slab_compact_move(&h->size_classes[c]);
+        h->objects_freed += freed;
+        h->bytes_allocated -= (size_t)freed * h->size_classes[c].slot_size;
+    }
+    h->objects_reachable = 0;
+}
+
+/*    MINOR GC (NURSERY EVACUATION)    */
+
+/* copy a young object into old space once; later calls follow the forwarding pointer */
+static Obj* evacuate(void* ctx, Obj* o) {
+    Heap* h = ctx;
+    if (!gc_is_young(h, o)) return o;
+    if (!young_test_and_set(h, o)) return ((Obj**)o)[1];
+
+    Obj* copy = old_alloc(h, o->type);
+    if (!copy) vm_error(h->program, "out of memory during minor GC");
+    memcpy(copy, o, young_size(o->type));
+    ((Obj**)o)[1] = copy;
+
+    h->promoted_objects++;
+    charge_old(h, obj_size(h, copy->type));
+
+    if (h->promoted_count == h->promoted_cap) {
+        h->promoted_scan = grow_array(h, h->promoted_scan, &h->promoted_cap, sizeof(Obj*));
+    }
+    h->promoted_scan[h->promoted_count++] = copy;
+    return copy;
+}
+
+static void report_dead_young(void* ctx, void* obj) {
+    if (!young_is_set(ctx, obj)) printf("[GC] freeing %p (young)\n", obj);
+}
+
+void gc_minor(Heap* h, int show_debug) {
+    h->minor_requested = 0;
+    update_request(h);
+    if (!h->nursery || h->nursery_objects == 0) return;
+
+    h->promoted_objects = 0;
+
+    /* roots: operand stack, memory slots stored since the last minor GC */
+    vm_fix_young_roots(h->program, evacuate, h);
+
+    /* old objects that were handed young references */
+    for (int i = 0; i < h->remembered_count; i++) {
+        obj_fix_children(h->remembered[i], evacuate, h);
+    }
+    h->remembered_count = 0;
+
+    /* transitively copy whatever the promoted objects still reference */
+    while (h->promoted_count > 0) {
+        obj_fix_children(h->promoted_scan[--h->promoted_count], evacuate, h);
+    }
+
+    if (show_debug) young_walk(h, 0, report_dead_young);
+
+    h->objects_freed += h->nursery_objects - h->promoted_objects;
+    h->nursery_objects = 0;
+    h->nursery_top = 0;
+    memset(h->nursery_marks, 0, nursery_mark_words(h) * sizeof(uint64_t));
+    h->minor_cycles++;
+}
+
+size_t gc_nursery_used(const Heap* h) {
+    return h->nursery_top;
+}
+
+size_t gc_nursery_size(const Heap* h) {
+    return h->nursery_size;
+}
+
+/*    INCREMENTAL GC (TRI-COLOR)    */
+
+/*
+ * White = unmarked, gray = on the mark stack, black = marked. With a work
+ * budget set, crossing the heap threshold starts a cycle instead of a full
+ * gc_collect(), and every gc_interval safepoints gc_step() traces or sweeps
+ * about gc_budget units of work. While marking:
+ *  - gc_shade() greys every reference stored into a pair, closure or memory
+ *    slot (write barrier on PAIR and STORE);
+ *  - objects allocated or promoted during the cycle are allocated black;
+ *  - the operand stack is not barriered, so the roots are rescanned once the
+ *    gray set runs dry, before sweeping starts.
+ * Sweeping is lazy: one slab per SWEEP_SLAB_WORK units, allocating black from
+ * slabs that have not been swept yet.
+ */
+#define SWEEP_SLAB_WORK 64
+
+void gc_set_incremental(Heap* h, int budget, int interval) {
+    h->budget = budget > 0 ? budget : 0;
+    h->interval = interval > 0 ? interval : 1;
+}
+
+const char* gc_phase_name(const Heap* h) {
+    switch (h->phase) {
+        case GC_MARKING:  return "marking";
+        case GC_SWEEPING: return "sweeping";
+        default:          return "idle";
+    }
+}
+
+static void set_next_threshold(Heap* h) {
+    /* next automatic cycle once the heap grows by grow_factor over the live set */
+    h->next_gc = h->bytes_allocated * h->grow_factor;
+    if (h->next_gc < h->min_threshold) h->next_gc = h->min_threshold;
+}
+
+static void begin_cycle(Heap* h) {
+    gc_sweeper_wait(h);                       /* marking needs the previous sweep done */
+    gc_minor(h, 0);                           /* every object is old while marking */
+    h->objects_reachable = 0;
+    vm_visit_roots(h->program, mark_push, h); /* roots start gray */
+    h->phase = GC_MARKING;
+    h->major_requested = 0;
+    h->step_countdown = h->interval;
+}
+
+static void end_cycle(Heap* h);
+
+static void finish_marking(Heap* h) {
+    vm_visit_roots(h->program, mark_push, h);
+    mark_drain(h);
+    gc_mark_recover(h);
+
+    if (h->background_sweep) {
+        gc_sweeper_start(h);
+        end_cycle(h);
+        return;
+    }
+
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        slab_sweep_begin(&h->size_classes[c]);
+    }
+    h->sweep_class = 0;
+    h->phase = GC_SWEEPING;
+}
+
+/* sweep one pending slab; returns 0 once every class is swept */
+static int sweep_next_slab(Heap* h) {
+    while (h->sweep_class < HEAP_SIZE_CLASSES && slab_sweep_done(&h->size_classes[h->sweep_class])) {
+        h->sweep_class++;
+    }
+    if (h->sweep_class == HEAP_SIZE_CLASSES) return 0;
+
+    SizeClass* cls = &h->size_classes[h->sweep_class];
+    int freed = slab_sweep_step(cls);
+    h->objects_freed += freed;
+    h->bytes_allocated -= (size_t)freed * cls->slot_size;
+    return 1;
+}
+
+static void end_cycle(Heap* h) {
+    h->phase = GC_IDLE;
+    h->objects_reachable = 0;
+    h->cycles++;
+    h->major_requested = 0;
+    set_next_threshold(h);
+}
+
+static void gc_step(Heap* h, int budget) {
+    h->incremental_steps++;
+
+    if (h->phase == GC_MARKING) {
+        budget -= mark_drain_some(h, budget);
+        if (!mark_stack_empty(h)) return;
+        finish_marking(h);
+    }
+
+    while (h->phase == GC_SWEEPING && budget > 0) {
+        if (!sweep_next_slab(h)) end_cycle(h);
+        budget -= SWEEP_SLAB_WORK;
+    }
+}
+
+/* complete a running incremental cycle without yielding */
+static void gc_finish_cycle(Heap* h) {
+    if (h->phase == GC_MARKING) finish_marking(h);
+    while (h->phase == GC_SWEEPING) {
+        if (!sweep_next_slab(h)) end_cycle(h);
+    }
+    update_request(h);
+}
+
+static long now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+void gc_safepoint(Heap* h) {
+    long start = now_us();
+
+    if (h->minor_requested) gc_minor(h, 0);
+
+    if (h->phase != GC_IDLE) {
+        if (--h->step_countdown <= 0) {
+            h->step_countdown = h->interval;
+            gc_step(h, h->budget);
+        }
+    } else if (h->major_requested) {
+        if (h->budget > 0 && !h->compacting) begin_cycle(h);
+        else gc_collect(h, 0);
+    }
+    update_request(h);
+
+    long pause = now_us() - start;
+    if (pause > h->max_pause_us) h->max_pause_us = pause;
+}
+
+/* finish whatever collector work is still in flight (incremental cycle, background sweep) */
+void gc_quiesce(Heap* h) {
+    gc_finish_cycle(h);
+    if (gc_sweeper_wait(h)) set_next_threshold(h);
+}
+
+/*    FULL GC    */
+
+void gc_collect(Heap* h, int show_debug) {
+    gc_finish_cycle(h);
+    gc_sweeper_wait(h);
+
+    if (show_debug) {
+        gc_print_heap(h, "before mark");
+    }
+
+    /* empty the nursery first so the old-space mark/sweep sees every survivor */
+    gc_minor(h, show_debug);
+
+    if (h->threads > 1) {
+        h->objects_reachable += gc_parallel_mark(h, h->threads);
+    } else {
+        gc_mark_from_roots(h);
+    }
+    
+    if (show_debug) {
+        gc_print_heap(h, "after mark (before sweep)");
+    }
+
+    if (h->compacting) {
+        gc_compact(h);
+    } else if (h->background_sweep && !show_debug) {
+        /* dead slots are reclaimed while the program keeps running */
+        gc_sweeper_start(h);
+        h->objects_reachable = 0;
+    } else if (h->threads > 1 && !show_debug) {
+        gc_sweep_parallel(h);
+    } else {
+        gc_sweep(h, show_debug); // Pass the flag down
+    }
+    
+    if (show_debug) {
+        gc_print_heap(h, "after sweep");
+    }
+
+    h->cycles++;
+    h->major_requested = 0;
+    update_request(h);
+    set_next_threshold(h);
+}
+
+void gc_start(Heap* h){
+    gc_collect(h, 0);
+}
+
+/*    HEAP LIFETIME    */
+
+Heap* heap_create(void) {
+    Heap* h = calloc(1, sizeof(Heap));
+    MarkSegment* base = calloc(1, sizeof(MarkSegment));
+    if (!h || !base) {
+        fprintf(stderr, "error: out of memory\n");
+        free(h);
+        free(base);
+        return NULL;
+    }
+
+    h->size_classes[OBJ_PAIR]     = (SizeClass)SIZE_CLASS(ObjPair);
+    h->size_classes[OBJ_INT]      = (SizeClass)SIZE_CLASS(ObjInt);
+    h->size_classes[OBJ_FUNCTION] = (SizeClass)SIZE_CLASS(ObjFunction);
+    h->size_classes[OBJ_CLOSURE]  = (SizeClass)SIZE_CLASS(ObjClosure);
+
+    h->mark_base = h->mark_top = base;
+    h->mark_segments = 1;
+
+    h->phase = GC_IDLE;
+    h->min_threshold = GC_DEFAULT_THRESHOLD;
+    h->grow_factor = GC_DEFAULT_GROW_FACTOR;
+    h->next_gc = GC_DEFAULT_THRESHOLD;
+    h->nursery_size = GC_DEFAULT_NURSERY;
+
+    h->threads = 1;
+    gc_sweeper_init(&h->sweeper);
+    h->interval = GC_DEFAULT_STEP_INTERVAL;
+    return h;
+}
+
+void heap_destroy(Heap* h) {
+    if (!h) return;
+
+    gc_sweeper_free(h);
+    for (int c = 0; c < HEAP_SIZE_CLASSES; c++) {
+        slab_release(&h->size_classes[c]);
+    }
+    while (h->mark_top != h->mark_base) {
+        MarkSegment* seg = h->mark_top;
+        h->mark_top = seg->prev;
+        free(seg);
+    }
+    free(h->mark_base);
+    free(h->mark_spare);
+    free(h->nursery);
+    free(h->nursery_marks);
+    free(h->remembered);
+    free(h->promoted_scan);
+    free(h);
 }
\ No newline at end of file
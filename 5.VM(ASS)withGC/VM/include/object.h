@@ -1,84 +1,210 @@
-#ifndef OBJECT_H
-#define OBJECT_H
-
-#include "value.h"
-
-extern int no_of_object_freed;
-extern int total_objects_created;
-extern int stack_object_count;
-
-/* All heap object types */
-typedef enum {
-    OBJ_PAIR,
-    OBJ_INT,
-    OBJ_FUNCTION,
-    OBJ_CLOSURE
-} ObjType;
-
-/* Base header for every heap object */
-typedef struct Obj {
-    ObjType type;
-    int marked;      /* for garbage collection (GC mark bit)*/
-    struct Obj* next;   /* linked list of all heap objects */
-} Obj;
-
-/* Pair object */
-typedef struct {
-    Obj base;
-    Value left;
-    Value right;
-} ObjPair;
-
-typedef struct {
-    Obj base;
-    int value;
-} ObjInt;
-
-/* Dummy definitions for new types */
-typedef struct {
-    Obj base;
-    /* In a real VM, this would point to bytecode or a C function */
-} ObjFunction;
-
-typedef struct {
-    Obj base;
-    Obj* function; /* Reference to the ObjFunction */
-    Obj* env;      /* Reference to an ObjPair or other scope object */
-} ObjClosure;
-
-/*  Heap tracking  */
-extern Obj* heap_objects;
-
-void heap_register(Obj* o);
-
-
-/* Allocation */
-ObjPair* new_pair(Value l, Value r);
-ObjInt  *new_int(int value);
-void checkstack();
-
-
-/* graph creation from list(heap) .*/
-void obj_visit_children(Obj* o, void (*visit)(Obj*));
-
-/* Additional object types for functions and closures(dummy part that is created to test the part) */
-Obj* new_function();
-Obj* new_closure(Obj* fn, Obj* env);
-/* GC roots & mark phase */
-//garbage collector functions would go here
-void gc_mark_from_roots();
-
-// void gc_add_root(Obj* o);
-
-//This is where memory is actually freed.
-void gc_sweep();
-
-// Complete garbage collection cycle
-void gc_collect(int show_debug);
-void gc_start();
-
-
-
-
-
-#endif
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stddef.h>
+#include "value.h"
+#include "slab.h"
+#include "gc_sweeper.h"
+
+/* Automatic collection: first cycle after GC_DEFAULT_THRESHOLD bytes, then
+ * whenever the heap reaches GC_DEFAULT_GROW_FACTOR x the surviving bytes. */
+#define GC_DEFAULT_THRESHOLD   (1024 * 1024)
+#define GC_DEFAULT_GROW_FACTOR 2
+
+/* Young generation: bump-allocated nursery evacuated into old space by minor
+ * collections. Sizes below GC_MIN_NURSERY disable it. */
+#define GC_DEFAULT_NURSERY     (256 * 1024)
+#define GC_MIN_NURSERY         1024
+
+/* Incremental mode: safepoints between two collector steps */
+#define GC_DEFAULT_STEP_INTERVAL 1
+
+/* All heap object types */
+typedef enum {
+    OBJ_PAIR,
+    OBJ_INT,
+    OBJ_FUNCTION,
+    OBJ_CLOSURE
+} ObjType;
+
+/* Base header for every heap object (objects live in slab slots, see slab.h;
+ * GC mark bits are kept in a per-slab bitmap, not in the object) */
+typedef struct Obj {
+    ObjType type;
+} Obj;
+
+/* Pair object */
+typedef struct {
+    Obj base;
+    Value left;
+    Value right;
+} ObjPair;
+
+typedef struct {
+    Obj base;
+    int value;
+} ObjInt;
+
+/* Dummy definitions for new types */
+typedef struct {
+    Obj base;
+    /* In a real VM, this would point to bytecode or a C function */
+} ObjFunction;
+
+typedef struct {
+    Obj base;
+    Obj* function; /* Reference to the ObjFunction */
+    Obj* env;      /* Reference to an ObjPair or other scope object */
+} ObjClosure;
+
+/* one size class per object type, indexed by ObjType */
+#define HEAP_SIZE_CLASSES (OBJ_CLOSURE + 1)
+
+typedef struct Program Program;       /* vm.h */
+typedef struct MarkSegment MarkSegment;
+
+/*
+ * Heap = everything the collector owns for one VM instance: slabs, nursery,
+ * mark stack, tuning and statistics. Every allocation and collection names
+ * the heap it works on, and a heap's roots are the stack and memory of its
+ * program, so any number of Program + Heap pairs can live in one process.
+ * heap_create applies the defaults above; the gc_set_* calls tune one heap.
+ * Fields below "statistics" are read-only outside object.c.
+ */
+typedef struct Heap {
+    Program* program;              /* roots (vm_visit_roots); NULL: no roots */
+
+    /* statistics */
+    int objects_created;
+    int objects_freed;
+    int objects_reachable;         /* counted by the last mark (checkstack) */
+    size_t bytes_allocated;        /* bytes currently owned by old-space objects */
+    int requested;                 /* set by the allocator, serviced at a safepoint */
+    int cycles;                    /* completed full collections */
+    int minor_cycles;              /* completed nursery collections */
+    int incremental_steps;
+    long max_pause_us;             /* longest collector pause at a safepoint */
+    int mark_overflows;            /* mark stack overflow rescans */
+
+    /* old space */
+    SizeClass size_classes[HEAP_SIZE_CLASSES];
+
+    /* mark stack */
+    MarkSegment *mark_base, *mark_top, *mark_spare;
+    int mark_segments, mark_segment_limit, mark_overflowed;
+
+    /* automatic collection */
+    int major_requested, minor_requested;
+    int phase;                     /* incremental cycle: idle, marking, sweeping */
+    size_t min_threshold;
+    int grow_factor;
+    size_t next_gc;
+
+    /* nursery */
+    unsigned char* nursery;
+    size_t nursery_size, nursery_top;
+    uint64_t* nursery_marks;
+    int nursery_objects;           /* allocated since the last minor GC */
+    Obj** remembered;              /* old objects holding young refs */
+    int remembered_count, remembered_cap;
+    Obj** promoted_scan;           /* copied objects whose fields need fixing */
+    int promoted_count, promoted_cap, promoted_objects;
+
+    /* full collections */
+    int threads;                   /* 1 = serial mark and sweep */
+    int background_sweep;
+    int compacting;
+    GcSweeper sweeper;
+
+    /* incremental collection */
+    int budget;                    /* 0 = stop-the-world */
+    int interval;                  /* safepoints per step */
+    int step_countdown;
+    int sweep_class;
+} Heap;
+
+Heap* heap_create(void);   /* NULL when out of memory */
+/* waits for a background sweep, then frees every object and the heap */
+void heap_destroy(Heap* h);
+
+/*  Heap tracking  */
+void heap_register(Heap* h, Obj* o);
+
+/* Bytes held in slabs (live objects plus free slots) */
+size_t heap_reserved_bytes(Heap* h);
+
+
+/* Allocation */
+ObjPair* new_pair(Heap* h, Value l, Value r);
+ObjInt  *new_int(Heap* h, int value);
+void checkstack(Heap* h);
+
+
+/* graph creation from list(heap) .*/
+void obj_visit_children(Obj* o, void (*visit)(void* ctx, Obj*), void* ctx);
+
+/* rewrite each reference field of o as relocate(ctx, field) (moving collectors) */
+void obj_fix_children(Obj* o, Obj* (*relocate)(void* ctx, Obj*), void* ctx);
+
+/* Additional object types for functions and closures(dummy part that is created to test the part) */
+Obj* new_function(Heap* h);
+Obj* new_closure(Heap* h, Obj* fn, Obj* env);
+/* GC roots & mark phase */
+//garbage collector functions would go here
+void gc_mark_from_roots(Heap* h);
+
+// void gc_add_root(Obj* o);
+
+//This is where memory is actually freed.
+void gc_sweep(Heap* h, int show_debug);
+
+// Complete garbage collection cycle
+void gc_collect(Heap* h, int show_debug);
+void gc_start(Heap* h);
+
+/* Generational support: nursery collection, young check and write barrier.
+ * gc_write_barrier must be called after storing v into a field of owner. */
+void gc_minor(Heap* h, int show_debug);
+int gc_is_young(const Heap* h, const Obj* o);
+void gc_write_barrier(Heap* h, Obj* owner, Value v);
+
+/* Incremental tri-color collection: budget = work units (objects traced,
+ * SWEEP_SLAB_WORK per slab swept) per step, one step every interval
+ * safepoints. budget 0 keeps the stop-the-world collector.
+ * gc_shade is the marking barrier for stores outside the heap (STORE). */
+void gc_set_incremental(Heap* h, int budget, int interval);
+void gc_shade(Heap* h, Value v);
+const char* gc_phase_name(const Heap* h);
+
+/* Mark and sweep of full collections on this many threads (1 = serial) */
+void gc_set_threads(Heap* h, int threads);
+
+/* Reclaim dead old-space slots on a background thread after marking */
+void gc_set_background_sweep(Heap* h, int enabled);
+
+/* Full collections slide survivors together instead of sweeping
+ * (mark-compact); incremental mode is then not used */
+void gc_set_compact(Heap* h, int enabled);
+
+/* Complete any running incremental cycle or background sweep */
+void gc_quiesce(Heap* h);
+void gc_set_nursery(Heap* h, size_t bytes);
+size_t gc_nursery_used(const Heap* h);
+size_t gc_nursery_size(const Heap* h);
+
+/* Run whatever collection the allocator requested (interpreter safepoint) */
+void gc_safepoint(Heap* h);
+
+/* Cap the mark stack at n segments of 1024 entries (0 = grow without limit).
+ * Beyond the cap marking falls back to heap rescans (h->mark_overflows). */
+void gc_set_mark_stack_limit(Heap* h, int segments);
+
+/* Tune automatic collection; initial_bytes == 0 disables it */
+void gc_set_threshold(Heap* h, size_t initial_bytes, int grow_factor);
+size_t gc_next_threshold(const Heap* h);
+
+
+
+
+
+#endif
@@ -0,0 +1,385 @@
+#include <stdlib.h>
+#include <string.h>
+#include "slab.h"
+
+static size_t slab_header_size() {
+    /* keep the first slot 16-byte aligned */
+    return (sizeof(Slab) + 15) & ~(size_t)15;
+}
+
+static void class_init(SizeClass* cls) {
+    size_t size = cls->slot_size;
+    if (size < SLAB_MIN_SLOT) size = SLAB_MIN_SLOT;
+    cls->slot_size = (size + 7) & ~(size_t)7;
+}
+
+static int bit_get(const uint64_t* map, int i) {
+    return (int)((map[i >> 6] >> (i & 63)) & 1);
+}
+
+static void bit_set(uint64_t* map, int i) {
+    map[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+static int bitmap_words(const Slab* s) {
+    return (s->capacity + 63) / 64;
+}
+
+/* bits of word w that correspond to real slots */
+static uint64_t slot_mask(const Slab* s, int w) {
+    int rem = s->capacity - w * 64;
+    return rem >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << rem) - 1);
+}
+
+static unsigned char* slot_at(const Slab* s, int i) {
+    return s->slots + (size_t)i * s->cls->slot_size;
+}
+
+/* thread the unused slots of s onto *tail, in address order */
+static FreeSlot** push_free_slots(Slab* s, FreeSlot** tail) {
+    for (int w = 0; w < bitmap_words(s); w++) {
+        uint64_t free_bits = ~s->used[w] & slot_mask(s, w);
+        while (free_bits) {
+            int i = w * 64 + __builtin_ctzll(free_bits);
+            free_bits &= free_bits - 1;
+
+            FreeSlot* f = (FreeSlot*)slot_at(s, i);
+            *tail = f;
+            tail = &f->next;
+        }
+    }
+    *tail = NULL;
+    return tail;
+}
+
+static Slab* slab_new(SizeClass* cls) {
+    Slab* s = aligned_alloc(SLAB_BYTES, SLAB_BYTES);
+    if (!s) return NULL;
+
+    memset(s, 0, sizeof(Slab));
+    s->cls = cls;
+    s->swept_epoch = cls->sweep_epoch;   /* nothing to sweep yet */
+    s->slots = (unsigned char*)s + slab_header_size();
+    s->capacity = (int)((SLAB_BYTES - slab_header_size()) / cls->slot_size);
+
+    s->next = cls->slabs;
+    cls->slabs = s;
+    cls->slab_count++;
+
+    /* only called with an empty free list: the new slots become the list */
+    push_free_slots(s, &cls->free_list);
+    return s;
+}
+
+void* slab_alloc(SizeClass* cls) {
+    if (cls->slab_count == 0) class_init(cls);
+
+    if (!cls->free_list && !slab_new(cls)) {
+        return NULL;
+    }
+
+    FreeSlot* f = cls->free_list;
+    cls->free_list = f->next;
+
+    Slab* s = slab_of(f);
+    bit_set(s->used, slab_index(s, f));
+    s->live++;
+    return f;
+}
+
+Slab* slab_of(const void* obj) {
+    return (Slab*)((uintptr_t)obj & ~(uintptr_t)(SLAB_BYTES - 1));
+}
+
+int slab_index(const Slab* s, const void* obj) {
+    return (int)(((const unsigned char*)obj - s->slots) / s->cls->slot_size);
+}
+
+int slab_mark(const void* obj) {
+    Slab* s = slab_of(obj);
+    int i = slab_index(s, obj);
+    if (bit_get(s->mark, i)) return 0;
+    bit_set(s->mark, i);
+    return 1;
+}
+
+int slab_mark_atomic(const void* obj) {
+    Slab* s = slab_of(obj);
+    int i = slab_index(s, obj);
+    uint64_t bit = (uint64_t)1 << (i & 63);
+    return !(__atomic_fetch_or(&s->mark[i >> 6], bit, __ATOMIC_RELAXED) & bit);
+}
+
+int slab_is_marked(const void* obj) {
+    Slab* s = slab_of(obj);
+    return bit_get(s->mark, slab_index(s, obj));
+}
+
+void slab_clear_marks(SizeClass* cls) {
+    for (Slab* s = cls->slabs; s; s = s->next) {
+        memset(s->mark, 0, sizeof(s->mark));
+    }
+}
+
+/* release the unmarked slots of one slab and clear its marks */
+static int sweep_slab(Slab* s, void (*on_free)(void* obj)) {
+    int freed = 0;
+
+    for (int w = 0; w < bitmap_words(s); w++) {
+        uint64_t dead = s->used[w] & ~s->mark[w];
+        if (!dead) continue;
+
+        int n = __builtin_popcountll(dead);
+        s->live -= n;
+        freed += n;
+        s->used[w] &= s->mark[w];
+
+        while (on_free && dead) {
+            int i = w * 64 + __builtin_ctzll(dead);
+            dead &= dead - 1;
+            on_free(slot_at(s, i));
+        }
+    }
+    memset(s->mark, 0, sizeof(s->mark));
+    s->swept_epoch = s->cls->sweep_epoch;
+    return freed;
+}
+
+int slab_sweep_one(Slab* s) {
+    int freed = sweep_slab(s, NULL);
+
+    /* chain this slab's free slots for slab_sweep_link */
+    s->free_head = NULL;
+    s->free_tail = push_free_slots(s, &s->free_head);
+    return freed;
+}
+
+void slab_sweep_link(SizeClass* cls) {
+    int kept_empty = 0;
+    FreeSlot** tail = &cls->free_list;
+    Slab** link = &cls->slabs;
+
+    cls->sweep_cursor = NULL;
+    while (*link) {
+        Slab* s = *link;
+
+        /* keep one empty slab around so the next allocation burst is cheap */
+        if (s->live == 0 && kept_empty) {
+            *link = s->next;
+            cls->slab_count--;
+            free(s);
+            continue;
+        }
+        if (s->live == 0) kept_empty = 1;
+
+        if (s->free_head) {
+            *tail = s->free_head;
+            tail = s->free_tail;
+        }
+        link = &s->next;
+    }
+    *tail = NULL;
+}
+
+void slab_release_empty(SizeClass* cls) {
+    Slab* kept = NULL;
+    for (Slab* s = cls->slabs; s; s = s->next) {
+        if (s->live == 0) {
+            kept = s;
+            break;
+        }
+    }
+
+    /* the free list may already be in use: drop only the doomed slots */
+    FreeSlot** link = &cls->free_list;
+    while (*link) {
+        Slab* s = slab_of(*link);
+        if (s->live == 0 && s != kept) *link = (*link)->next;
+        else link = &(*link)->next;
+    }
+
+    Slab** slab_link = &cls->slabs;
+    while (*slab_link) {
+        Slab* s = *slab_link;
+        if (s->live == 0 && s != kept) {
+            *slab_link = s->next;
+            cls->slab_count--;
+            free(s);
+            continue;
+        }
+        slab_link = &s->next;
+    }
+}
+
+int slab_sweep(SizeClass* cls, void (*on_free)(void* obj)) {
+    int freed = 0;
+
+    for (Slab* s = cls->slabs; s; s = s->next) {
+        freed += sweep_slab(s, on_free);
+        s->free_head = NULL;
+        s->free_tail = push_free_slots(s, &s->free_head);
+    }
+    slab_sweep_link(cls);
+    return freed;
+}
+
+void slab_sweep_begin(SizeClass* cls) {
+    cls->sweep_epoch++;
+    cls->sweep_cursor = cls->slabs;
+}
+
+/* dead slot found by the lazy sweeper: reuse it straight away */
+static void push_free(void* obj) {
+    SizeClass* cls = slab_of(obj)->cls;
+    FreeSlot* f = obj;
+    f->next = cls->free_list;
+    cls->free_list = f;
+}
+
+int slab_sweep_step(SizeClass* cls) {
+    /* slabs created since slab_sweep_begin sit before the cursor */
+    Slab* s = cls->sweep_cursor;
+    if (!s) return 0;
+
+    cls->sweep_cursor = s->next;
+    return sweep_slab(s, push_free);
+}
+
+int slab_sweep_done(const SizeClass* cls) {
+    return cls->sweep_cursor == NULL;
+}
+
+int slab_sweep_pending(const void* obj) {
+    const Slab* s = slab_of(obj);
+    return s->swept_epoch != s->cls->sweep_epoch;
+}
+
+void slab_walk(SizeClass* cls, void (*fn)(void* ctx, void* obj), void* ctx) {
+    for (Slab* s = cls->slabs; s; s = s->next) {
+        for (int w = 0; w < bitmap_words(s); w++) {
+            uint64_t bits = s->used[w];
+            while (bits) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                fn(ctx, slot_at(s, i));
+            }
+        }
+    }
+}
+
+void slab_walk_marked(SizeClass* cls, void (*fn)(void* ctx, void* obj), void* ctx) {
+    for (Slab* s = cls->slabs; s; s = s->next) {
+        for (int w = 0; w < bitmap_words(s); w++) {
+            uint64_t bits = s->used[w] & s->mark[w];
+            while (bits) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+                fn(ctx, slot_at(s, i));
+            }
+        }
+    }
+}
+
+void slab_release(SizeClass* cls) {
+    while (cls->slabs) {
+        Slab* s = cls->slabs;
+        cls->slabs = s->next;
+        free(s);
+    }
+    free(cls->compact_map);
+    cls->compact_map = NULL;
+    cls->compact_cap = 0;
+    cls->compact_count = 0;
+    cls->free_list = NULL;
+    cls->sweep_cursor = NULL;
+    cls->slab_count = 0;
+}
+
+/*    COMPACTION    */
+
+int slab_compact_plan(SizeClass* cls) {
+    int count = 0;
+    for (Slab* s = cls->slabs; s; s = s->next) count++;
+
+    if (count > cls->compact_cap) {
+        Slab** map = realloc(cls->compact_map, (size_t)count * sizeof(Slab*));
+        if (!map) return -1;
+        cls->compact_map = map;
+        cls->compact_cap = count;
+    }
+
+    int rank = 0;
+    int k = 0;
+    for (Slab* s = cls->slabs; s; s = s->next) {
+        cls->compact_map[k++] = s;
+        s->compact_base = rank;
+        for (int w = 0; w < bitmap_words(s); w++) {
+            rank += __builtin_popcountll(s->mark[w]);
+        }
+    }
+    cls->compact_count = count;
+    return rank;
+}
+
+void* slab_forward(const void* obj) {
+    Slab* s = slab_of(obj);
+    int i = slab_index(s, obj);
+
+    int rank = s->compact_base;
+    for (int w = 0; w < (i >> 6); w++) {
+        rank += __builtin_popcountll(s->mark[w]);
+    }
+    rank += __builtin_popcountll(s->mark[i >> 6] & (((uint64_t)1 << (i & 63)) - 1));
+
+    /* every slab of a class has the same capacity */
+    Slab* dest = s->cls->compact_map[rank / s->capacity];
+    return slot_at(dest, rank % s->capacity);
+}
+
+int slab_compact_move(SizeClass* cls) {
+    int rank = 0;
+    int was_live = 0;
+
+    /* destinations never lie after their source, so ascending order is safe */
+    for (int k = 0; k < cls->compact_count; k++) {
+        Slab* s = cls->compact_map[k];
+        was_live += s->live;
+
+        for (int w = 0; w < bitmap_words(s); w++) {
+            uint64_t bits = s->mark[w];
+            while (bits) {
+                int i = w * 64 + __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                Slab* dest = cls->compact_map[rank / s->capacity];
+                unsigned char* to = slot_at(dest, rank % s->capacity);
+                unsigned char* from = slot_at(s, i);
+                if (to != from) memcpy(to, from, cls->slot_size);
+                rank++;
+            }
+        }
+    }
+
+    /* survivors now fill the first rank slots of the class */
+    for (int k = 0; k < cls->compact_count; k++) {
+        Slab* s = cls->compact_map[k];
+        int n = rank - k * s->capacity;
+        if (n < 0) n = 0;
+        if (n > s->capacity) n = s->capacity;
+
+        memset(s->used, 0, sizeof(s->used));
+        memset(s->mark, 0, sizeof(s->mark));
+        for (int w = 0; w * 64 < n; w++) {
+            int rem = n - w * 64;
+            s->used[w] = rem >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << rem) - 1);
+        }
+        s->live = n;
+        s->swept_epoch = cls->sweep_epoch;
+
+        s->free_head = NULL;
+        s->free_tail = push_free_slots(s, &s->free_head);
+    }
+    slab_sweep_link(cls);
+
+    return was_live - rank;
+}
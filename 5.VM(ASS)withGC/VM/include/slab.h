@@ -0,0 +1,129 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Size-class slab allocator for heap objects.
+ * A slab is a SLAB_BYTES block aligned to SLAB_BYTES, so the slab that owns
+ * any object is found by masking its address. Free slots are threaded into
+ * a per-class free list through their first word.
+ */
+#define SLAB_BYTES        (16 * 1024)
+#define SLAB_MIN_SLOT     16
+#define SLAB_MAX_SLOTS    (SLAB_BYTES / SLAB_MIN_SLOT)
+#define SLAB_BITMAP_WORDS (SLAB_MAX_SLOTS / 64)
+
+typedef struct FreeSlot {
+    struct FreeSlot* next;
+} FreeSlot;
+
+struct SizeClass;
+
+typedef struct Slab {
+    struct Slab* next;                  /* next slab of the same class */
+    struct SizeClass* cls;
+    int capacity;                       /* number of slots */
+    int live;                           /* slots holding objects */
+    uint64_t used[SLAB_BITMAP_WORDS];   /* 1 bit per slot: allocated */
+    uint64_t mark[SLAB_BITMAP_WORDS];   /* 1 bit per slot: reached by GC */
+    unsigned swept_epoch;               /* == cls->sweep_epoch once swept */
+    FreeSlot* free_head;                /* this slab's free slots after a sweep */
+    FreeSlot** free_tail;
+    unsigned sweep_claim;               /* background sweep cycle that owns it */
+    int compact_base;                   /* live slots in earlier slabs (compaction) */
+    unsigned char* slots;               /* first slot (inside this block) */
+} Slab;
+
+typedef struct SizeClass {
+    const char* name;
+    size_t slot_size;                   /* rounded up on first use */
+    Slab* slabs;
+    FreeSlot* free_list;
+    int slab_count;
+    Slab* sweep_cursor;                 /* next slab for the lazy sweeper */
+    unsigned sweep_epoch;               /* bumped by slab_sweep_begin */
+    Slab** compact_map;                 /* slabs in list order (compaction) */
+    int compact_count;
+    int compact_cap;
+} SizeClass;
+
+#define SIZE_CLASS(type_name) { #type_name, sizeof(type_name), NULL, NULL, 0, NULL, 0, NULL, 0, 0 }
+
+void* slab_alloc(SizeClass* cls);
+
+/* Owning slab and slot index of an object handed out by slab_alloc */
+Slab* slab_of(const void* obj);
+int slab_index(const Slab* s, const void* obj);
+
+/* Mark bits live in the slab header, not in the objects.
+ * slab_mark returns 1 if obj was unmarked (first visit), 0 otherwise. */
+int slab_mark(const void* obj);
+int slab_is_marked(const void* obj);
+
+/* slab_mark for concurrent markers (atomic fetch-or on the bitmap word) */
+int slab_mark_atomic(const void* obj);
+void slab_clear_marks(SizeClass* cls);
+
+/*
+ * Free every allocated slot whose mark bit is clear, word by word
+ * (used & ~mark), then clear the marks. on_free (may be NULL) sees each dead
+ * object first. The free list is rebuilt in address order and surplus empty
+ * slabs are returned to the system. Returns slots freed.
+ */
+int slab_sweep(SizeClass* cls, void (*on_free)(void* obj));
+
+/*
+ * Parallel sweeping, in two halves: slab_sweep_one only touches its own slab
+ * (it returns slots freed and chains the slab's free slots), so different
+ * slabs may be swept concurrently; slab_sweep_link then serially rebuilds the
+ * class free list from those chains and releases surplus empty slabs.
+ */
+int slab_sweep_one(Slab* s);
+void slab_sweep_link(SizeClass* cls);
+
+/*
+ * Release surplus empty slabs (keeping one) without rebuilding the free list:
+ * for sweeps whose chains were handed out while the mutator kept allocating
+ * (gc_sweeper), only the freed slabs' slots are taken off the list.
+ */
+void slab_release_empty(SizeClass* cls);
+
+/*
+ * Lazy sweeping: slab_sweep_begin makes every current slab pending, then each
+ * slab_sweep_step sweeps one pending slab and pushes its dead slots onto the
+ * free list. Slots allocated from a pending slab must be marked by the caller
+ * (allocate black), or the step would free them. Empty slabs are kept until
+ * the next full slab_sweep. slab_sweep_step returns slots freed.
+ */
+void slab_sweep_begin(SizeClass* cls);
+int slab_sweep_step(SizeClass* cls);
+int slab_sweep_done(const SizeClass* cls);
+int slab_sweep_pending(const void* obj);
+
+/*
+ * Sliding (Lisp-2 style) compaction of one class, using the mark bits:
+ * the k-th marked slot in slab-list order moves to the k-th slot of the
+ * class, so survivors keep their slab-list (not allocation) order and end up
+ * packed in the first slabs.
+ *  1. slab_compact_plan numbers the slabs (returns the live slot count);
+ *  2. slab_forward gives the new address of a marked object - the caller
+ *     rewrites every reference with it while objects are still in place;
+ *  3. slab_compact_move slides the objects, rebuilds the bitmaps and free
+ *     list, releases surplus empty slabs and returns the slots freed.
+ */
+int slab_compact_plan(SizeClass* cls);
+void* slab_forward(const void* obj);
+int slab_compact_move(SizeClass* cls);
+
+/* Call fn(ctx, obj) on every allocated slot of the class, slab by slab */
+void slab_walk(SizeClass* cls, void (*fn)(void* ctx, void* obj), void* ctx);
+
+/* Same, restricted to slots whose mark bit is set (fn may mark more) */
+void slab_walk_marked(SizeClass* cls, void (*fn)(void* ctx, void* obj), void* ctx);
+
+/* Return every slab of the class to the system (heap teardown) */
+void slab_release(SizeClass* cls);
+
+#endif
@@ -1,18 +1,41 @@
-#include "value.h"
-#include "object.h"
-
-/* Boxed integer constructor */
-Value make_int(int32_t x) {
-    Value v;
-    v.type = VAL_OBJ;
-    v.obj = (Obj*)new_int(x);   /* heap allocation */
-    return v;
-}
-
-/* Wrap existing object */
-Value make_obj(Obj* o) {
-    Value v;
-    v.type = VAL_OBJ;
-    v.obj = o;
-    return v;
-}
+#include <stdio.h>
+#include "value.h"
+#include "object.h"
+
+/* Immediate integer constructor: no heap allocation */
+Value make_int(int32_t x) {
+    Value v;
+    v.type = VAL_INT;
+    v.num = x;
+    return v;
+}
+
+/* Wrap existing object */
+Value make_obj(Obj* o) {
+    Value v;
+    v.type = VAL_OBJ;
+    v.obj = o;
+    return v;
+}
+
+void value_print(Value v) {
+    switch (v.type) {
+        case VAL_INT:
+            printf("Int value=%d", v.num);
+            break;
+        case VAL_OBJ:
+            if (v.obj == NULL) {
+                printf("<invalid>");
+            } else if (v.obj->type == OBJ_INT) {
+                printf("ObjInt value=%d", ((ObjInt*)v.obj)->value);
+            } else if (v.obj->type == OBJ_PAIR) {
+                printf("ObjPair %p", (void*)v.obj);
+            } else {
+                printf("Obj(type=%d) %p", v.obj->type, (void*)v.obj);
+            }
+            break;
+        default:
+            printf("nil");
+            break;
+    }
+}
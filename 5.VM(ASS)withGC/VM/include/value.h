@@ -1,25 +1,32 @@
-#ifndef VALUE_H
-#define VALUE_H
-
-#include <stdint.h>
-
-/* Forward declaration of Obj (defined in object.h later) */
-typedef struct Obj Obj;
-
-/* What kind of value is this? */
-typedef enum {
-    VAL_NIL,
-    VAL_OBJ
-} ValueType;
-
-/* A VM stack cell */
-typedef struct {
-    ValueType type;
-    Obj* obj;
-} Value;
-
-/* Constructors */
-Value make_int(int32_t x);
-Value make_obj(Obj* o);
-
-#endif
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdint.h>
+
+/* Forward declaration of Obj (defined in object.h later) */
+typedef struct Obj Obj;
+
+/* What kind of value is this? */
+typedef enum {
+    VAL_NIL,
+    VAL_INT,    /* unboxed integer stored inline in the cell */
+    VAL_OBJ
+} ValueType;
+
+/* A VM stack cell */
+typedef struct {
+    ValueType type;
+    union {
+        Obj* obj;       /* VAL_OBJ: reference into the GC heap */
+        int32_t num;    /* VAL_INT: immediate integer, never on the heap */
+    };
+} Value;
+
+/* Constructors */
+Value make_int(int32_t x);
+Value make_obj(Obj* o);
+
+/* Print a value without a trailing newline (used by bvm and the debugger) */
+void value_print(Value v);
+
+#endif
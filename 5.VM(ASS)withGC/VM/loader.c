@@ -1,113 +1,764 @@
-#include "loader.h"
-
-#include <stdio.h>
-#include <stdlib.h>
-
-static int valid_opcode(unsigned char op) {
-    /* whitelist of supported opcodes */
-    switch (op) {
-        case 0x01:
-        case 0x02:
-        case 0x03:
-        case 0x10:
-        case 0x11:
-        case 0x12:
-        case 0x13:
-        case 0x14: // EQ
-        case 0x15: // NEQ
-        case 0x16: // LT
-        case 0x17: // GT
-        case 0x18: // LE
-        case 0x19: // GE
-        case 0x20:
-        case 0x21:
-        case 0x22:
-        case 0x30:
-        case 0x31:
-        case 0x40:
-        case 0x41:
-        case 0x50:
-        case 0x51:
-        case 0x52:
-        case 0xFF:
-            return 1;
-        default:
-            return 0;
-    }
-}
-
-static int needs_operand(unsigned char op) {
-    /* instructions that carry a 4-byte operand */
-    return (
-        op == 0x01 ||  /* PUSH */
-        op == 0x20 ||  /* JMP */
-        op == 0x21 ||  /* JZ */
-        op == 0x22 ||  /* JNZ */
-        op == 0x30 ||  /* STORE */
-        op == 0x31 ||  /* LOAD */
-        op == 0x40     /* CALL */
-    );
-}
-
-unsigned char *load_bytecode(const char *file, int *size) {
-    FILE *f = fopen(file, "rb");
-    if (!f) {
-        fprintf(stderr, "error: cannot open %s\n", file);
-        return NULL;
-    }
-
-    /* read full file into memory */
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    unsigned char *buf = malloc(file_size);
-    if (!buf) {
-        fprintf(stderr, "error: out of memory\n");
-        fclose(f);
-        return NULL;
-    }
-    if (fread(buf, 1, file_size, f) != (size_t)file_size) {
-        fprintf(stderr, "error: truncated bytecode\n");
-        free(buf);
-        fclose(f);
-        return NULL;
-    }
-    fclose(f);
-
-    *size = (int)file_size;
-    return buf;
-}
-
-int vm_validate(Program *p) {
-    int pc = 0;
-
-    while (pc < p->code_size) {
-
-        unsigned char op = p->code[pc++];
-
-        /* opcode check */
-        if (!valid_opcode(op)) {
-            fprintf(stderr, "error: invalid opcode 0x%x at pc=%d\n", op, pc - 1);
-            exit(1);
-        }
-
-        /* truncation check */
-        if (needs_operand(op)) {
-            if (pc + 4 > p->code_size) {
-                fprintf(stderr, "error: truncated instruction at pc=%d\n", pc - 1);
-                exit(1);
-            }
-            pc += 4;  /* skip operand */
-        }
-
-        /* HALT stops program */
-        if (op == 0xFF) {
-            return 1;  /* valid bytecode */
-        }
-    }
-
-    /* if no HALT found */
-    fprintf(stderr, "error: program has no HALT instruction\n");
-    exit(1);
-}
+#define _DEFAULT_SOURCE   /* madvise */
+#include "loader.h"
+#include "stack.h"
+#include "byc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int valid_opcode(unsigned char op) {
+    /* whitelist of supported opcodes */
+    switch (op) {
+        case 0x01:
+        case 0x02:
+        case 0x03:
+        case 0x10:
+        case 0x11:
+        case 0x12:
+        case 0x13:
+        case 0x14: // EQ
+        case 0x15: // NEQ
+        case 0x16: // LT
+        case 0x17: // GT
+        case 0x18: // LE
+        case 0x19: // GE
+        case 0x20:
+        case 0x21:
+        case 0x22:
+        case 0x30:
+        case 0x31:
+        case 0x40:
+        case 0x41:
+        case 0x50:
+        case 0x51:
+        case 0x52:
+        case 0xFF:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int needs_operand(unsigned char op) {
+    /* instructions that carry a 4-byte operand */
+    return (
+        op == 0x01 ||  /* PUSH */
+        op == 0x20 ||  /* JMP */
+        op == 0x21 ||  /* JZ */
+        op == 0x22 ||  /* JNZ */
+        op == 0x30 ||  /* STORE */
+        op == 0x31 ||  /* LOAD */
+        op == 0x40     /* CALL */
+    );
+}
+
+static int read_int32(const unsigned char *code, int offset) {
+    /* little-endian 4-byte integer */
+    uint32_t b0 = (uint32_t)code[offset];
+    uint32_t b1 = (uint32_t)code[offset + 1] << 8;
+    uint32_t b2 = (uint32_t)code[offset + 2] << 16;
+    uint32_t b3 = (uint32_t)code[offset + 3] << 24;
+    return (int)(int32_t)(b0 | b1 | b2 | b3);
+}
+
+unsigned char *load_bytecode(const char *file, int *size) {
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "error: cannot open %s\n", file);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(stderr, "error: cannot open %s\n", file);
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > INT_MAX) {
+        fprintf(stderr, "error: bytecode too large\n");
+        close(fd);
+        return NULL;
+    }
+
+    /* map the file instead of copying it; an empty file gets one zero page */
+    void *code;
+    if (st.st_size > 0) {
+        code = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    } else {
+        code = mmap(NULL, 1, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    close(fd);   /* the mapping keeps the file referenced */
+    if (code == MAP_FAILED) {
+        fprintf(stderr, "error: cannot map %s\n", file);
+        return NULL;
+    }
+
+    /* vm_decode reads it once front to back; start the read-ahead now */
+    if (st.st_size > 0) {
+        madvise(code, (size_t)st.st_size, MADV_SEQUENTIAL);
+        madvise(code, (size_t)st.st_size, MADV_WILLNEED);
+    }
+
+    *size = (int)st.st_size;
+    return code;
+}
+
+/*    CONTAINER (byc.h)    */
+
+static int read_u16(const unsigned char *b) {
+    return b[0] | b[1] << 8;
+}
+
+static uint32_t read_u32(const unsigned char *b) {
+    return (uint32_t)read_int32(b, 0);
+}
+
+static int bad_container(const char *file, const char *what) {
+    fprintf(stderr, "error: %s: %s\n", file, what);
+    return 0;
+}
+
+/* point p->code at the code section and fill p->info; 0 (error printed) if malformed */
+static int read_container(Program *p, const char *file) {
+    const unsigned char *img = p->image;
+    uint32_t size = (uint32_t)p->image_size;
+    ByteInfo *info = &p->info;
+
+    if (size < BYC_HEADER_SIZE) return bad_container(file, "truncated bytecode header");
+    if (byc_crc32(img + 8, size - 8) != read_u32(img + 4)) {
+        return bad_container(file, "bytecode checksum mismatch");
+    }
+
+    info->version = read_u16(img + 8);
+    if (info->version != BYC_VERSION) {
+        fprintf(stderr, "error: %s: unsupported bytecode version %d\n", file, info->version);
+        return 0;
+    }
+
+    int sections = read_u16(img + 10);
+    if (BYC_HEADER_SIZE + (uint32_t)sections * BYC_SECTION_SIZE > size) {
+        return bad_container(file, "truncated section table");
+    }
+
+    const unsigned char *code = NULL;
+    uint32_t code_size = 0;
+    for (int i = 0; i < sections; i++) {
+        const unsigned char *sec = img + BYC_HEADER_SIZE + i * BYC_SECTION_SIZE;
+        uint32_t kind = read_u32(sec), off = read_u32(sec + 4), len = read_u32(sec + 8);
+        if (off > size || len > size - off) return bad_container(file, "section out of bounds");
+
+        switch (kind) {
+            case BYC_SEC_CODE:
+                if (code) return bad_container(file, "more than one code section");
+                code = img + off;
+                code_size = len;
+                break;
+            case BYC_SEC_LINES:
+                info->lines = img + off;
+                info->lines_size = (int)len;
+                break;
+            case BYC_SEC_SYMBOLS:
+                info->symbols = img + off;
+                info->symbols_size = (int)len;
+                break;
+            default:
+                break;   /* constant pool, or a kind from a newer assembler */
+        }
+    }
+    if (!code) return bad_container(file, "no code section");
+
+    info->flags = (int)read_u32(img + 12);
+    info->entry = (int)read_u32(img + 16);
+    info->max_stack = (int)read_u32(img + 20);
+    info->mem_slots = (int)read_u32(img + 24);
+    if (info->entry < 0 || info->max_stack < 0 || info->max_stack > STACK_LIMIT
+        || info->mem_slots < 0 || info->mem_slots > MEM_SIZE) {
+        return bad_container(file, "invalid bytecode header");
+    }
+    /* the assembler's proof starts at offset 0, so it says nothing about another entry */
+    if ((info->flags & BYC_VERIFIED) && info->entry != 0) {
+        return bad_container(file, "verified bytecode with a nonzero entry point");
+    }
+
+    p->code = (unsigned char *)code;
+    p->code_size = (int)code_size;
+    return 1;
+}
+
+const char *vm_symbol_at(const Program *p, int pc) {
+    const unsigned char *sym = p->info.symbols;
+    const unsigned char *end = sym + p->info.symbols_size;
+
+    while (sym && end - sym > 4) {
+        const char *name = (const char *)sym + 4;
+        const unsigned char *nul = memchr(name, 0, (size_t)(end - sym - 4));
+        if (!nul) break;   /* unterminated name: ignore the rest */
+
+        if (read_int32(sym, 0) == pc) return name;
+        sym = nul + 1;
+    }
+    return NULL;
+}
+
+int vm_source_line(const Program *p, int pc) {
+    for (int i = 0; i + 8 <= p->info.lines_size; i += 8) {
+        if (read_int32(p->info.lines, i) == pc) return read_int32(p->info.lines, i + 4);
+    }
+    return 0;
+}
+
+int vm_load(Program *p, Heap *heap, const char *file) {
+    int size = 0;
+    unsigned char *image = load_bytecode(file, &size);
+    if (!image) return 0;
+
+    vm_init(p, heap, image, size);
+    p->image = image;
+    p->image_size = size;
+
+    if (size >= 4 && memcmp(image, BYC_MAGIC, 4) == 0 && !read_container(p, file)) {
+        vm_free(p);
+        return 0;
+    }
+    return 1;
+}
+
+static int is_branch(unsigned char op) {
+    /* operand is a code address */
+    return op == 0x20 || op == 0x21 || op == 0x22 || op == 0x40;
+}
+
+/* out of memory abandons the program like any runtime error (vm_error) */
+static void *alloc_or_die(Program *p, size_t bytes) {
+    void *mem = malloc(bytes);
+    if (!mem) vm_error(p, "out of memory");
+    return mem;
+}
+
+int vm_decode(Program *p) {
+    int size = p->code_size;
+
+    /* pass 1: instruction boundaries (index_of[offset] = instruction index) */
+    int *index_of = alloc_or_die(p, ((size_t)size + 1) * sizeof(int));
+    int count = 0, branches = 0;
+    for (int i = 0; i <= size; i++) index_of[i] = -1;
+
+    for (int pc = 0; pc < size; ) {
+        unsigned char op = p->code[pc];
+        int width = needs_operand(op) ? 5 : 1;
+        if (pc + width > size) break;   /* truncated: decoding ends here */
+
+        index_of[pc] = count++;
+        if (is_branch(op)) branches++;
+        pc += width;
+    }
+
+    /* pass 2: fill the stream; OP_END and one OP_BAD_JUMP per bad branch follow */
+    int cap = count + 1 + branches;
+    Instr *insns = malloc((size_t)cap * sizeof(Instr));
+    int *offset = malloc((size_t)cap * sizeof(int));
+    if (!insns || !offset) {
+        free(index_of);
+        free(insns);
+        free(offset);
+        vm_error(p, "out of memory");
+    }
+    int n = 0, extra = count + 1;
+    int end_offset = size;
+
+    for (int pc = 0; n < count; ) {
+        unsigned char op = p->code[pc];
+        Instr *in = &insns[n];
+
+        offset[n] = pc;
+        in->op = valid_opcode(op) ? op : OP_INVALID;
+        in->arg = 0;
+        in->arg2 = 0;
+
+        if (needs_operand(op)) {
+            in->arg = read_int32(p->code, pc + 1);
+            pc += 5;
+            /* checked here, not only in vm_verify: a BYC_VERIFIED container skips it */
+            if ((op == 0x30 || op == 0x31) && (in->arg < 0 || in->arg >= MEM_SIZE)) in->op = OP_BAD_MEM;
+        } else {
+            pc += 1;
+        }
+
+        if (is_branch(op)) {
+            int target = in->arg;
+            if (target >= 0 && target <= size && (target == size || index_of[target] >= 0)) {
+                in->arg = target == size ? count : index_of[target];
+            } else {
+                /* reported only if the branch is taken, like before */
+                insns[extra].op = OP_BAD_JUMP;
+                insns[extra].arg = target;
+                insns[extra].arg2 = 0;
+                offset[extra] = target;
+                in->arg = extra++;
+            }
+        }
+        n++;
+        end_offset = pc;
+    }
+
+    insns[count].op = OP_END;
+    insns[count].arg = 0;
+    insns[count].arg2 = 0;
+    offset[count] = end_offset;
+
+    /* a container may name another entry; headerless files start at offset 0 */
+    int entry = p->info.entry;
+    int start = entry == 0 ? 0 : entry < size ? index_of[entry] : -1;
+
+    free(index_of);
+    free(p->insns);
+    free(p->insn_offset);
+    p->insns = insns;
+    p->insn_offset = offset;
+    p->insn_count = count;
+    p->pc = 0;
+    if (start < 0) vm_error(p, "invalid entry point %d", entry);
+    p->pc = start;
+
+    /* memory: one past the highest slot a LOAD / STORE names (bad ones are OP_BAD_MEM) */
+    int slots = 0;
+    for (int i = 0; i < count; i++) {
+        if ((insns[i].op == 0x30 || insns[i].op == 0x31) && insns[i].arg >= slots) slots = insns[i].arg + 1;
+    }
+    vm_alloc_memory(p, slots);
+    return count;
+}
+
+/*    SUPERINSTRUCTIONS    */
+
+enum { FUSE_LOAD_LOAD_ADD, FUSE_ADDI, FUSE_CMP_JZ, FUSE_INC_MEM, FUSE_KINDS };
+
+static const char *fusion_names[FUSE_KINDS] = {
+    "LOAD_LOAD_ADD", "ADDI", "CMP_JZ", "INC_MEM"
+};
+static int fusion_counts[FUSE_KINDS];
+static int fusion_before = 0, fusion_after = 0;
+
+static int is_compare(int op) {
+    return op >= 0x14 && op <= 0x19;   /* EQ .. GE */
+}
+
+/* PUSH k; ADD|SUB as an added constant (SUB of INT_MIN has no negation) */
+static int push_addend(const Instr *push, const Instr *arith, int *k) {
+    if (push->op != 0x01) return 0;
+    if (arith->op == 0x10) { *k = push->arg; return 1; }
+    if (arith->op == 0x11 && push->arg != INT_MIN) { *k = -push->arg; return 1; }
+    return 0;
+}
+
+/* fuse the first len (<= 4) instructions of in if they match; returns how many were used */
+static int match_fusion(const Instr *in, int len, Instr *out, int *kind) {
+    int k;
+
+    if (len >= 4 && in[0].op == 0x31 && push_addend(&in[1], &in[2], &k) &&
+        in[3].op == 0x30 && in[3].arg == in[0].arg) {
+        *out = (Instr){ OP_INC_MEM, in[0].arg, k };
+        *kind = FUSE_INC_MEM;
+        return 4;
+    }
+    if (len >= 3 && in[0].op == 0x31 && in[1].op == 0x31 && in[2].op == 0x10) {
+        *out = (Instr){ OP_LOAD_LOAD_ADD, in[0].arg, in[1].arg };
+        *kind = FUSE_LOAD_LOAD_ADD;
+        return 3;
+    }
+    if (len >= 2 && push_addend(&in[0], &in[1], &k)) {
+        *out = (Instr){ OP_ADDI, k, 0 };
+        *kind = FUSE_ADDI;
+        return 2;
+    }
+    if (len >= 2 && is_compare(in[0].op) && in[1].op == 0x21) {
+        *out = (Instr){ OP_CMP_JZ, in[1].arg, in[0].op };
+        *kind = FUSE_CMP_JZ;
+        return 2;
+    }
+    return 0;
+}
+
+/* entries after OP_END are the OP_BAD_JUMP targets of branches */
+static int stream_total(const Instr *insns, int count) {
+    int total = count + 1;
+    for (int i = 0; i < count; i++) {
+        if (is_branch(insns[i].op) && insns[i].arg >= total) total = insns[i].arg + 1;
+    }
+    return total;
+}
+
+/*
+ * Fuse the decoded stream in into out (which may be in itself: entries are
+ * only written at or below the one being read). new_index[i] receives the
+ * fused index of every entry i < total; is_target is zeroed scratch of total
+ * bytes. Returns the fused count.
+ */
+static int fuse_stream(const Instr *in, const int *offset, int count, int total,
+                       Instr *out, int *out_offset, int *new_index, char *is_target) {
+    for (int i = 0; i < count; i++) {
+        if (is_branch(in[i].op)) is_target[in[i].arg] = 1;
+    }
+
+    for (int k = 0; k < FUSE_KINDS; k++) fusion_counts[k] = 0;
+
+    int n = 0;
+    for (int i = 0; i < count; ) {
+        /* a group may start at a branch target but must not contain one */
+        int len = 1;
+        while (len < 4 && i + len < count && !is_target[i + len]) len++;
+
+        Instr fused;
+        int kind;
+        int used = match_fusion(&in[i], len, &fused, &kind);
+        if (used == 0) {
+            fused = in[i];
+            used = 1;
+        } else {
+            fusion_counts[kind]++;
+        }
+
+        for (int k = 0; k < used; k++) new_index[i + k] = n;
+        out_offset[n] = offset[i];
+        out[n++] = fused;
+        i += used;
+    }
+    for (int i = count; i < total; i++) {
+        new_index[i] = n + (i - count);
+        out_offset[new_index[i]] = offset[i];
+        out[new_index[i]] = in[i];
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (is_branch(out[i].op) || out[i].op == OP_CMP_JZ) {
+            out[i].arg = new_index[out[i].arg];
+        }
+    }
+
+    fusion_before = count;
+    fusion_after = n;
+    return n;
+}
+
+void vm_fuse(Program *p) {
+    int total = stream_total(p->insns, p->insn_count);
+    int *new_index = malloc((size_t)total * sizeof(int));
+    char *is_target = calloc((size_t)total, 1);
+    if (!new_index || !is_target) {
+        free(new_index);
+        free(is_target);
+        vm_error(p, "out of memory");
+    }
+
+    p->insn_count = fuse_stream(p->insns, p->insn_offset, p->insn_count, total,
+                                p->insns, p->insn_offset, new_index, is_target);
+    free(new_index);
+    free(is_target);
+}
+
+int vm_fuse_copy(Program *p, Instr **insns, int **offset, int **map, int *total) {
+    *total = stream_total(p->insns, p->insn_count);
+    *insns = malloc((size_t)*total * sizeof(Instr));
+    *offset = malloc((size_t)*total * sizeof(int));
+    *map = malloc((size_t)*total * sizeof(int));
+    char *is_target = calloc((size_t)*total, 1);
+    if (!*insns || !*offset || !*map || !is_target) {
+        free(*insns);
+        free(*offset);
+        free(*map);
+        free(is_target);
+        *insns = NULL;
+        *offset = NULL;
+        *map = NULL;
+        vm_error(p, "out of memory");
+    }
+
+    int n = fuse_stream(p->insns, p->insn_offset, p->insn_count, *total,
+                        *insns, *offset, *map, is_target);
+    free(is_target);
+    return n;
+}
+
+void vm_fusion_report() {
+    printf("Fusion: %d -> %d instructions\n", fusion_before, fusion_after);
+    for (int k = 0; k < FUSE_KINDS; k++) {
+        printf("  %-14s %d\n", fusion_names[k], fusion_counts[k]);
+    }
+}
+
+/*    VERIFIER    */
+
+#define VERIFY_DEPTH    1024               /* deepest stack proven; deeper runs checked */
+#define DEPTH_UNBOUNDED (VERIFY_DEPTH + 1)   /* may grow past it */
+#define TOP_LEVEL   (-1)                  /* not inside a CALLed function */
+#define SHARED_CODE (-2)                  /* reached from more than one function */
+
+/* abstract state before an instruction: every depth in [lo, hi] is possible */
+typedef struct {
+    int reached;
+    int queued;
+    int lo, hi;
+    int known;     /* the top of the stack is always value */
+    int value;
+    int func;      /* entry of the function running it */
+} VState;
+
+typedef struct {
+    Program *p;
+    VState *state;
+    int *ret_lo, *ret_hi;  /* per function entry, ret_lo < 0 until a RET is seen */
+    int *work;
+    int work_count;
+    int proven;            /* every reached instruction is in bounds on every path */
+    int max_depth;         /* deepest stack on any path */
+} Verifier;
+
+static void verifier_free(Verifier *v) {
+    free(v->state);
+    free(v->ret_lo);
+    free(v->ret_hi);
+    free(v->work);
+}
+
+_Noreturn static void reject(Verifier *v, int index, const char *what) {
+    int pc = vm_code_offset(v->p, index);
+    int op = what ? 0 : v->p->code[pc];   /* NULL: index is an OP_INVALID entry */
+
+    verifier_free(v);   /* vm_error may return to a host that keeps running */
+    if (!what) vm_error(v->p, "invalid opcode 0x%x at pc=%d", op, pc);
+    vm_error(v->p, "%s at pc=%d", what, pc);
+}
+
+static void reject_arg(Verifier *v, int index, const char *what, int arg) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s %d", what, arg);
+    reject(v, index, msg);
+}
+
+static void enqueue(Verifier *v, int index) {
+    if (v->state[index].queued) return;
+    v->state[index].queued = 1;
+    v->work[v->work_count++] = index;
+}
+
+/* join s into the state of instruction index */
+static void flow_to(Verifier *v, int index, VState s) {
+    VState *d = &v->state[index];
+
+    if (!d->reached) {
+        *d = s;
+        d->reached = 1;
+        d->queued = 0;
+        enqueue(v, index);
+        return;
+    }
+
+    int changed = 0;
+    if (s.lo < d->lo) { d->lo = s.lo; changed = 1; }
+    if (s.hi > d->hi) { d->hi = s.hi; changed = 1; }
+    if (d->known && (!s.known || s.value != d->value)) { d->known = 0; changed = 1; }
+    if (d->func != s.func && d->func != SHARED_CODE) { d->func = SHARED_CODE; changed = 1; }
+    if (changed) enqueue(v, index);
+}
+
+/* state after popping pop and pushing push values; rejects certain under/overflow */
+static VState apply(Verifier *v, int index, int pop, int push) {
+    VState s = v->state[index];
+
+    if (s.hi < pop) reject(v, index, "stack underflow");
+    if (s.lo - pop + push > STACK_LIMIT) reject(v, index, "stack overflow");
+    if (s.lo < pop || s.hi - pop + push > VERIFY_DEPTH) v->proven = 0;
+
+    s.lo = (s.lo < pop ? pop : s.lo) - pop + push;
+    s.hi = s.hi == DEPTH_UNBOUNDED ? s.hi : s.hi - pop + push;
+    if (s.hi > DEPTH_UNBOUNDED) s.hi = DEPTH_UNBOUNDED;
+    if (s.hi > v->max_depth) v->max_depth = s.hi;
+    s.known = 0;
+    return s;
+}
+
+/* continue every CALL of entry at its return site with the callee's RET depths */
+static void flow_returns(Verifier *v, int entry) {
+    for (int i = 0; i < v->p->insn_count; i++) {
+        if (v->state[i].reached && v->p->insns[i].op == 0x40 &&
+            (entry == SHARED_CODE || v->p->insns[i].arg == entry) &&
+            v->ret_lo[v->p->insns[i].arg] >= 0) {
+            VState s = v->state[i];
+            s.lo = v->ret_lo[v->p->insns[i].arg];
+            s.hi = v->ret_hi[v->p->insns[i].arg];
+            s.known = 0;
+            flow_to(v, i + 1, s);
+        }
+    }
+}
+
+static void record_return(Verifier *v, int entry, VState s) {
+    if (v->ret_lo[entry] < 0 || s.lo < v->ret_lo[entry]) v->ret_lo[entry] = s.lo;
+    if (s.hi > v->ret_hi[entry]) v->ret_hi[entry] = s.hi;
+}
+
+static void verify_step(Verifier *v, int i) {
+    const Instr *in = &v->p->insns[i];
+    VState s = v->state[i];
+
+    switch (in->op) {
+        case 0x01: /* PUSH */
+            s = apply(v, i, 0, 1);
+            s.known = 1;
+            s.value = in->arg;
+            flow_to(v, i + 1, s);
+            break;
+        case 0x03: { /* DUP keeps a known top */
+            VState top = s;
+            s = apply(v, i, 1, 2);
+            s.known = top.known;
+            s.value = top.value;
+            flow_to(v, i + 1, s);
+            break;
+        }
+        case 0x02: /* POP */
+            flow_to(v, i + 1, apply(v, i, 1, 0));
+            break;
+
+        case 0x30: /* STORE */
+        case 0x31: /* LOAD */
+            flow_to(v, i + 1, in->op == 0x30 ? apply(v, i, 1, 0) : apply(v, i, 0, 1));
+            break;
+
+        case 0x20: /* JMP */
+            flow_to(v, in->arg, s);
+            break;
+        case 0x21: /* JZ */
+        case 0x22: { /* JNZ: a constant condition has one successor */
+            int taken_if_zero = in->op == 0x21;
+            VState next = apply(v, i, 1, 0);
+            if (!s.known || (s.value == 0) == taken_if_zero) flow_to(v, in->arg, next);
+            if (!s.known || (s.value == 0) != taken_if_zero) flow_to(v, i + 1, next);
+            break;
+        }
+
+        case 0x40: /* CALL */
+            s.func = in->arg;
+            s.known = 0;
+            flow_to(v, in->arg, s);
+            if (v->ret_lo[in->arg] >= 0) flow_returns(v, in->arg);
+            break;
+        case 0x41: /* RET */
+            if (s.func == TOP_LEVEL) break;   /* call stack underflow at run time */
+            if (s.func == SHARED_CODE) {
+                /* may return from any function called so far */
+                for (int c = 0; c < v->p->insn_count; c++) {
+                    if (v->state[c].reached && v->p->insns[c].op == 0x40) {
+                        record_return(v, v->p->insns[c].arg, s);
+                    }
+                }
+            } else {
+                record_return(v, s.func, s);
+            }
+            flow_returns(v, s.func);
+            break;
+
+        case 0x50: /* PAIR */
+            flow_to(v, i + 1, apply(v, i, 2, 1));
+            break;
+        case 0x51: /* LEFT */
+        case 0x52: /* RIGHT */
+            flow_to(v, i + 1, apply(v, i, 1, 1));
+            break;
+
+        case 0xFF: /* HALT */
+        case OP_END:
+            break;
+        case OP_BAD_JUMP:
+            reject_arg(v, i, "invalid jump address", in->arg);
+            break;
+        case OP_BAD_MEM:
+            reject_arg(v, i, "invalid memory index", in->arg);
+            break;
+        case OP_INVALID:
+            reject(v, i, NULL);
+
+        default: /* ADD .. GE */
+            flow_to(v, i + 1, apply(v, i, 2, 1));
+    }
+}
+
+int vm_verify(Program *p) {
+    int total = p->insn_count + 1;
+    for (int i = 0; i < p->insn_count; i++) {
+        if (is_branch(p->insns[i].op) && p->insns[i].arg >= total) total = p->insns[i].arg + 1;
+    }
+
+    Verifier v = { p, NULL, NULL, NULL, NULL, 0, 1, 0 };
+    v.state = calloc((size_t)total, sizeof(VState));
+    v.ret_lo = malloc((size_t)total * sizeof(int));
+    v.ret_hi = malloc((size_t)total * sizeof(int));
+    v.work = malloc((size_t)total * sizeof(int));   /* each index queued at most once */
+    if (!v.state || !v.ret_lo || !v.ret_hi || !v.work) {
+        verifier_free(&v);
+        vm_error(p, "out of memory");
+    }
+    for (int i = 0; i < total; i++) {
+        v.ret_lo[i] = -1;
+        v.ret_hi[i] = -1;
+    }
+
+    flow_to(&v, p->pc, (VState){ .func = TOP_LEVEL });
+    while (v.work_count > 0) {
+        int i = v.work[--v.work_count];
+        v.state[i].queued = 0;
+        verify_step(&v, i);
+    }
+
+    verifier_free(&v);
+    p->verified = v.proven;
+    if (v.proven) vm_stack_reserve(p, v.max_depth);   /* the unchecked vm_run never grows it */
+    return v.proven;
+}
+
+int vm_validate(Program *p) {
+    int pc = 0;
+
+    if (p->info.flags & BYC_VERIFIED) {
+        /* checksummed container: the assembler proved what vm_verify would */
+        vm_decode(p);
+        p->verified = 1;
+        vm_stack_reserve(p, p->info.max_stack);
+        return 1;
+    }
+
+    while (pc < p->code_size) {
+
+        unsigned char op = p->code[pc++];
+
+        /* opcode check */
+        if (!valid_opcode(op)) {
+            vm_error(p, "invalid opcode 0x%x at pc=%d", op, pc - 1);
+        }
+
+        /* truncation check */
+        if (needs_operand(op)) {
+            if (pc + 4 > p->code_size) {
+                vm_error(p, "truncated instruction at pc=%d", pc - 1);
+            }
+            pc += 4;  /* skip operand */
+        }
+
+        /* HALT stops program */
+        if (op == 0xFF) {
+            vm_decode(p);
+            vm_verify(p);
+            return 1;  /* valid bytecode */
+        }
+    }
+
+    /* if no HALT found */
+    vm_error(p, "program has no HALT instruction");
+}
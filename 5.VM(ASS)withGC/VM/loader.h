@@ -1,10 +1,73 @@
-#ifndef LOADER_H
-#define LOADER_H
-
-#include "vm.h"
-
-/* loader and validation helpers (raw bytecode) */
-unsigned char *load_bytecode(const char *file, int *size);
-int vm_validate(Program *p);
-
-#endif
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "vm.h"
+
+/*
+ * Loader and validation helpers.
+ *
+ * load_bytecode maps the file read-only (MAP_PRIVATE) instead of copying
+ * it: decoding and error messages read straight from the page cache, and
+ * every VM running the same .byc shares those pages. An empty file maps one
+ * zero page, so release it with munmap(code, size > 0 ? size : 1). The file
+ * must not be truncated while it is mapped.
+ *
+ * vm_load = load_bytecode + vm_init; vm_free then unmaps the file. A .byc
+ * container (byc.h) has its checksum and section table checked, p->code is
+ * pointed at its code section and p->info filled from the header.
+ * Returns 0 (error printed) when the file cannot be loaded.
+ *
+ * vm_validate checks the code before it runs (opcodes, truncation, HALT,
+ * then vm_decode and vm_verify). A container flagged BYC_VERIFIED is only
+ * decoded: its header already proves the stack bounds, and the operand
+ * stack is committed to max_stack up front.
+ */
+unsigned char *load_bytecode(const char *file, int *size);
+int vm_load(Program *p, Heap *heap, const char *file);
+int vm_validate(Program *p);
+
+/* container debug info at code offset pc: label defined there (NULL if
+ * none) and assembly source line (0 if unknown) */
+const char *vm_symbol_at(const Program *p, int pc);
+int vm_source_line(const Program *p, int pc);
+
+/*
+ * Translate p->code into p->insns (fixed-width, operands decoded, branch
+ * targets resolved to instruction indices), set pc to the entry point (the
+ * container's, else offset 0) and allocate memory up to the highest slot a
+ * LOAD / STORE names. vm_validate calls it; callers that skip validation
+ * (the debugger) call it directly.
+ * Returns the number of decoded instructions.
+ */
+int vm_decode(Program *p);
+
+/*
+ * Abstract interpretation of the decoded stream from its entry (through
+ * CALL/RET): the operand stack depth before each reachable instruction is
+ * tracked as a range, and a PUSHed constant decides a following JZ/JNZ.
+ * Reachable code with an invalid opcode, memory index or jump target, or an
+ * underflow/overflow on every path, is rejected with an error. When every
+ * depth is proven in bounds (up to 1024), p->verified lets vm_run drop its
+ * stack checks and the operand stack is committed to the deepest one.
+ * vm_validate calls it after vm_decode; returns p->verified.
+ */
+int vm_verify(Program *p);
+
+/*
+ * Peephole pass over the decoded stream: rewrites LOAD a; LOAD b; ADD,
+ * PUSH k; ADD|SUB, <compare>; JZ and LOAD x; PUSH k; ADD|SUB; STORE x into
+ * single superinstructions. Sequences are never fused across a branch
+ * target. vm_fusion_report prints what fired in the last vm_fuse.
+ */
+void vm_fuse(Program *p);
+void vm_fusion_report();
+
+/*
+ * Fused copy of p's decoded stream (p is left as it is), for tiered
+ * execution. *map gets the fused index of each of the *total decoded
+ * entries (entries absorbed into a superinstruction map to it). The caller
+ * frees the three arrays. Returns the fused instruction count.
+ */
+int vm_fuse_copy(Program *p, Instr **insns, int **offset, int **map, int *total);
+
+#endif
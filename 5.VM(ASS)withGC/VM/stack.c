@@ -1,13 +1,74 @@
+#define _DEFAULT_SOURCE   /* MAP_ANONYMOUS, MAP_NORESERVE */
 #include "stack.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t page_size(void) {
+    static size_t page;
+    if (!page) page = (size_t)sysconf(_SC_PAGESIZE);
+    return page;
+}
+
+static size_t round_pages(size_t bytes) {
+    size_t page = page_size();
+    return (bytes + page - 1) / page * page;
+}
+
+static size_t region_bytes(size_t elem) {
+    return round_pages((size_t)STACK_LIMIT * elem) + page_size();   /* + guard page */
+}
+
+/* NULL if the address space is not there: the first region_commit reports it */
+static void *region_reserve(size_t elem) {
+    void *base = mmap(NULL, region_bytes(elem), PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return base == MAP_FAILED ? NULL : base;
+}
+
+/* commit at least need entries (cap already are); returns the new capacity */
+static int region_commit(Program *p, void *base, size_t elem, int cap, int need) {
+    if (need <= cap) return cap;
+    if (need < 2 * cap) need = 2 * cap;
+    if (need > STACK_LIMIT) need = STACK_LIMIT;
+
+    size_t bytes = round_pages((size_t)need * elem);
+    if (!base || mprotect(base, bytes, PROT_READ | PROT_WRITE) != 0) {
+        vm_error(p, "out of memory");
+    }
+    size_t entries = bytes / elem;
+    return entries > STACK_LIMIT ? STACK_LIMIT : (int)entries;
+}
+
+void vm_stacks_init(Program *p) {
+    p->stack = region_reserve(sizeof(Value));
+    p->stack_cap = 0;
+    p->call_stack = region_reserve(sizeof(int));
+    p->call_cap = 0;
+}
+
+void vm_stacks_free(Program *p) {
+    if (p->stack) munmap(p->stack, region_bytes(sizeof(Value)));
+    if (p->call_stack) munmap(p->call_stack, region_bytes(sizeof(int)));
+    p->stack = NULL;
+    p->call_stack = NULL;
+    p->stack_cap = 0;
+    p->call_cap = 0;
+}
+
+void vm_stack_reserve(Program *p, int depth) {
+    p->stack_cap = region_commit(p, p->stack, sizeof(Value), p->stack_cap, depth);
+}
 
 void vm_push(Program *p, Value value) {
-    /* prevent writing past the fixed stack */
-    if (p->sp >= STACK_MAX) {
-        fprintf(stderr, "error: stack overflow\n");
-        exit(1);
+    if (p->sp >= p->stack_cap) {
+        /* prevent growing past the reserved stack */
+        if (p->stack_cap >= STACK_LIMIT) {
+            vm_error(p, "stack overflow");
+        }
+        p->stack_cap = region_commit(p, p->stack, sizeof(Value), p->stack_cap, p->sp + 1);
     }
     p->stack[p->sp++] = value;
 }
@@ -15,17 +76,18 @@ void vm_push(Program *p, Value value) {
 Value vm_pop(Program *p) {
     /* prevent popping from an empty stack */
     if (p->sp <= 0) {
-        fprintf(stderr, "error: stack underflow\n");
-        exit(1);
+        vm_error(p, "stack underflow");
     }
     return p->stack[--p->sp];
 }
 
 void vm_push_ret(Program *p, int value) {
-    /* prevent writing past the fixed call stack */
-    if (p->csp >= STACK_MAX) {
-        fprintf(stderr, "error: call stack overflow\n");
-        exit(1);
+    if (p->csp >= p->call_cap) {
+        /* prevent growing past the reserved call stack */
+        if (p->call_cap >= STACK_LIMIT) {
+            vm_error(p, "call stack overflow");
+        }
+        p->call_cap = region_commit(p, p->call_stack, sizeof(int), p->call_cap, p->csp + 1);
     }
     p->call_stack[p->csp++] = value;
 }
@@ -33,8 +95,7 @@ void vm_push_ret(Program *p, int value) {
 int vm_pop_ret(Program *p) {
     /* prevent popping from an empty call stack */
     if (p->csp <= 0) {
-        fprintf(stderr, "error: call stack underflow\n");
-        exit(1);
+        vm_error(p, "call stack underflow");
     }
     return p->call_stack[--p->csp];
 }
@@ -3,6 +3,20 @@
 
 #include "vm.h"
 
+/*
+ * The operand and call stacks are one mapping each: STACK_LIMIT entries of
+ * address space plus a guard page, reserved PROT_NONE by vm_init, of which
+ * only the first *_cap entries are committed. A push past the committed part
+ * commits more (doubling, whole pages), so small programs touch a page or
+ * two while deep ones grow up to STACK_LIMIT. The mapping never moves, and
+ * any access past the committed part faults instead of running into the heap.
+ */
+void vm_stacks_init(Program *p);
+void vm_stacks_free(Program *p);
+
+/* commit the operand stack for depth entries up front (vm_verify: proven maximum) */
+void vm_stack_reserve(Program *p, int depth);
+
 /* operand stack helpers with safety checks */
 void vm_push(Program *p, Value value);
 Value vm_pop(Program *p);
@@ -1,199 +1,333 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include "object.h"
-#include "vm.h"
-#include "stack.h"
-#include <time.h>
-
-void run_with_timer(const char *name, void (*test_fn)(Program*), Program *p) {
-    clock_t start = clock();
-    test_fn(p);
-    clock_t end = clock();
-
-    double ms = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
-    printf("Time taken [%s]: %.3f ms\n", name, ms);
-}
-
-
-/* Helper to simulate the VM state for GC tests */
-void setup_test_vm(Program* p) {
-    p->sp = 0;
-    p->csp = 0;
-    p->instr_count = 0;
-    for (int i = 0; i < MEM_SIZE; i++) {
-        p->memory[i].type = VAL_NIL;
-        p->memory[i].obj = NULL;
-    }
-    current_program = p;
-}
-
-
-// 1.6.1 & 1.6.2: Basic Reachability & Unreachable Object Collection
-void test_reachability(Program* p) {
-    printf("\nRunning: Basic Reachability & Unreachable Collection\n");
-    ObjPair* a = new_pair(make_obj(NULL), make_obj(NULL));
-    vm_push(p, make_obj((Obj*)a));
-    
-    no_of_object_freed = 0;
-    gc_collect();
-    printf("\nGC SUMMARY when stack is not empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-    no_of_object_freed = 0;
-    vm_pop(p);
-   
-    gc_collect();
-    printf("\nGC SUMMARY when stack is empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-}
-
-// 1.6.3: Transitive Reachability
-void test_transitive(Program* p) {
-    printf("\nRunning: Transitive Reachability\n");
-    ObjPair* a = new_pair(make_obj(NULL), make_obj(NULL));
-    ObjPair* b = new_pair(make_obj((Obj*)a), make_obj(NULL));
-    vm_push(p, make_obj((Obj*)b));
-    
-    no_of_object_freed = 0;
-    gc_collect();
-    printf("\nGC SUMMARY when stack is not empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-    no_of_object_freed = 0;
-    vm_pop(p);
-   
-    gc_collect();
-    printf("\nGC SUMMARY when stack is empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-}
-
-// 1.6.4: Cyclic References
-void test_cycles(Program* p) {
-    printf("\nRunning: Cyclic References\n");
-    ObjPair* a = new_pair(make_obj(NULL), make_obj(NULL));
-    ObjPair* b = new_pair(make_obj((Obj*)a), make_obj(NULL));
-    a->right = make_obj((Obj*)b); // Create cycle: A <-> B
-    
-    vm_push(p, make_obj((Obj*)a));
-   
-    gc_collect();
-    printf("\nGC SUMMARY when stack is not empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-    no_of_object_freed = 0;
-    vm_pop(p);
-   
-    gc_collect();
-    printf("\nGC SUMMARY when stack is empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-}
-
-// 1.6.5: Deep Object Graph (Stress Test)
-void test_deep_graph(Program* p) {
-    printf("\nRunning: Deep Object Graph Stress Test\n");
-    ObjPair* root = new_pair(make_obj(NULL), make_obj(NULL));
-    ObjPair* cur = root;
-    
-    // Create a long chain of objects
-    for (int i = 0; i < 500; i++) {
-        ObjPair* next = new_pair(make_obj(NULL), make_obj(NULL));
-        cur->right = make_obj((Obj*)next);
-        cur = next;
-    }
-    
-    vm_push(p, make_obj((Obj*)root));
-    
-    no_of_object_freed = 0;
-    gc_collect();
-    printf("\nGC SUMMARY when stack is not empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-    no_of_object_freed = 0;
-    vm_pop(p);
-    
-    gc_collect();
-    printf("\nGC SUMMARY when stack is empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-}
-
-// 1.6.6: Closure Capture
-void test_closures(Program* p) {
-    printf("\nRunning: Closure Capture\n");
-    Obj* env = (Obj*)new_pair(make_int(10), make_int(20));
-    Obj* fn = new_function();
-    Obj* cl = new_closure(fn, env);
-    
-    vm_push(p, make_obj(cl));
-    
-    no_of_object_freed = 0;
-    gc_collect();
-    printf("\nGC SUMMARY when stack is not empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-    no_of_object_freed = 0;
-    vm_pop(p);
-   
-    gc_collect();
-    printf("\nGC SUMMARY when stack is empty\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-}
-
-// 1.6.7: Stress Allocation
-void test_stress_allocation(Program* p) {
-    printf("\nRunning: Stress Allocation\n");
-    for (int i = 0; i < 1000; i++) {
-        new_pair(make_obj(NULL), make_obj(NULL));
-    }
-
-    /* No roots: all objects should be collected */
-    no_of_object_freed = 0;
-    gc_collect();
-    printf("\nGC SUMMARY\n");
-    printf("Objects freed: %d\n", no_of_object_freed);
-}
-
-
-
-int main() {
-    Program prog;
-    setup_test_vm(&prog);
-    
-    int choice;
-    while (1) {
-        printf("\n--- GC Interactive Test Suite ---\n");
-        printf("1. Basic Reachability (1.6.1 & 1.6.2)\n");
-        printf("2. Transitive Reachability (1.6.3)\n");
-        printf("3. Cyclic References (1.6.4)\n");
-        printf("4. Deep Object Graph (1.6.5)\n");
-        printf("5. Closure Capture (1.6.6)\n");
-        printf("6. Stress Allocation (1.6.7)\n");
-        printf("0. Exit\n");
-        printf("Enter choice: ");
-        
-        if (scanf("%d", &choice) != 1) break;
-        if (choice == 0) break;
-        switch (choice) {
-            case 1:
-                run_with_timer("Basic Reachability", test_reachability, &prog);
-                break;
-            case 2:
-                run_with_timer("Transitive Reachability", test_transitive, &prog);
-                break;
-            case 3:
-                run_with_timer("Cyclic References", test_cycles, &prog);
-                break;
-            case 4:
-                run_with_timer("Deep Object Graph", test_deep_graph, &prog);
-                break;
-            case 5:
-                run_with_timer("Closure Capture", test_closures, &prog);
-                break;
-            case 6:
-                run_with_timer("Stress Allocation", test_stress_allocation, &prog);
-                break;
-        }
-        
-        // Final safety cleanup after each test run
-        if (heap_objects != NULL) {
-            printf("\nCleaning up remaining heap objects...\n");
-            gc_collect();
-        }
-    }
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "object.h"
+#include "vm.h"
+#include "stack.h"
+#include <time.h>
+
+void run_with_timer(const char *name, void (*test_fn)(Program*), Program *p) {
+    clock_t start = clock();
+    test_fn(p);
+    clock_t end = clock();
+
+    double ms = (double)(end - start) * 1000.0 / CLOCKS_PER_SEC;
+    printf("Time taken [%s]: %.3f ms\n", name, ms);
+}
+
+
+/* Helper to simulate the VM state for GC tests */
+void setup_test_vm(Program* p) {
+    vm_init(p, heap_create(), NULL, 0);   /* no code: empty stacks, no memory */
+}
+
+
+// 1.6.1 & 1.6.2: Basic Reachability & Unreachable Object Collection
+void test_reachability(Program* p) {
+    printf("\nRunning: Basic Reachability & Unreachable Collection\n");
+    ObjPair* a = new_pair(p->heap, make_obj(NULL), make_obj(NULL));
+    vm_push(p, make_obj((Obj*)a));
+    
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is not empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+   
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// 1.6.3: Transitive Reachability
+void test_transitive(Program* p) {
+    printf("\nRunning: Transitive Reachability\n");
+    ObjPair* a = new_pair(p->heap, make_obj(NULL), make_obj(NULL));
+    ObjPair* b = new_pair(p->heap, make_obj((Obj*)a), make_obj(NULL));
+    vm_push(p, make_obj((Obj*)b));
+    
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is not empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+   
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// 1.6.4: Cyclic References
+void test_cycles(Program* p) {
+    printf("\nRunning: Cyclic References\n");
+    ObjPair* a = new_pair(p->heap, make_obj(NULL), make_obj(NULL));
+    ObjPair* b = new_pair(p->heap, make_obj((Obj*)a), make_obj(NULL));
+    a->right = make_obj((Obj*)b); // Create cycle: A <-> B
+    
+    vm_push(p, make_obj((Obj*)a));
+   
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is not empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+   
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// 1.6.5: Deep Object Graph (Stress Test)
+void test_deep_graph(Program* p) {
+    printf("\nRunning: Deep Object Graph Stress Test\n");
+    ObjPair* root = new_pair(p->heap, make_obj(NULL), make_obj(NULL));
+    ObjPair* cur = root;
+    
+    // Create a long chain of objects
+    for (int i = 0; i < 500; i++) {
+        ObjPair* next = new_pair(p->heap, make_obj(NULL), make_obj(NULL));
+        cur->right = make_obj((Obj*)next);
+        cur = next;
+    }
+    
+    vm_push(p, make_obj((Obj*)root));
+    
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is not empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+    
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// Wide Object Graph: a 5000-node comb (each node = (leaf, next)) leaves one
+// pending leaf per node on the mark stack, well past a single 1024 segment.
+static ObjPair* build_comb(Program* p, int n) {
+    ObjPair* list = NULL;
+    for (int i = 0; i < n; i++) {
+        ObjPair* leaf = new_pair(p->heap, make_int(i), make_int(i));
+        list = new_pair(p->heap, make_obj((Obj*)leaf), list ? make_obj((Obj*)list) : make_obj(NULL));
+    }
+    return list;
+}
+
+void test_wide_graph(Program* p) {
+    printf("\nRunning: Wide Object Graph (mark stack growth + overflow recovery)\n");
+    vm_push(p, make_obj((Obj*)build_comb(p, 5000)));
+
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY with growable mark stack (expect 0)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+
+    /* one segment only: every extra push overflows and is recovered by rescans */
+    gc_set_mark_stack_limit(p->heap, 1);
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    gc_set_mark_stack_limit(p->heap, 0);
+    printf("\nGC SUMMARY with 1-segment mark stack (expect 0)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    printf("Overflow rescans so far: %d\n", p->heap->mark_overflows);
+
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty (expect 10000)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// Parallel mark/sweep: the same comb traced and swept by 4 worker threads.
+void test_parallel_gc(Program* p) {
+    printf("\nRunning: Parallel Mark & Sweep (4 threads)\n");
+    gc_set_threads(p->heap, 4);
+    vm_push(p, make_obj((Obj*)build_comb(p, 5000)));
+
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is not empty (expect 0)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty (expect 10000)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    gc_set_threads(p->heap, 1);
+}
+
+// Mark-compact: every other pair is garbage, so a sweep leaves half-empty
+// slabs behind while compaction packs the survivors and releases slabs.
+void test_compaction(Program* p) {
+    printf("\nRunning: Mark-Compact (fragmented old space)\n");
+    gc_collect(p->heap, 0);
+    gc_set_nursery(p->heap, 0);   /* allocate straight into the slabs */
+
+    ObjPair* list = NULL;
+    for (int i = 0; i < 4000; i++) {
+        new_pair(p->heap, make_int(i), make_int(i));   /* garbage in between */
+        list = new_pair(p->heap, make_int(i), list ? make_obj((Obj*)list) : make_obj(NULL));
+    }
+    vm_push(p, make_obj((Obj*)list));
+
+    gc_collect(p->heap, 0);
+    printf("Slab bytes after mark-sweep:   %zu\n", heap_reserved_bytes(p->heap));
+
+    gc_set_compact(p->heap, 1);
+    gc_collect(p->heap, 0);
+    gc_set_compact(p->heap, 0);
+    printf("Slab bytes after mark-compact: %zu\n", heap_reserved_bytes(p->heap));
+
+    /* the root was relocated: walk the moved list (expect 7998000) */
+    long sum = 0;
+    for (Value v = vm_pop(p); v.type == VAL_OBJ && v.obj; v = ((ObjPair*)v.obj)->right) {
+        sum += ((ObjPair*)v.obj)->left.num;
+    }
+    printf("Sum of survivors: %ld\n", sum);
+
+    gc_collect(p->heap, 0);
+    gc_set_nursery(p->heap, GC_DEFAULT_NURSERY);
+}
+
+// Two programs, two heaps: each collection only sees its own roots and objects.
+void test_independent_heaps(Program* p) {
+    printf("\nRunning: Independent Heaps (two programs)\n");
+    Program other;
+    setup_test_vm(&other);
+
+    vm_push(p, make_obj((Obj*)new_pair(p->heap, make_int(1), make_int(2))));
+    for (int i = 0; i < 100; i++) {
+        new_pair(other.heap, make_int(i), make_int(i));   /* garbage, other heap */
+    }
+    vm_push(&other, make_obj((Obj*)new_pair(other.heap, make_int(3), make_int(4))));
+
+    p->heap->objects_freed = 0;
+    gc_collect(other.heap, 0);
+    printf("\nGC SUMMARY of the other heap (expect 100 freed there, 0 here)\n");
+    printf("Objects freed there: %d\n", other.heap->objects_freed);
+    printf("Objects freed here: %d\n", p->heap->objects_freed);
+
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY of this heap (expect 0)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    printf("Still on the other stack: %d\n", ((ObjPair*)vm_pop(&other).obj)->left.num);
+
+    Heap* heap = other.heap;
+    vm_free(&other);
+    heap_destroy(heap);
+
+    vm_pop(p);
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty (expect 1)\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// 1.6.6: Closure Capture
+void test_closures(Program* p) {
+    printf("\nRunning: Closure Capture\n");
+    Obj* env = (Obj*)new_pair(p->heap, make_int(10), make_int(20));
+    Obj* fn = new_function(p->heap);
+    Obj* cl = new_closure(p->heap, fn, env);
+    
+    vm_push(p, make_obj(cl));
+    
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is not empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+    p->heap->objects_freed = 0;
+    vm_pop(p);
+   
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY when stack is empty\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+// 1.6.7: Stress Allocation
+void test_stress_allocation(Program* p) {
+    printf("\nRunning: Stress Allocation\n");
+    for (int i = 0; i < 1000; i++) {
+        new_pair(p->heap, make_obj(NULL), make_obj(NULL));
+    }
+
+    /* No roots: all objects should be collected */
+    p->heap->objects_freed = 0;
+    gc_collect(p->heap, 0);
+    printf("\nGC SUMMARY\n");
+    printf("Objects freed: %d\n", p->heap->objects_freed);
+}
+
+
+
+int main() {
+    Program prog;
+    setup_test_vm(&prog);
+    
+    int choice;
+    while (1) {
+        printf("\n--- GC Interactive Test Suite ---\n");
+        printf("1. Basic Reachability (1.6.1 & 1.6.2)\n");
+        printf("2. Transitive Reachability (1.6.3)\n");
+        printf("3. Cyclic References (1.6.4)\n");
+        printf("4. Deep Object Graph (1.6.5)\n");
+        printf("5. Closure Capture (1.6.6)\n");
+        printf("6. Stress Allocation (1.6.7)\n");
+        printf("7. Wide Object Graph (mark stack)\n");
+        printf("8. Parallel Mark & Sweep\n");
+        printf("9. Mark-Compact\n");
+        printf("10. Independent Heaps\n");
+        printf("0. Exit\n");
+        printf("Enter choice: ");
+        
+        if (scanf("%d", &choice) != 1) break;
+        if (choice == 0) break;
+        switch (choice) {
+            case 1:
+                run_with_timer("Basic Reachability", test_reachability, &prog);
+                break;
+            case 2:
+                run_with_timer("Transitive Reachability", test_transitive, &prog);
+                break;
+            case 3:
+                run_with_timer("Cyclic References", test_cycles, &prog);
+                break;
+            case 4:
+                run_with_timer("Deep Object Graph", test_deep_graph, &prog);
+                break;
+            case 5:
+                run_with_timer("Closure Capture", test_closures, &prog);
+                break;
+            case 6:
+                run_with_timer("Stress Allocation", test_stress_allocation, &prog);
+                break;
+            case 7:
+                run_with_timer("Wide Object Graph", test_wide_graph, &prog);
+                break;
+            case 8:
+                run_with_timer("Parallel Mark & Sweep", test_parallel_gc, &prog);
+                break;
+            case 9:
+                run_with_timer("Mark-Compact", test_compaction, &prog);
+                break;
+            case 10:
+                run_with_timer("Independent Heaps", test_independent_heaps, &prog);
+                break;
+        }
+        
+        // Final safety cleanup after each test run
+        if (prog.heap->bytes_allocated > 0) {
+            printf("\nCleaning up remaining heap objects...\n");
+            gc_collect(prog.heap, 0);
+        }
+    }
+
+    Heap* heap = prog.heap;
+    vm_free(&prog);
+    heap_destroy(heap);
+    return 0;
+}
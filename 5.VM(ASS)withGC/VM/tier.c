@@ -0,0 +1,153 @@
+#include "tier.h"
+#include "loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static void *calloc_or_die(Program *p, size_t n, size_t size) {
+    void *mem = calloc(n, size);
+    if (!mem) vm_error(p, "out of memory");
+    return mem;
+}
+
+void tier_init(Program *p, int threshold) {
+    Tiering *t = calloc_or_die(p, 1, sizeof(Tiering));
+
+    /* entries after OP_END are OP_BAD_JUMP targets; size per-entry data for all */
+    int total = p->insn_count + 1;
+    for (int i = 0; i < p->insn_count; i++) {
+        int op = p->insns[i].op;
+        int is_branch = op == 0x20 || op == 0x21 || op == 0x22 || op == 0x40;
+        if (is_branch && p->insns[i].arg >= total) total = p->insns[i].arg + 1;
+    }
+
+    t->threshold = threshold;
+    t->tier = TIER_BASE;
+    t->insns[TIER_BASE] = p->insns;
+    t->offset[TIER_BASE] = p->insn_offset;
+    t->count[TIER_BASE] = p->insn_count;
+    t->backedges = calloc_or_die(p, (size_t)total, sizeof(int));
+    t->hot = calloc_or_die(p, (size_t)total, 1);
+    t->mark = p->instr_count;
+    p->tier = t;
+}
+
+void tier_switch(Program *p, int tier) {
+    Tiering *t = p->tier;
+
+    t->tier_instrs[t->tier] += p->instr_count - t->mark;
+    t->mark = p->instr_count;
+    t->tier = tier;
+    p->insns = t->insns[tier];
+    p->insn_offset = t->offset[tier];
+    p->insn_count = t->count[tier];
+}
+
+/* runs in tier 0: the fused stream does not exist before the first promotion */
+static void build_fused(Program *p) {
+    Tiering *t = p->tier;
+    int total;
+
+    t->count[TIER_FUSED] = vm_fuse_copy(p, &t->insns[TIER_FUSED], &t->offset[TIER_FUSED],
+                                        &t->to_fused, &total);
+
+    int fused_total = t->count[TIER_FUSED] + (total - t->count[TIER_BASE]);
+    t->to_base = calloc_or_die(p, (size_t)fused_total, sizeof(int));
+    for (int i = total - 1; i >= 0; i--) {
+        t->to_base[t->to_fused[i]] = i;   /* ends at the first entry of each group */
+    }
+}
+
+static void mark_hot(Tiering *t, int i, int *work, int *n) {
+    if (i < t->count[TIER_BASE] && !t->hot[i]) {
+        t->hot[i] = 1;
+        work[(*n)++] = i;
+    }
+}
+
+/* the loop header..back, plus the bodies of the functions it calls (up to their RETs) */
+static void promote(Program *p, int header, int back) {
+    Tiering *t = p->tier;
+    const Instr *code = t->insns[TIER_BASE];
+    int *work = calloc_or_die(p, (size_t)t->count[TIER_BASE], sizeof(int));
+    int n = 0;
+
+    if (!t->insns[TIER_FUSED]) build_fused(p);
+
+    for (int i = header; i <= back; i++) t->hot[i] = 1;
+    for (int i = header; i <= back; i++) {
+        if (code[i].op == 0x40) mark_hot(t, code[i].arg, work, &n);
+    }
+    while (n > 0) {
+        int i = work[--n];
+        switch (code[i].op) {
+            case 0x41: /* RET */
+            case 0xFF: /* HALT */
+            case OP_BAD_MEM:
+            case OP_INVALID:
+                break;
+            case 0x20: /* JMP */
+                mark_hot(t, code[i].arg, work, &n);
+                break;
+            case 0x21: /* JZ */
+            case 0x22: /* JNZ */
+            case 0x40: /* CALL */
+                mark_hot(t, code[i].arg, work, &n);
+                mark_hot(t, i + 1, work, &n);
+                break;
+            default:
+                mark_hot(t, i + 1, work, &n);
+        }
+    }
+    free(work);
+
+    if (t->promotions < TIER_MAX_EVENTS) {
+        TierEvent *e = &t->events[t->promotions];
+        e->header = t->offset[TIER_BASE][header];
+        e->end = t->offset[TIER_BASE][back];
+        e->at = p->instr_count;
+    }
+    t->promotions++;
+}
+
+void tier_backedge(Program *p, int header, int back) {
+    Tiering *t = p->tier;
+    if (++t->backedges[header] >= t->threshold) promote(p, header, back);
+}
+
+void tier_report(Program *p) {
+    Tiering *t = p->tier;
+
+    t->tier_instrs[t->tier] += p->instr_count - t->mark;
+    t->mark = p->instr_count;
+
+    printf("Tiering: threshold %d, %d loop(s) promoted\n", t->threshold, t->promotions);
+    for (int i = 0; i < t->promotions && i < TIER_MAX_EVENTS; i++) {
+        printf("  loop pc=%d..%d promoted after %d instructions\n",
+               t->events[i].header, t->events[i].end, t->events[i].at);
+    }
+    if (t->promotions > TIER_MAX_EVENTS) {
+        printf("  ... %d more\n", t->promotions - TIER_MAX_EVENTS);
+    }
+    printf("Tier instructions: base %ld, fused %ld\n",
+           t->tier_instrs[TIER_BASE], t->tier_instrs[TIER_FUSED]);
+}
+
+void tier_free(Program *p) {
+    Tiering *t = p->tier;
+    if (!t) return;
+
+    /* vm_free releases the tier-0 stream */
+    p->insns = t->insns[TIER_BASE];
+    p->insn_offset = t->offset[TIER_BASE];
+    p->insn_count = t->count[TIER_BASE];
+
+    free(t->insns[TIER_FUSED]);
+    free(t->offset[TIER_FUSED]);
+    free(t->to_fused);
+    free(t->to_base);
+    free(t->backedges);
+    free(t->hot);
+    free(t);
+    p->tier = NULL;
+}
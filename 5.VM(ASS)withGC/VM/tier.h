@@ -0,0 +1,85 @@
+#ifndef TIER_H
+#define TIER_H
+
+#include "vm.h"
+
+/*
+ * Tiered execution: the program starts in the plain decoded stream (tier 0)
+ * and only pays for fusion where it loops. Every taken backward branch bumps
+ * a counter on its target; when a loop header crosses the threshold, the
+ * loop (header .. back-edge) is promoted and execution continues in the
+ * fused stream (tier 1, built on the first promotion) at that header.
+ * Functions called from the loop are promoted with it. Any branch, call or
+ * return that lands outside promoted code goes back to tier 0, so cold code
+ * keeps running unfused.
+ *
+ * p->insns / insn_offset / insn_count always describe the current tier.
+ * The call stack holds tier-0 indices, so a frame can return into either.
+ */
+#define TIER_DEFAULT_THRESHOLD 1000
+#define TIER_MAX_EVENTS 16        /* promotions kept for the report */
+
+enum { TIER_BASE, TIER_FUSED, TIER_COUNT };
+
+typedef struct {
+    int header, end;     /* byte offsets of the loop header and back-edge */
+    int at;              /* instr_count when it was promoted */
+} TierEvent;
+
+struct Tiering {
+    int threshold;
+    int tier;                     /* current tier */
+
+    Instr *insns[TIER_COUNT];     /* the two streams */
+    int *offset[TIER_COUNT];
+    int count[TIER_COUNT];
+
+    int *to_fused;                /* tier-0 index -> tier-1 index */
+    int *to_base;                 /* tier-1 index -> tier-0 index of its first entry */
+    int *backedges;               /* tier-0 index: backward branches taken to it */
+    char *hot;                    /* tier-0 index: inside a promoted loop */
+
+    int promotions;
+    TierEvent events[TIER_MAX_EVENTS];
+    long tier_instrs[TIER_COUNT]; /* instructions run in each tier */
+    int mark;                     /* instr_count at the last switch */
+};
+
+/* after vm_validate, instead of vm_fuse */
+void tier_init(Program *p, int threshold);
+
+/* slow paths of the helpers below */
+void tier_switch(Program *p, int tier);
+void tier_backedge(Program *p, int header, int back);
+
+/* current-tier index -> tier-0 index (return addresses) */
+static inline int tier_base(Program *p, int index) {
+    Tiering *t = p->tier;
+    return t->tier == TIER_BASE ? index : t->to_base[index];
+}
+
+/* continue at a tier-0 index (calls, returns); returns the new pc */
+static inline int tier_enter(Program *p, int base) {
+    Tiering *t = p->tier;
+
+    /* promoted code is entered at branch targets and return points, which start a group */
+    int tier = t->hot[base] && t->to_base[t->to_fused[base]] == base ? TIER_FUSED : TIER_BASE;
+    if (tier != t->tier) tier_switch(p, tier);
+    return tier == TIER_FUSED ? t->to_fused[base] : base;
+}
+
+/* taken JMP/JZ/JNZ/CMP_JZ from..target (current tier); returns the new pc */
+static inline int tier_jump(Program *p, int from, int target) {
+    Tiering *t = p->tier;
+    int base = tier_base(p, target);
+
+    if (!t->hot[base] && base <= tier_base(p, from)) tier_backedge(p, base, tier_base(p, from));
+    return tier_enter(p, base);
+}
+
+/* promotions and per-tier instruction counts, after vm_run */
+void tier_report(Program *p);
+/* leaves p with its tier-0 stream for vm_free */
+void tier_free(Program *p);
+
+#endif
@@ -1,66 +1,200 @@
-#include "vm.h"
-#include <stdlib.h>
-#include <stdio.h>
-
-
-Program *current_program = NULL;
-
-
-
-void vm_init(Program *p, unsigned char *code, int size) {
-    current_program = p;
-    p->code = code;
-    p->code_size = size;
-    p->pc = 0;
-    p->sp = 0;
-    p->csp = 0;
-    p->instr_count = 0;
-
-    /* clear memory so LOAD reads predictable values */
-    for (int i = 0; i < MEM_SIZE; i++){
-        p->memory[i].type = VAL_NIL;
-        p->memory[i].obj = NULL;
-    }
-}
-
-void vm_free(Program *p) {
-    /* VM owns bytecode memory */
-    free(p->code);
-}
-
-void vm_dump_bytecode(Program *p) {
-    printf("Bytecode dump (%d bytes):\n", p->code_size);
-
-    for (int i = 0; i < p->code_size; i++) {
-        printf("%02X ", p->code[i]);
-
-        /* new line every 8 bytes */
-        if ((i + 1) % 8 == 0)
-            printf("\n");
-    }
-
-    printf("\n");
-}
-
-void vm_visit_roots(void (*visit)(Obj *)) {
-    Program *p = current_program;
-    if (!p) {
-        return;
-    }
-
-    /* Visit object references on the operand stack. */
-    for (int i = 0; i < p->sp; i++) {
-        if (p->stack[i].type == VAL_OBJ && p->stack[i].obj) {
-            visit(p->stack[i].obj);
-        }
-    }
-
-    /* Visit object references in global memory slots. */
-    for (int i = 0; i < MEM_SIZE; i++) {
-        if (p->memory[i].type == VAL_OBJ && p->memory[i].obj) {
-            visit(p->memory[i].obj);
-        }
-    }
-}
-
-
+#define _POSIX_C_SOURCE 200809L   /* munmap */
+#include "vm.h"
+#include "stack.h"
+#include "include/object.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+volatile sig_atomic_t vm_interrupt;
+
+void vm_init(Program *p, Heap *heap, unsigned char *code, int size) {
+    p->heap = heap;
+    if (heap) heap->program = p;   /* the collector's roots */
+    p->on_error = NULL;
+    p->code = code;
+    p->code_size = size;
+    p->image = NULL;
+    p->image_size = 0;
+    memset(&p->info, 0, sizeof(p->info));
+    p->insns = NULL;
+    p->insn_offset = NULL;
+    p->insn_count = 0;
+    p->pc = 0;
+    p->sp = 0;
+    p->csp = 0;
+    p->instr_count = 0;
+    p->verified = 0;
+    p->tier = NULL;
+    p->memory = NULL;
+    p->mem_size = 0;
+    p->young_slots = NULL;
+    vm_stacks_init(p);
+}
+
+void vm_alloc_memory(Program *p, int slots) {
+    free(p->memory);
+    free(p->young_slots);
+
+    /* calloc: every slot starts VAL_NIL so LOAD reads predictable values */
+    p->memory = calloc(slots > 0 ? (size_t)slots : 1, sizeof(Value));
+    p->young_slots = calloc((size_t)(slots + 63) / 64 + 1, sizeof(uint64_t));
+    if (!p->memory || !p->young_slots) vm_error(p, "out of memory");
+    p->mem_size = slots;
+}
+
+void vm_store(Program *p, int idx, Value v) {
+    p->memory[idx] = v;
+    if (v.type != VAL_OBJ || !v.obj) return;
+    gc_shade(p->heap, v);
+
+    /* memory is scanned for young refs only where such a ref was stored */
+    if (gc_is_young(p->heap, v.obj)) {
+        p->young_slots[idx >> 6] |= (uint64_t)1 << (idx & 63);
+    }
+}
+
+void vm_free(Program *p) {
+    /* VM owns bytecode memory */
+    if (p->image) munmap(p->image, p->image_size > 0 ? (size_t)p->image_size : 1);
+    else free(p->code);
+    free(p->insns);
+    free(p->insn_offset);
+    free(p->memory);
+    free(p->young_slots);
+    p->memory = NULL;
+    p->young_slots = NULL;
+    p->mem_size = 0;
+    vm_stacks_free(p);
+    if (p->heap && p->heap->program == p) p->heap->program = NULL;
+}
+
+void vm_error(Program *p, const char *fmt, ...) {
+    va_list ap;
+
+    fprintf(stderr, "error: ");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+
+    if (p && p->on_error) longjmp(*p->on_error, 1);
+    exit(VM_EXIT_ERR);
+}
+
+void vm_print_stack(Program *p) {
+    printf("\n=== VM HALTED ===\n");
+
+    if (p->sp == 0) {
+        printf("Stack is empty\n");
+        return;
+    }
+
+    printf("Stack (top -> bottom):\n");
+    for (int i = p->sp - 1; i >= 0; i--) {
+        printf("[%d] ", i);
+        value_print(p->stack[i]);
+        printf("\n");
+    }
+}
+
+void vm_print_memory(Program *p) {
+    printf("\n=== GLOBAL MEMORY (VARIABLES) ===\n");
+    int empty = 1;
+
+    for (int i = 0; i < p->mem_size; i++) {
+        Value v = p->memory[i];
+        if (v.type == VAL_NIL) continue;
+
+        empty = 0;
+        printf("[%d] ", i);
+        value_print(v);
+        printf("\n");
+    }
+    if (empty) printf("(Memory is empty)\n");
+    printf("=================================\n");
+}
+
+int vm_code_offset(Program *p, int index) {
+    if (!p->insn_offset) return index;   /* not decoded: pc is still 0 */
+    return p->insn_offset[index];
+}
+
+void vm_dump_bytecode(Program *p) {
+    printf("Bytecode dump (%d bytes):\n", p->code_size);
+
+    for (int i = 0; i < p->code_size; i++) {
+        printf("%02X ", p->code[i]);
+
+        /* new line every 8 bytes */
+        if ((i + 1) % 8 == 0)
+            printf("\n");
+    }
+
+    printf("\n");
+}
+
+void vm_visit_roots(Program *p, void (*visit)(void *ctx, Obj *), void *ctx) {
+    if (!p) {
+        return;
+    }
+
+    /* Visit object references on the operand stack (VAL_INT cells hold none). */
+    for (int i = 0; i < p->sp; i++) {
+        if (p->stack[i].type == VAL_OBJ && p->stack[i].obj) {
+            visit(ctx, p->stack[i].obj);
+        }
+    }
+
+    /* Visit object references in global memory slots. */
+    for (int i = 0; i < p->mem_size; i++) {
+        if (p->memory[i].type == VAL_OBJ && p->memory[i].obj) {
+            visit(ctx, p->memory[i].obj);
+        }
+    }
+}
+
+void vm_fix_roots(Program *p, Obj *(*relocate)(void *ctx, Obj *), void *ctx) {
+    if (!p) {
+        return;
+    }
+
+    for (int i = 0; i < p->sp; i++) {
+        if (p->stack[i].type == VAL_OBJ && p->stack[i].obj) {
+            p->stack[i].obj = relocate(ctx, p->stack[i].obj);
+        }
+    }
+    for (int i = 0; i < p->mem_size; i++) {
+        if (p->memory[i].type == VAL_OBJ && p->memory[i].obj) {
+            p->memory[i].obj = relocate(ctx, p->memory[i].obj);
+        }
+    }
+}
+
+void vm_fix_young_roots(Program *p, Obj *(*relocate)(void *ctx, Obj *), void *ctx) {
+    if (!p) {
+        return;
+    }
+
+    for (int i = 0; i < p->sp; i++) {
+        if (p->stack[i].type == VAL_OBJ && p->stack[i].obj) {
+            p->stack[i].obj = relocate(ctx, p->stack[i].obj);
+        }
+    }
+
+    /* after the minor GC no slot references the nursery any more */
+    for (int w = 0; w < (p->mem_size + 63) / 64; w++) {
+        uint64_t bits = p->young_slots[w];
+        while (bits) {
+            int idx = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (p->memory[idx].type == VAL_OBJ && p->memory[idx].obj) {
+                p->memory[idx].obj = relocate(ctx, p->memory[idx].obj);
+            }
+        }
+        p->young_slots[w] = 0;
+    }
+}
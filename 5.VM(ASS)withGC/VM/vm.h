@@ -1,43 +1,130 @@
-#ifndef VM_H
-#define VM_H
-
-#include "include/value.h"
-
-
-
-#define STACK_MAX 1024  /* fixed stack capacity */
-#define MEM_SIZE  256   /* global memory slots */
-#define VM_EXIT_OK  0   /* normal termination */
-#define VM_EXIT_ERR 1   /* runtime / usage error */
-
-/* Program = runtime state of the VM */
-typedef struct {
-    unsigned char *code;   /* bytecode buffer */
-    int code_size;          /* number of bytes */
-
-    int pc;                 /* program counter */
-
-    Value stack[STACK_MAX]; /* operand stack */
-    int sp;                 /* next free slot index */
-
-    Value memory[MEM_SIZE]; /* LOAD / STORE memory */
-
-    int call_stack[STACK_MAX]; /* return address stack */
-    int csp;                   /* next free slot for call stack */
-
-    int instr_count;         /* instruction count for benchmarks */
-} Program;
-
-
-extern Program *current_program;
-
-/* VM interface */
-void vm_init(Program *p, unsigned char *code, int size);
-/*free  */
-void vm_free(Program *p);
-void vm_dump_bytecode(Program *p);
-
-/* Expose GC roots (stack + memory) to the collector. */
-void vm_visit_roots(void (*visit)(Obj *));
-
-#endif
+#ifndef VM_H
+#define VM_H
+
+#include "include/value.h"
+#include <setjmp.h>
+#include <signal.h>
+
+
+
+#define STACK_LIMIT (1 << 20) /* operand / call stack entries reserved per Program */
+#define MEM_SIZE    256       /* memory slots LOAD / STORE may address */
+#define VM_EXIT_OK  0   /* normal termination */
+#define VM_EXIT_ERR 1   /* runtime / usage error */
+
+/*
+ * Decoded instruction (see vm_decode): operands are read once at load time
+ * and branch/call targets are instruction indices. Besides the bytecode
+ * opcodes the stream uses a few internal ones.
+ */
+#define OP_END      0x00  /* after the last instruction: stop */
+#define OP_BAD_MEM  0xFC  /* LOAD / STORE of a slot outside memory: error when executed */
+#define OP_INVALID  0xFD  /* undefined opcode byte: error when executed */
+#define OP_BAD_JUMP 0xFE  /* target of a branch to a non-instruction address */
+
+/* superinstructions made by vm_fuse (not accepted in .byc files) */
+#define OP_LOAD_LOAD_ADD 0x60  /* push memory[arg] + memory[arg2] */
+#define OP_ADDI          0x61  /* top += arg (PUSH k; ADD and PUSH k; SUB) */
+#define OP_CMP_JZ        0x62  /* compare opcode arg2, jump to arg if false */
+#define OP_INC_MEM       0x63  /* memory[arg] += arg2 */
+
+typedef struct {
+    int op;
+    int arg;
+    int arg2;   /* second operand of superinstructions */
+} Instr;
+
+/* what a .byc container header says about the code (all zero for headerless files) */
+typedef struct {
+    int version;                   /* 0: headerless */
+    int flags;                     /* BYC_VERIFIED (byc.h) */
+    int entry;                     /* code offset execution starts at */
+    int max_stack;                 /* deepest operand stack, 0 = unknown */
+    int mem_slots;                 /* LOAD / STORE slots used */
+    const unsigned char *lines;    /* debug line map section, NULL if absent */
+    int lines_size;
+    const unsigned char *symbols;  /* symbol table section, NULL if absent */
+    int symbols_size;
+} ByteInfo;
+
+typedef struct Tiering Tiering;   /* tier.h */
+typedef struct Heap Heap;         /* include/object.h */
+
+/* Program = runtime state of the VM */
+typedef struct Program {
+    unsigned char *code;   /* bytecode buffer */
+    int code_size;          /* number of bytes */
+    unsigned char *image;   /* whole file mapping from vm_load (code points into it), else NULL */
+    int image_size;
+    ByteInfo info;          /* container header, see loader.h */
+
+    Instr *insns;           /* decoded code, NULL until vm_decode */
+    int *insn_offset;       /* byte offset of each decoded instruction */
+    int insn_count;         /* instructions before the OP_END entry */
+
+    int pc;                 /* program counter (index into insns) */
+
+    Value *stack;           /* operand stack (growable, see stack.h) */
+    int stack_cap;          /* entries committed */
+    int sp;                 /* next free slot index */
+
+    Value *memory;          /* LOAD / STORE memory, sized by vm_decode */
+    int mem_size;           /* slots allocated */
+    uint64_t *young_slots;  /* slots stored with nursery refs, one bit each */
+
+    int *call_stack;        /* return address stack (instruction indices, growable) */
+    int call_cap;           /* entries committed */
+    int csp;                /* next free slot for call stack */
+
+    int instr_count;         /* instruction count for benchmarks */
+    int verified;            /* vm_verify proved every stack depth in bounds */
+
+    Tiering *tier;           /* tiered execution state, NULL when off */
+
+    Heap *heap;              /* objects this program allocates; the heap's roots are ours */
+    jmp_buf *on_error;       /* vm_error unwinds here instead of exiting, when set */
+} Program;
+
+/*
+ * VM interface. Every Program is independent: its stacks, memory and heap
+ * hang off the struct, so one process can run several (the shell does).
+ * heap may be NULL only for programs that are loaded and checked, not run.
+ */
+void vm_init(Program *p, Heap *heap, unsigned char *code, int size);
+/*free  */
+void vm_free(Program *p);
+
+/* allocate slots memory cells (nil) for LOAD / STORE; vm_decode sizes it */
+void vm_alloc_memory(Program *p, int slots);
+void vm_dump_bytecode(Program *p);
+
+/* byte offset in code of decoded instruction index (debugger, messages) */
+int vm_code_offset(Program *p, int index);
+
+/* STORE with the generational write barrier */
+void vm_store(Program *p, int idx, Value v);
+
+/*
+ * Set from a signal handler to stop the running program: the run loop checks
+ * it on taken branches, calls and returns and leaves through vm_error. The
+ * embedder clears it before a run.
+ */
+extern volatile sig_atomic_t vm_interrupt;
+
+/* print "error: <fmt>" and abandon the program: longjmp to *p->on_error, else exit */
+_Noreturn void vm_error(Program *p, const char *fmt, ...);
+
+/* final stack / memory listing (bvm and the shell's run) */
+void vm_print_stack(Program *p);
+void vm_print_memory(Program *p);
+
+/* Expose GC roots (stack + memory) to the collector; visit(ctx, obj). */
+void vm_visit_roots(Program *p, void (*visit)(void *ctx, Obj *), void *ctx);
+
+/* Moving collectors: rewrite every root reference (stack + memory). */
+void vm_fix_roots(Program *p, Obj *(*relocate)(void *ctx, Obj *), void *ctx);
+
+/* Minor GC roots: the whole stack and the memory slots flagged by vm_store. */
+void vm_fix_young_roots(Program *p, Obj *(*relocate)(void *ctx, Obj *), void *ctx);
+
+#endif
@@ -1,241 +1,479 @@
-#include "assembler.h"
-#include <time.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-#define MAX_LINE 256
-#define MAX_LABELS 50
-
-/* label table */
-char label_name[MAX_LABELS][32];
-int  label_addr[MAX_LABELS];
-int  label_count = 0;
-
-
-
-/* check if word is a label */
-int is_label(char *word) {
-    int len = strlen(word);
-    return (word[len - 1] == ':');
-}
-
-/* remove ':' from label */
-void strip_colon(char *word) {
-    word[strlen(word) - 1] = '\0';
-}
-
-/* save label with address */
-void add_label(char *name, int addr) {
-    strcpy(label_name[label_count], name);
-    label_addr[label_count] = addr;
-    label_count++;
-}
-
-/* find label index */
-int find_label(char *name) {
-    for (int i = 0; i < label_count; i++) {
-        if (strcmp(label_name[i], name) == 0)
-            return i;
-    }
-    return -1;
-}
-
-/* opcode table */
-int lookup_opcode(char *m, unsigned char *op) {
-    if (strcmp(m, "PUSH") == 0) *op = 0x01;
-    else if (strcmp(m, "POP") == 0) *op = 0x02;
-    else if (strcmp(m, "DUP") == 0) *op = 0x03;
-
-    else if (strcmp(m, "ADD") == 0) *op = 0x10;
-    else if (strcmp(m, "SUB") == 0) *op = 0x11;
-    else if (strcmp(m, "MUL") == 0) *op = 0x12;
-    else if (strcmp(m, "DIV") == 0) *op = 0x13;
-    else if (strcmp(m, "EQ")  == 0) *op = 0x14;
-    else if (strcmp(m, "NEQ") == 0) *op = 0x15;
-    else if (strcmp(m, "LT")  == 0) *op = 0x16;
-    else if (strcmp(m, "GT")  == 0) *op = 0x17;
-    else if (strcmp(m, "LE")  == 0) *op = 0x18;
-    else if (strcmp(m, "GE")  == 0) *op = 0x19;
-
-    else if (strcmp(m, "JMP") == 0) *op = 0x20;
-    else if (strcmp(m, "JZ")  == 0) *op = 0x21;
-    else if (strcmp(m, "JNZ") == 0) *op = 0x22;
-
-    else if (strcmp(m, "STORE") == 0) *op = 0x30;
-    else if (strcmp(m, "LOAD")  == 0) *op = 0x31;
-
-    else if (strcmp(m, "CALL") == 0) *op = 0x40;
-    else if (strcmp(m, "RET")  == 0) *op = 0x41;
-
-    else if (strcmp(m, "PAIR")  == 0) *op = 0x50;
-    else if (strcmp(m, "LEFT")  == 0) *op = 0x51;
-    else if (strcmp(m, "RIGHT") == 0) *op = 0x52;
-
-    else if (strcmp(m, "HALT") == 0) *op = 0xFF;
-
-    else return 0;
-
-    return 1;
-}
-
-
-/* write 4-byte little endian integer */
-void write_int32(FILE *out, int val) {
-    fputc(val & 0xFF, out);
-    fputc((val >> 8) & 0xFF, out);
-    fputc((val >> 16) & 0xFF, out);
-    fputc((val >> 24) & 0xFF, out);
-}
-
-
-
-// Detect labels and calculate byte offsets
-
-void pass1_build_label_table(FILE *in) {
-    char line[MAX_LINE];
-    int pc = 0;
-
-    while (fgets(line, MAX_LINE, in)) {
-
-        /* remove comment */
-        char *c = strchr(line, ';');
-        if (c) *c = '\0';
-
-        char *word = strtok(line, " \t\n");
-        if (!word) continue;
-
-        /* label detection */
-        if (is_label(word)) {
-            strip_colon(word);
-            add_label(word, pc);
-            continue;
-        }
-
-        /* instruction size */
-        if (strcmp(word, "PUSH") == 0 || strcmp(word, "JMP") == 0 || strcmp(word, "JZ") == 0 || strcmp(word, "JNZ") == 0
-           || strcmp(word, "CALL") == 0 || strcmp(word, "STORE") == 0 || strcmp(word, "LOAD") == 0)
-            pc += 5;
-        else
-            pc += 1;
-    }
-}
-
-//   Replace labels with addresses and emit bytecode 
-void pass2_emit_bytecode(FILE *in, FILE *out) {
-    char line[MAX_LINE];
-
-    while (fgets(line, MAX_LINE, in)) {
-
-        char *c = strchr(line, ';');
-        if (c) *c = '\0';
-
-        char *mnemonic = strtok(line, " \t\n");
-        if (!mnemonic) continue;
-
-        /* skip labels */
-        if (is_label(mnemonic))
-            continue;
-
-        char *operand = strtok(NULL, " \t\n");
-
-        unsigned char opcode;
-        if (!lookup_opcode(mnemonic, &opcode)) {
-            printf("error: unknown instruction '%s'\n", mnemonic);
-            exit(1);
-        }
-
-        /* instructions that REQUIRE operand */
-        if (
-            strcmp(mnemonic, "PUSH")  == 0 ||
-            strcmp(mnemonic, "JMP")   == 0 ||
-            strcmp(mnemonic, "JZ")    == 0 ||
-            strcmp(mnemonic, "JNZ")   == 0 ||
-            strcmp(mnemonic, "STORE") == 0 ||
-            strcmp(mnemonic, "LOAD")  == 0 ||
-            strcmp(mnemonic, "CALL")  == 0
-        ) {
-            if (operand == NULL) {
-                printf("error: missing operand for %s\n", mnemonic);
-                exit(1);
-            }
-        }
-
-        /* write opcode */
-        fputc(opcode, out);
-
-        /* PUSH val */
-        if (strcmp(mnemonic, "PUSH") == 0) {
-            write_int32(out, atoi(operand));
-        }
-
-        /* JMP / JZ / JNZ / CALL label */
-        else if (
-            strcmp(mnemonic, "JMP")  == 0 ||
-            strcmp(mnemonic, "JZ")   == 0 ||
-            strcmp(mnemonic, "JNZ")  == 0 ||
-            strcmp(mnemonic, "CALL") == 0
-        ) {
-            int idx = find_label(operand);
-            if (idx == -1) {
-                printf("error: undefined label '%s'\n", operand);
-                exit(1);
-            }
-            write_int32(out, label_addr[idx]);
-        }
-
-        /* STORE idx / LOAD idx */
-        else if (
-            strcmp(mnemonic, "STORE") == 0 ||
-            strcmp(mnemonic, "LOAD")  == 0
-        ) {
-            write_int32(out, atoi(operand));
-        }
-
-        
-    }
-}
-
-//   Assemble function
-int assemble(char *infile, char *outfile) {
-    FILE *in = fopen(infile, "r");
-   
-
-    if (!in ) {
-        printf("file error\n");
-        return 1;
-    }
-
-    clock_t start = clock();
-
-    pass1_build_label_table(in);
-    rewind(in);
-    FILE *out = fopen(outfile, "wb");
-    if (!out) {
-        printf("file error\n");
-        fclose(in);
-        return 1;
-    }
-    pass2_emit_bytecode(in, out);
-
-    clock_t end = clock();
-    double time_taken = ((double)(end - start))* 1000.0 / CLOCKS_PER_SEC;
-    printf("Assemble time: %f milliseconds\n", time_taken);
-    
-    int size = ftell(out);
-    printf("Output bytecode size: %d bytes\n", size);
-    
-
-    fclose(in);
-    fclose(out);
-    return 0;
-}
-
-
-int main(int argc, char **argv) {
-    if (argc != 3) {
-        printf("use: %s input.asm output.bin\n", argv[0]);
-        return 1;
-    }
-    return assemble(argv[1], argv[2]);
-}
+#define _POSIX_C_SOURCE 200809L   /* strtok_r */
+
+#include "assembler.h"
+#include "../VM/byc.h"
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE 256
+#define MAX_LABEL_NAME 32
+
+#define MEM_SLOTS   256    /* MEM_SIZE in VM/vm.h */
+#define PROVE_DEPTH 1024   /* deepest stack proven, as vm_verify */
+
+/* label table, one per assembly */
+typedef struct {
+    char name[MAX_LABEL_NAME];
+    int addr;
+} Label;
+
+typedef struct {
+    Label *labels;
+    int count;
+    int cap;
+} LabelTable;
+
+static void out_of_memory(void) {
+    printf("error: out of memory\n");
+}
+
+/* check if word is a label */
+static int is_label(char *word) {
+    int len = strlen(word);
+    return (word[len - 1] == ':');
+}
+
+/* remove ':' from label */
+static void strip_colon(char *word) {
+    word[strlen(word) - 1] = '\0';
+}
+
+/* save label with address */
+static int add_label(LabelTable *t, char *name, int addr) {
+    if (strlen(name) >= MAX_LABEL_NAME) {
+        printf("error: label name too long '%s'\n", name);
+        return 0;
+    }
+    if (t->count == t->cap) {
+        int cap = t->cap ? t->cap * 2 : 64;
+        Label *grown = realloc(t->labels, (size_t)cap * sizeof(Label));
+        if (!grown) {
+            out_of_memory();
+            return 0;
+        }
+        t->labels = grown;
+        t->cap = cap;
+    }
+    strcpy(t->labels[t->count].name, name);
+    t->labels[t->count].addr = addr;
+    t->count++;
+    return 1;
+}
+
+/* find label index */
+static int find_label(const LabelTable *t, char *name) {
+    for (int i = 0; i < t->count; i++) {
+        if (strcmp(t->labels[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* opcode table */
+int lookup_opcode(char *m, unsigned char *op) {
+    if (strcmp(m, "PUSH") == 0) *op = 0x01;
+    else if (strcmp(m, "POP") == 0) *op = 0x02;
+    else if (strcmp(m, "DUP") == 0) *op = 0x03;
+
+    else if (strcmp(m, "ADD") == 0) *op = 0x10;
+    else if (strcmp(m, "SUB") == 0) *op = 0x11;
+    else if (strcmp(m, "MUL") == 0) *op = 0x12;
+    else if (strcmp(m, "DIV") == 0) *op = 0x13;
+    else if (strcmp(m, "EQ")  == 0) *op = 0x14;
+    else if (strcmp(m, "NEQ") == 0) *op = 0x15;
+    else if (strcmp(m, "LT")  == 0) *op = 0x16;
+    else if (strcmp(m, "GT")  == 0) *op = 0x17;
+    else if (strcmp(m, "LE")  == 0) *op = 0x18;
+    else if (strcmp(m, "GE")  == 0) *op = 0x19;
+
+    else if (strcmp(m, "JMP") == 0) *op = 0x20;
+    else if (strcmp(m, "JZ")  == 0) *op = 0x21;
+    else if (strcmp(m, "JNZ") == 0) *op = 0x22;
+
+    else if (strcmp(m, "STORE") == 0) *op = 0x30;
+    else if (strcmp(m, "LOAD")  == 0) *op = 0x31;
+
+    else if (strcmp(m, "CALL") == 0) *op = 0x40;
+    else if (strcmp(m, "RET")  == 0) *op = 0x41;
+
+    else if (strcmp(m, "PAIR")  == 0) *op = 0x50;
+    else if (strcmp(m, "LEFT")  == 0) *op = 0x51;
+    else if (strcmp(m, "RIGHT") == 0) *op = 0x52;
+
+    else if (strcmp(m, "HALT") == 0) *op = 0xFF;
+
+    else return 0;
+
+    return 1;
+}
+
+
+/* output is built in memory: the container needs the code size and checksum up front */
+void bytebuf_put(ByteBuf *b, int byte) {
+    if (b->failed) return;
+    if (b->size == b->cap) {
+        int cap = b->cap ? b->cap * 2 : 256;
+        unsigned char *grown = realloc(b->data, cap);
+        if (!grown) {
+            b->failed = 1;
+            return;
+        }
+        b->data = grown;
+        b->cap = cap;
+    }
+    b->data[b->size++] = (unsigned char)byte;
+}
+
+/* write 4-byte little endian integer */
+void bytebuf_put_int32(ByteBuf *out, int val) {
+    bytebuf_put(out, val & 0xFF);
+    bytebuf_put(out, (val >> 8) & 0xFF);
+    bytebuf_put(out, (val >> 16) & 0xFF);
+    bytebuf_put(out, (val >> 24) & 0xFF);
+}
+
+static void write_int16(ByteBuf *out, int val) {
+    bytebuf_put(out, val & 0xFF);
+    bytebuf_put(out, (val >> 8) & 0xFF);
+}
+
+static int read_int32(const unsigned char *p) {
+    return (int)((unsigned)p[0] | (unsigned)p[1] << 8 | (unsigned)p[2] << 16 | (unsigned)p[3] << 24);
+}
+
+/* next line of text, split like fgets(line, MAX_LINE, ...); 0 at the end */
+static int next_line(const char **pos, const char *end, char *line) {
+    int n = 0;
+    if (*pos >= end) return 0;
+
+    while (*pos < end && n < MAX_LINE - 1) {
+        char ch = *(*pos)++;
+        line[n++] = ch;
+        if (ch == '\n') break;
+    }
+    line[n] = '\0';
+    return 1;
+}
+
+
+// Detect labels and calculate byte offsets
+
+static int pass1_build_label_table(const char *text, const char *end, LabelTable *labels) {
+    char line[MAX_LINE];
+    int pc = 0;
+
+    while (next_line(&text, end, line)) {
+
+        /* remove comment */
+        char *c = strchr(line, ';');
+        if (c) *c = '\0';
+
+        char *save;
+        char *word = strtok_r(line, " \t\n", &save);
+        if (!word) continue;
+
+        /* label detection */
+        if (is_label(word)) {
+            strip_colon(word);
+            if (!add_label(labels, word, pc)) return 0;
+            continue;
+        }
+
+        /* instruction size */
+        if (strcmp(word, "PUSH") == 0 || strcmp(word, "JMP") == 0 || strcmp(word, "JZ") == 0 || strcmp(word, "JNZ") == 0
+           || strcmp(word, "CALL") == 0 || strcmp(word, "STORE") == 0 || strcmp(word, "LOAD") == 0)
+            pc += 5;
+        else
+            pc += 1;
+    }
+    return 1;
+}
+
+//   Replace labels with addresses and emit bytecode 
+//   (lines gets a (code offset, source line) pair per instruction)
+static int pass2_emit_bytecode(const char *text, const char *end, const LabelTable *labels,
+                               ByteBuf *out, ByteBuf *lines) {
+    char line[MAX_LINE];
+    int line_no = 0;
+
+    while (next_line(&text, end, line)) {
+        line_no++;
+
+        char *c = strchr(line, ';');
+        if (c) *c = '\0';
+
+        char *save;
+        char *mnemonic = strtok_r(line, " \t\n", &save);
+        if (!mnemonic) continue;
+
+        /* skip labels */
+        if (is_label(mnemonic))
+            continue;
+
+        char *operand = strtok_r(NULL, " \t\n", &save);
+
+        unsigned char opcode;
+        if (!lookup_opcode(mnemonic, &opcode)) {
+            printf("error: unknown instruction '%s'\n", mnemonic);
+            return 0;
+        }
+
+        /* instructions that REQUIRE operand */
+        if (
+            strcmp(mnemonic, "PUSH")  == 0 ||
+            strcmp(mnemonic, "JMP")   == 0 ||
+            strcmp(mnemonic, "JZ")    == 0 ||
+            strcmp(mnemonic, "JNZ")   == 0 ||
+            strcmp(mnemonic, "STORE") == 0 ||
+            strcmp(mnemonic, "LOAD")  == 0 ||
+            strcmp(mnemonic, "CALL")  == 0
+        ) {
+            if (operand == NULL) {
+                printf("error: missing operand for %s\n", mnemonic);
+                return 0;
+            }
+        }
+
+        bytebuf_put_int32(lines, out->size);
+        bytebuf_put_int32(lines, line_no);
+
+        /* write opcode */
+        bytebuf_put(out, opcode);
+
+        /* PUSH val */
+        if (strcmp(mnemonic, "PUSH") == 0) {
+            bytebuf_put_int32(out, atoi(operand));
+        }
+
+        /* JMP / JZ / JNZ / CALL label */
+        else if (
+            strcmp(mnemonic, "JMP")  == 0 ||
+            strcmp(mnemonic, "JZ")   == 0 ||
+            strcmp(mnemonic, "JNZ")  == 0 ||
+            strcmp(mnemonic, "CALL") == 0
+        ) {
+            int idx = find_label(labels, operand);
+            if (idx == -1) {
+                printf("error: undefined label '%s'\n", operand);
+                return 0;
+            }
+            bytebuf_put_int32(out, labels->labels[idx].addr);
+        }
+
+        /* STORE idx / LOAD idx */
+        else if (
+            strcmp(mnemonic, "STORE") == 0 ||
+            strcmp(mnemonic, "LOAD")  == 0
+        ) {
+            bytebuf_put_int32(out, atoi(operand));
+        }
+
+        
+    }
+    return 1;
+}
+
+// Stack depth before each instruction, followed along every path from
+// offset 0. Proves the header's BYC_VERIFIED when each reachable
+// instruction has a single depth that neither underflows nor passes
+// PROVE_DEPTH, every reachable LOAD / STORE slot is in range, and every path
+// ends in HALT. Programs with CALL / RET are left to vm_verify.
+// Returns 1 and fills *max_stack / *mem_slots when proven.
+static int prove_bounds(const unsigned char *code, int size, int *max_stack, int *mem_slots) {
+    int *depth = malloc(((size_t)size + 1) * sizeof(int));
+    int *work = malloc(((size_t)size + 1) * sizeof(int));
+    int count = 0, proven = 1, deepest = 0, slots = 0;
+    if (!depth || !work) {
+        free(depth);
+        free(work);
+        return -1;
+    }
+    for (int i = 0; i <= size; i++) depth[i] = -1;
+
+    if (size > 0) {
+        depth[0] = 0;
+        work[count++] = 0;
+    }
+    while (proven && count > 0) {
+        int pc = work[--count];
+        int d = depth[pc];
+        int op = code[pc];
+        int width = op == 0x01 || (op >= 0x20 && op <= 0x22) || op == 0x30 || op == 0x31
+                    || op == 0x40 ? 5 : 1;
+        int pops = 0, pushes = 0, target = -1, falls = 1;
+
+        /* the code may come from outside (assemble_container): check before reading */
+        if (pc + width > size) {
+            proven = 0;
+            break;
+        }
+        int arg = width == 5 ? read_int32(code + pc + 1) : 0;
+
+        switch (op) {
+            case 0x01: pushes = 1; break;                         /* PUSH */
+            case 0x02: pops = 1; break;                           /* POP */
+            case 0x03: pops = 1; pushes = 2; break;               /* DUP */
+            case 0x20: falls = 0; target = arg; break;            /* JMP */
+            case 0x21: case 0x22: pops = 1; target = arg; break;  /* JZ, JNZ */
+            case 0x30: case 0x31:                                 /* STORE, LOAD */
+                if (arg < 0 || arg >= MEM_SLOTS) proven = 0;
+                else if (arg >= slots) slots = arg + 1;
+                if (op == 0x30) pops = 1; else pushes = 1;
+                break;
+            case 0x50: pops = 2; pushes = 1; break;               /* PAIR */
+            case 0x51: case 0x52: pops = 1; pushes = 1; break;    /* LEFT, RIGHT */
+            case 0xFF: falls = 0; break;                          /* HALT */
+            default:
+                if (op >= 0x10 && op <= 0x19) { pops = 2; pushes = 1; }   /* ADD .. GE */
+                else proven = 0;                                  /* CALL, RET */
+        }
+
+        int after = d - pops + pushes;
+        if (d < pops || after > PROVE_DEPTH) proven = 0;
+        if (after > deepest) deepest = after;
+
+        int next[2] = { falls ? pc + width : -1, target };
+        for (int k = 0; k < 2 && proven; k++) {
+            int to = next[k];
+            if (to == -1) continue;   /* no fall-through (HALT, JMP) or no branch */
+            if (to < 0 || to >= size) { proven = 0; break; }   /* runs off the end */
+            if (depth[to] == -1) {
+                depth[to] = after;
+                work[count++] = to;
+            } else if (depth[to] != after) {
+                proven = 0;
+            }
+        }
+    }
+
+    free(depth);
+    free(work);
+    *max_stack = proven ? deepest : 0;
+    *mem_slots = slots;
+    return proven && size > 0;
+}
+
+// Container (VM/byc.h): header, section table, code, line map, labels.
+int assemble_container(const ByteBuf *code, const ByteBuf *lines, const ByteBuf *symbols, ByteBuf *file) {
+    int max_stack = 0, mem_slots = 0;
+    int verified = prove_bounds(code->data, code->size, &max_stack, &mem_slots);
+    if (verified < 0) {
+        out_of_memory();
+        return 1;
+    }
+
+    const ByteBuf *sections[] = { code, lines, symbols };
+    int kinds[] = { BYC_SEC_CODE, BYC_SEC_LINES, BYC_SEC_SYMBOLS };
+    int nsections = 3;
+
+    for (int i = 0; i < 4; i++) bytebuf_put(file, BYC_MAGIC[i]);
+    bytebuf_put_int32(file, 0);                       /* CRC, patched below */
+    write_int16(file, BYC_VERSION);
+    write_int16(file, nsections);
+    bytebuf_put_int32(file, verified ? BYC_VERIFIED : 0);
+    bytebuf_put_int32(file, 0);                       /* entry */
+    bytebuf_put_int32(file, max_stack);
+    bytebuf_put_int32(file, mem_slots);
+    bytebuf_put_int32(file, 0);                       /* reserved */
+
+    int offset = BYC_HEADER_SIZE + nsections * BYC_SECTION_SIZE;
+    for (int i = 0; i < nsections; i++) {
+        bytebuf_put_int32(file, kinds[i]);
+        bytebuf_put_int32(file, offset);
+        bytebuf_put_int32(file, sections[i]->size);
+        offset += sections[i]->size;
+    }
+    for (int i = 0; i < nsections; i++) {
+        for (int k = 0; k < sections[i]->size; k++) bytebuf_put(file, sections[i]->data[k]);
+    }
+    if (file->failed) {
+        out_of_memory();
+        free(file->data);
+        *file = (ByteBuf){ 0 };
+        return 1;
+    }
+
+    uint32_t crc = byc_crc32(file->data + 8, (size_t)file->size - 8);
+    for (int i = 0; i < 4; i++) file->data[4 + i] = (unsigned char)(crc >> (8 * i));
+    return 0;
+}
+
+int assemble_buffer(const char *asm_text, size_t len, ByteBuf *out) {
+    const char *end = asm_text + len;
+    LabelTable labels = { 0 };
+    ByteBuf code = { 0 }, lines = { 0 };
+    int ok = pass1_build_label_table(asm_text, end, &labels) &&
+             pass2_emit_bytecode(asm_text, end, &labels, &code, &lines);
+
+    if (ok) {
+        ByteBuf symbols = { 0 };
+        for (int i = 0; i < labels.count; i++) {
+            bytebuf_put_int32(&symbols, labels.labels[i].addr);
+            for (const char *c = labels.labels[i].name; ; c++) {
+                bytebuf_put(&symbols, *c);
+                if (!*c) break;
+            }
+        }
+        if (code.failed || lines.failed || symbols.failed) {
+            out_of_memory();
+            ok = 0;
+        } else {
+            ok = assemble_container(&code, &lines, &symbols, out) == 0;
+        }
+        free(symbols.data);
+    }
+    free(labels.labels);
+    free(code.data);
+    free(lines.data);
+    return ok ? 0 : 1;
+}
+
+//   Assemble function
+int assemble(char *infile, char *outfile) {
+    FILE *in = fopen(infile, "rb");
+   
+
+    if (!in ) {
+        printf("file error\n");
+        return 1;
+    }
+
+    ByteBuf text = { 0 };
+    int ch;
+    while ((ch = fgetc(in)) != EOF) bytebuf_put(&text, ch);
+    fclose(in);
+    if (text.failed) {
+        out_of_memory();
+        free(text.data);
+        return 1;
+    }
+
+    clock_t start = clock();
+
+    ByteBuf file = { 0 };
+    if (assemble_buffer((const char *)text.data, (size_t)text.size, &file) != 0) {
+        free(text.data);
+        return 1;
+    }
+    free(text.data);
+
+    clock_t end = clock();
+    double time_taken = ((double)(end - start))* 1000.0 / CLOCKS_PER_SEC;
+    printf("Assemble time: %f milliseconds\n", time_taken);
+    
+    int code_size = read_int32(file.data + BYC_HEADER_SIZE + 8);   /* first section: code */
+    printf("Output bytecode size: %d bytes (code %d)\n", file.size, code_size);
+    
+
+    FILE *out = fopen(outfile, "wb");
+    int written = out ? (int)fwrite(file.data, 1, file.size, out) : 0;
+    int failed = !out || fclose(out) != 0 || written != file.size;
+    free(file.data);
+    if (failed) {
+        printf("file error\n");
+        return 1;
+    }
+    return 0;
+}
@@ -1,11 +1,46 @@
-#ifndef ASM_H
-#define ASM_H
-
-#include <stdint.h>
-
-int lookup_opcode(char *word, uint8_t *opcode);
-
-int assemble(char *infile, char *outfile);
-
-
-#endif
+#ifndef ASM_H
+#define ASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * growable byte buffer; zero-initialise, the owner frees data. When memory
+ * runs out, failed is set and later bytes are dropped, so writers check it
+ * once at the end instead of after every byte.
+ */
+typedef struct {
+    unsigned char *data;
+    int size;
+    int cap;
+    int failed;
+} ByteBuf;
+
+void bytebuf_put(ByteBuf *b, int byte);
+void bytebuf_put_int32(ByteBuf *b, int val);   /* little-endian */
+
+int lookup_opcode(char *word, uint8_t *opcode);
+
+/*
+ * Assemble len bytes of assembly text into a .byc container (VM/byc.h) in
+ * out. Nothing is read or written on disk and no state outlives the call,
+ * so it can be linked into other programs (the shell runs jobs with it).
+ * Returns 0 on success; on error prints "error: ..." and leaves out empty.
+ */
+int assemble_buffer(const char *asm_text, size_t len, ByteBuf *out);
+
+/*
+ * Wrap an opcode stream that is already resolved into a container, for
+ * front ends that emit bytecode themselves (the compiler's direct backend).
+ * lines holds (code offset, source line) int32 pairs and symbols int32
+ * offset + NUL-terminated name records; either may be empty. The bounds
+ * proof behind BYC_VERIFIED runs here. Returns 0 on success; out of memory
+ * prints "error: ..." and leaves out empty.
+ */
+int assemble_container(const ByteBuf *code, const ByteBuf *lines, const ByteBuf *symbols, ByteBuf *out);
+
+/* file front end used by the assembler binary; returns 0 on success */
+int assemble(char *infile, char *outfile);
+
+
+#endif
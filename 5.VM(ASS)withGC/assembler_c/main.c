@@ -0,0 +1,11 @@
+#include "assembler.h"
+#include <stdio.h>
+
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        printf("use: %s input.asm output.bin\n", argv[0]);
+        return 1;
+    }
+    return assemble(argv[1], argv[2]);
+}
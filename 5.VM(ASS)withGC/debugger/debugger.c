@@ -4,6 +4,7 @@
 #include "debugger.h"
 #include "../VM/include/object.h"
 #include "../VM/exec.h"
+#include "../VM/loader.h"
 
 #define MAX_BPS 32
 
@@ -61,14 +62,20 @@ int is_breakpoint(int pc) {
 
 void list_code(Program *p) {
     printf("\n--- Disassembly (Next 10 Instructions) ---\n");
-    int cur = p->pc;
+    int here = vm_code_offset(p, p->pc);
+    int cur = here;
     
     // We will show 10 instructions or until we hit the end of the bytecode
     for (int i = 0; i < 10 && cur < p->code_size; i++) {
         unsigned char op = p->code[cur];
+        const char *label = vm_symbol_at(p, cur);
+        int line = vm_source_line(p, cur);   /* .byc containers only */
         
+        if (label) printf("         %s:\n", label);
+
         // Print the indicator for current PC and the address
-        printf(" %s %04d: ", (cur == p->pc) ? "->" : "  ", cur);
+        printf(" %s %04d: ", (cur == here) ? "->" : "  ", cur);
+        if (line) printf("[line %d] ", line);
 
         switch (op) {
             /* --- 5-Byte Instructions (Opcode + Int32) --- */
@@ -115,20 +122,36 @@ void list_code(Program *p) {
 }
 
 
+/* --- Operand stack view --- */
+
+void show_stack(Program *p) {
+    printf("\n--- Operand Stack (top -> bottom, sp=%d) ---\n", p->sp);
+    if (p->sp == 0) {
+        printf("(empty)\n");
+    }
+    for (int i = p->sp - 1; i >= 0; i--) {
+        printf(" [%d] ", i);
+        value_print(p->stack[i]);
+        printf("\n");
+    }
+    printf("------------------------------------------\n");
+}
+
+
 void debug_start(Program *p) {
     char cmd[64];
     int val;
 
     printf("\n=== VM DEBUGGER ===\n");
-    printf("Commands: step, continue, break <addr>, delete <id>, info break, clear, list, memstat, gc, leaks ,exit \n");
+    printf("Commands: step, continue, break <addr>, delete <id>, info break, clear, list, stack, memstat, gc, leaks ,exit \n");
 
     while (1) {
-        printf("(debug pc=%d) > ", p->pc);
+        printf("(debug pc=%d) > ", vm_code_offset(p, p->pc));
         if (scanf("%63s", cmd) <= 0) break;
 
         if (strcmp(cmd, "step") == 0) {
             if (!vm_step(p)) {
-                printf("\n[System] Execution Finished (HALT reached at PC %d).\n", p->pc);
+                printf("\n[System] Execution Finished (HALT reached at PC %d).\n", vm_code_offset(p, p->pc));
                 break; // Exit debugger loop
             }
         } 
@@ -136,7 +159,7 @@ void debug_start(Program *p) {
             // printf("Resuming execution...\n");
 
             // Step once to move past current breakpoint if we are sitting on one
-            if (is_breakpoint(p->pc)) {
+            if (is_breakpoint(vm_code_offset(p, p->pc))) {
                 if (!vm_step(p)) {
                     printf("\n[System] Execution Finished.\n");
                     return;
@@ -144,9 +167,9 @@ void debug_start(Program *p) {
             }
 
             int running = 1;
-            while (p->pc < p->code_size && !is_breakpoint(p->pc)) {
+            while (!is_breakpoint(vm_code_offset(p, p->pc))) {
                 if (!vm_step(p)) {
-                    printf("\n[System] Execution Finished (HALT reached at PC %d).\n", p->pc);
+                    printf("\n[System] Execution Finished (HALT reached at PC %d).\n", vm_code_offset(p, p->pc));
                     running = 0;
                     break;
                 }
@@ -157,8 +180,8 @@ void debug_start(Program *p) {
                 return; 
             }
 
-            if (is_breakpoint(p->pc)) {
-                printf("\n[TRAP] Hit breakpoint at address %d\n", p->pc);
+            if (is_breakpoint(vm_code_offset(p, p->pc))) {
+                printf("\n[TRAP] Hit breakpoint at address %d\n", vm_code_offset(p, p->pc));
             }
         }
         // else if(strcmp(cmd, "BP_count") == 0) {
@@ -189,25 +212,33 @@ void debug_start(Program *p) {
 
             list_code(p);
 
+        }else if (strcmp(cmd, "stack") == 0) {
+
+            show_stack(p);
+
         }else if (strcmp(cmd, "exit") == 0){
             printf("Exiting debugger.\n");
             break;
         }else if (strcmp(cmd, "memstat") == 0) {
-            // varaible sare already decalred in object.h
+            // the counters live in the program's heap (object.h)
+            Heap *h = p->heap;
 
-            extern int total_objects_created;
-            extern int no_of_object_freed;
-            extern int stack_object_count;
-            
-            checkstack();
+            const char *phase = gc_phase_name(h);   /* checkstack completes a running cycle */
+            checkstack(h);
 
             
             printf("--- Heap Report ---\n");
-            printf("Objects Created: %d\n", total_objects_created);
-            printf("Objects to be Freed:   %d\n", total_objects_created - stack_object_count - no_of_object_freed);
-            printf("Live on Heap:    %d\n", total_objects_created - no_of_object_freed);
-            printf("Live on Stack:   %d\n", stack_object_count);
-            printf("no of objrct freed till now: %d\n", no_of_object_freed);
+            printf("Objects Created: %d\n", h->objects_created);
+            printf("Objects to be Freed:   %d\n", h->objects_created - h->objects_reachable - h->objects_freed);
+            printf("Live on Heap:    %d\n", h->objects_created - h->objects_freed);
+            printf("Live on Stack:   %d\n", h->objects_reachable);
+            printf("no of objrct freed till now: %d\n", h->objects_freed);
+            printf("Heap bytes:      %zu (next auto GC at %zu)\n", h->bytes_allocated, gc_next_threshold(h));
+            printf("GC cycles:       %d (minor: %d)\n", h->cycles, h->minor_cycles);
+            printf("Nursery bytes:   %zu / %zu\n", gc_nursery_used(h), gc_nursery_size(h));
+            printf("GC phase:        %s (steps: %d, max pause %ld us)\n",
+                   phase, h->incremental_steps, h->max_pause_us);
+            printf("Slab bytes:      %zu\n", heap_reserved_bytes(h));
             printf("-------------------\n");
 
 
@@ -216,17 +247,16 @@ void debug_start(Program *p) {
         else if (strcmp(cmd, "gc") == 0) {
 
 
-            extern int no_of_object_freed; 
             //  Record how many were freed BEFORE we start
-            int count_before = no_of_object_freed; 
+            int count_before = p->heap->objects_freed; 
             
             printf("Triggering Garbage Collection...\n");
             
            
-            gc_start(); 
+            gc_start(p->heap); 
             
             // Calculate the DIFFERENCE
-            int just_freed = no_of_object_freed - count_before;
+            int just_freed = p->heap->objects_freed - count_before;
             
             printf("Objects actually reclaimed: %d\n", just_freed);
             printf("Garbage Collection complete.\n");
@@ -237,15 +267,13 @@ void debug_start(Program *p) {
 
 
 
-            extern int total_objects_created;
-            extern int no_of_object_freed;
-            extern int stack_object_count;
+            Heap *h = p->heap;
             
             // Ensure the stack count is fresh
-            checkstack(); 
+            checkstack(h); 
 
-            int live_heap = total_objects_created - no_of_object_freed;
-            int unreachable = live_heap - stack_object_count;
+            int live_heap = h->objects_created - h->objects_freed;
+            int unreachable = live_heap - h->objects_reachable;
 
 
             printf("--- Leak Analysis ---\n");
@@ -1,180 +1,243 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-
-#include "VM/vm.h"
-#include "VM/loader.h"
-#include "VM/exec.h"
-#include "VM/include/object.h"   /* for gc_collect */
-#include "debugger/debugger.h"
-
-
-void print_stack(Program *p) {
-    printf("\n=== VM HALTED ===\n");
-
-    if (p->sp == 0) {
-        printf("Stack is empty\n");
-        return;
-    }
-
-    printf("Stack (top -> bottom):\n");
-    for (int i = p->sp - 1; i >= 0; i--) {
-
-        Value v = p->stack[i];
-
-        if (v.type == VAL_OBJ && v.obj != NULL) {
-
-            if (v.obj->type == OBJ_INT) {
-                ObjInt *oi = (ObjInt *)v.obj;
-                printf("[%d] ObjInt value=%d\n", i, oi->value);
-            }
-            else if (v.obj->type == OBJ_PAIR) {
-                printf("[%d] ObjPair %p\n", i, (void *)v.obj);
-            }
-            else {
-                printf("[%d] Obj(type=%d) %p\n", i, v.obj->type, (void *)v.obj);
-            }
-
-        } else {
-            printf("[%d] <invalid>\n", i);
-        }
-    }
-}
-
-
-
-void print_memory(Program *p) {
-    printf("\n=== GLOBAL MEMORY (VARIABLES) ===\n");
-    int empty = 1;
-
-    for (int i = 0; i < MEM_SIZE; i++) {
-        Value v = p->memory[i];
-        if (v.type == VAL_NIL) continue;
-
-        empty = 0;
-        printf("[%d] ", i);
-        if (v.type == VAL_OBJ && v.obj != NULL) {
-            if (v.obj->type == OBJ_INT) printf("Int: %d\n", ((ObjInt *)v.obj)->value);
-            else if (v.obj->type == OBJ_PAIR) printf("Pair: %p\n", (void *)v.obj);
-            else printf("Obj(type=%d)\n", v.obj->type);
-        } else {
-            printf("<Invalid>\n");
-        }
-    }
-    if (empty) printf("(Memory is empty)\n");
-    printf("=================================\n");
-}
-
-
-// int main(int argc, char **argv) {
-
-//     /* CLI rule */
-//     if (argc != 2) {
-//         fprintf(stderr, "usage: %s <bytecode_file>\n", argv[0]);
-//         return 1;
-//     }
-
-//     const char *file = argv[1];
-
-//     /* enforce .byc extension */
-//     const char *ext = strrchr(file, '.');
-//     if (!ext || strcmp(ext, ".byc") != 0) {
-//         fprintf(stderr, "error: expected .byc file\n");
-//         return 1;
-//     }
-
-//     /* load bytecode */
-//     int size = 0;
-//     unsigned char *code = load_bytecode(file, &size);
-//     if (!code)
-//         return 1;
-
-//     /* initialize VM program */
-//     Program prog;
-//     vm_init(&prog, code, size);
-
-//     vm_validate(&prog);
-//     vm_dump_bytecode(&prog);
-
-
-//     // clocking the execution
-//     clock_t start = clock();
-
-
-//     vm_run(&prog);
-
-
-//     clock_t end = clock();
-//     double time_taken = ((double)(end - start))* 1000.0 / CLOCKS_PER_SEC;
-//     printf("Execution time: %f milliseconds\n", time_taken);
-    
-//     printf("\n===== GC WHILE STACK IS LIVE =====\n");
-
-//     no_of_object_freed = 0;
-//      /* Start GC timer */
-//     clock_t gc_start = clock();
-
-//     /* Run GC */
-//     gc_collect(0);  /* show debug info */
-
-//     /* End GC timer */
-//     clock_t gc_end = clock();
-//     double gc_time_taken = ((double)(gc_end - gc_start)) * 1000.0 / CLOCKS_PER_SEC;
-
-//     /* Print GC stats */
-//     printf("\nGC SUMMARY\n");
-//     printf("Objects freed: %d\n", no_of_object_freed);
-//     printf("GC time: %f milliseconds\n", gc_time_taken);
-
-//     print_stack(&prog);
-
-//     print_memory(&prog);
-    
-//     // printf("\n===== GC AFTER VM RUN =====\n");
-//     // gc_collect();
-
-//     vm_free(&prog);
-//     return 0;
-// }
-
-
-int main(int argc, char **argv) {
-    if (argc < 2) {
-        fprintf(stderr, "usage: %s <bytecode_file> [debug]\n", argv[0]);
-        return 1;
-    }
-
-    const char *file = argv[1];
-    int is_debug = (argc == 3 && strcmp(argv[2], "debug") == 0);
-
-    /* enforce .byc extension */
-    const char *ext = strrchr(file, '.');
-    if (!ext || strcmp(ext, ".byc") != 0) {
-        fprintf(stderr, "error: expected .byc file\n");
-        return 1;
-    }
-
-    int size = 0;
-    unsigned char *code = load_bytecode(file, &size);
-    if (!code) return 1;
-
-    Program prog;
-    vm_init(&prog, code, size);
-
-    if (is_debug) {
-        // --- PHASE 1 START ---
-        debug_start(&prog);
-        // --- PHASE 1 END ---
-    } else {
-        // Standard Execution
-        vm_validate(&prog);
-        vm_run(&prog);
-        gc_collect(0);
-        print_stack(&prog);
-        print_memory(&prog);
-    }
-
-    vm_free(&prog);
-    return 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "VM/vm.h"
+#include "VM/loader.h"
+#include "VM/exec.h"
+#include "VM/tier.h"
+#include "VM/byc.h"
+#include "VM/include/object.h"   /* for gc_collect */
+#include "debugger/debugger.h"
+
+
+
+// int main(int argc, char **argv) {
+
+//     /* CLI rule */
+//     if (argc != 2) {
+//         fprintf(stderr, "usage: %s <bytecode_file>\n", argv[0]);
+//         return 1;
+//     }
+
+//     const char *file = argv[1];
+
+//     /* enforce .byc extension */
+//     const char *ext = strrchr(file, '.');
+//     if (!ext || strcmp(ext, ".byc") != 0) {
+//         fprintf(stderr, "error: expected .byc file\n");
+//         return 1;
+//     }
+
+//     /* load bytecode */
+//     int size = 0;
+//     unsigned char *code = load_bytecode(file, &size);
+//     if (!code)
+//         return 1;
+
+//     /* initialize VM program */
+//     Program prog;
+//     vm_init(&prog, code, size);
+
+//     vm_validate(&prog);
+//     vm_dump_bytecode(&prog);
+
+
+//     // clocking the execution
+//     clock_t start = clock();
+
+
+//     vm_run(&prog);
+
+
+//     clock_t end = clock();
+//     double time_taken = ((double)(end - start))* 1000.0 / CLOCKS_PER_SEC;
+//     printf("Execution time: %f milliseconds\n", time_taken);
+    
+//     printf("\n===== GC WHILE STACK IS LIVE =====\n");
+
+//     no_of_object_freed = 0;
+//      /* Start GC timer */
+//     clock_t gc_start = clock();
+
+//     /* Run GC */
+//     gc_collect(0);  /* show debug info */
+
+//     /* End GC timer */
+//     clock_t gc_end = clock();
+//     double gc_time_taken = ((double)(gc_end - gc_start)) * 1000.0 / CLOCKS_PER_SEC;
+
+//     /* Print GC stats */
+//     printf("\nGC SUMMARY\n");
+//     printf("Objects freed: %d\n", no_of_object_freed);
+//     printf("GC time: %f milliseconds\n", gc_time_taken);
+
+//     print_stack(&prog);
+
+//     print_memory(&prog);
+    
+//     // printf("\n===== GC AFTER VM RUN =====\n");
+//     // gc_collect();
+
+//     vm_free(&prog);
+//     return 0;
+// }
+
+
+static void print_usage(const char *prog) {
+    fprintf(stderr, "usage: %s <bytecode_file> [debug] [--gc-threshold <bytes>] [--gc-grow <factor>] [--gc-nursery <bytes>]\n"
+                    "       [--gc-incremental <work>] [--gc-step-interval <instructions>]\n"
+                    "       [--gc-threads <n>] [--gc-sweep-thread] [--gc=mark-sweep|compact]\n"
+                    "       [--no-fuse] [--fusion-report] [--tier] [--tier-threshold <n>] [--verify]\n", prog);
+}
+
+/* whole-string decimal number in [min, max]; atoi would turn "1k" or "x" into 1 or 0 */
+static int parse_number(const char *s, long min, long max, long *out) {
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE || v < min || v > max) return 0;
+    *out = v;
+    return 1;
+}
+
+static int bad_number(const char *option, const char *value) {
+    fprintf(stderr, "error: invalid number '%s' for %s\n", value, option);
+    return 1;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char *file = argv[1];
+    int is_debug = 0;
+    long gc_threshold = GC_DEFAULT_THRESHOLD;
+    int gc_grow = GC_DEFAULT_GROW_FACTOR;
+    long gc_nursery = GC_DEFAULT_NURSERY;
+    int gc_work = 0;
+    int gc_interval = GC_DEFAULT_STEP_INTERVAL;
+    int gc_threads = 1;
+    int gc_sweep_thread = 0;
+    int gc_compact = 0;
+    int fuse = 1;
+    int fusion_report = 0;
+    int tier_threshold = 0;   /* 0: fuse everything up front */
+    int force_verify = 0;     /* ignore the assembler's VERIFIED flag */
+    long num;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "debug") == 0) {
+            is_debug = 1;
+        } else if (strcmp(argv[i], "--gc-threshold") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], LONG_MIN, LONG_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            gc_threshold = num;
+        } else if (strcmp(argv[i], "--gc-grow") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], INT_MIN, INT_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            gc_grow = (int)num;
+        } else if (strcmp(argv[i], "--gc-nursery") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], LONG_MIN, LONG_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            gc_nursery = num;
+        } else if (strcmp(argv[i], "--gc-incremental") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], INT_MIN, INT_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            gc_work = (int)num;
+        } else if (strcmp(argv[i], "--gc-step-interval") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], INT_MIN, INT_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            gc_interval = (int)num;
+        } else if (strcmp(argv[i], "--gc-threads") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], INT_MIN, INT_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            gc_threads = (int)num;
+        } else if (strcmp(argv[i], "--gc-sweep-thread") == 0) {
+            gc_sweep_thread = 1;
+        } else if (strcmp(argv[i], "--gc=compact") == 0) {
+            gc_compact = 1;
+        } else if (strcmp(argv[i], "--gc=mark-sweep") == 0) {
+            gc_compact = 0;
+        } else if (strcmp(argv[i], "--no-fuse") == 0) {
+            fuse = 0;
+        } else if (strcmp(argv[i], "--fusion-report") == 0) {
+            fusion_report = 1;
+        } else if (strcmp(argv[i], "--tier") == 0) {
+            tier_threshold = TIER_DEFAULT_THRESHOLD;
+        } else if (strcmp(argv[i], "--tier-threshold") == 0 && i + 1 < argc) {
+            if (!parse_number(argv[++i], INT_MIN, INT_MAX, &num)) return bad_number(argv[i - 1], argv[i]);
+            tier_threshold = (int)num;
+            if (tier_threshold < 1) {
+                fprintf(stderr, "error: invalid tier threshold (must be >= 1)\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            force_verify = 1;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (gc_threshold < 0 || gc_grow < 1 || gc_nursery < 0 || gc_work < 0 || gc_interval < 1 || gc_threads < 1) {
+        fprintf(stderr, "error: invalid GC tuning (threshold >= 0, grow factor >= 1, nursery >= 0, "
+                        "incremental work >= 0, step interval >= 1, threads >= 1)\n");
+        return 1;
+    }
+    /* enforce .byc extension */
+    const char *ext = strrchr(file, '.');
+    if (!ext || strcmp(ext, ".byc") != 0) {
+        fprintf(stderr, "error: expected .byc file\n");
+        return 1;
+    }
+
+    Heap *heap = heap_create();
+    if (!heap) return 1;
+    gc_set_threshold(heap, (size_t)gc_threshold, gc_grow);
+    gc_set_nursery(heap, (size_t)gc_nursery);
+    gc_set_incremental(heap, gc_work, gc_interval);
+    gc_set_threads(heap, gc_threads);
+    gc_set_background_sweep(heap, gc_sweep_thread);
+    gc_set_compact(heap, gc_compact);
+
+    Program prog;
+    if (!vm_load(&prog, heap, file)) {
+        heap_destroy(heap);
+        return 1;
+    }
+    if (force_verify) prog.info.flags &= ~BYC_VERIFIED;
+
+    if (is_debug) {
+        // --- PHASE 1 START ---
+        vm_decode(&prog);
+        debug_start(&prog);
+        // --- PHASE 1 END ---
+    } else {
+        // Standard Execution
+        vm_validate(&prog);
+        if (fuse && tier_threshold > 0) {
+            tier_init(&prog, tier_threshold);
+        } else if (fuse) {
+            vm_fuse(&prog);
+            if (fusion_report) vm_fusion_report();
+        }
+        vm_run(&prog);
+        if (prog.tier) {
+            tier_report(&prog);
+            tier_free(&prog);
+        }
+        gc_collect(heap, 0);
+        gc_quiesce(heap);
+        printf("GC cycles: %d\n", heap->cycles);
+        printf("Minor GC cycles: %d\n", heap->minor_cycles);
+        printf("GC incremental steps: %d\n", heap->incremental_steps);
+        printf("GC max pause: %ld us\n", heap->max_pause_us);
+        vm_print_stack(&prog);
+        vm_print_memory(&prog);
+    }
+
+    vm_free(&prog);
+    heap_destroy(heap);
+    return 0;
 }
\ No newline at end of file
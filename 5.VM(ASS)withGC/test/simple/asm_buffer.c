@@ -0,0 +1,49 @@
+/*
+ * Assembles a file through assemble_buffer, the in-memory API the shell
+ * links against, so run_vm_tests.sh can compare it with the assembler binary.
+ * The text is copied into a buffer of exactly its size, without a NUL.
+ */
+#include "../../assembler_c/assembler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        printf("use: %s input.asm output.byc\n", argv[0]);
+        return 1;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        printf("file error\n");
+        return 1;
+    }
+    ByteBuf text = { 0 };
+    int ch;
+    while ((ch = fgetc(in)) != EOF) bytebuf_put(&text, ch);
+    fclose(in);
+
+    char *exact = malloc(text.size ? (size_t)text.size : 1);
+    if (!exact || text.failed) {
+        printf("error: out of memory\n");
+        return 1;
+    }
+    if (text.size) memcpy(exact, text.data, (size_t)text.size);
+    free(text.data);
+
+    ByteBuf out = { 0 };
+    int rc = assemble_buffer(exact, (size_t)text.size, &out);
+    free(exact);
+    if (rc != 0) return 1;
+
+    FILE *f = fopen(argv[2], "wb");
+    int failed = !f || fwrite(out.data, 1, (size_t)out.size, f) != (size_t)out.size;
+    if (f && fclose(f) != 0) failed = 1;
+    free(out.data);
+    if (failed) {
+        printf("file error\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+PUSH 100000
+STORE 0
+CALL f
+PUSH 7
+HALT
+f:
+LOAD 0
+JZ done
+LOAD 0
+PUSH 1
+SUB
+STORE 0
+CALL f
+done:
+RET
@@ -0,0 +1,6 @@
+PUSH -2147483647
+PUSH 1
+SUB
+PUSH -1
+DIV
+HALT
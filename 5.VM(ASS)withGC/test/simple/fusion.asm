@@ -0,0 +1,41 @@
+; every superinstruction pattern once, plus a LOAD; LOAD; ADD that must
+; not be fused because its second LOAD is a jump target
+PUSH 5
+STORE 0        ; i = 5
+PUSH 0
+STORE 1        ; sum = 0
+PUSH 7
+STORE 2
+
+loop:
+LOAD 0
+PUSH 0
+GT
+JZ done        ; CMP_JZ
+
+LOAD 1
+LOAD 0
+ADD            ; LOAD_LOAD_ADD
+PUSH 2
+SUB            ; ADDI
+STORE 1        ; sum += i - 2
+
+LOAD 0
+PUSH 1
+SUB
+STORE 0        ; INC_MEM: i--
+
+JMP loop
+
+done:
+PUSH 100
+LOAD 2
+JMP second
+first:
+LOAD 2
+second:
+LOAD 1
+ADD
+ADD
+STORE 3        ; 100 + 7 + 5
+HALT
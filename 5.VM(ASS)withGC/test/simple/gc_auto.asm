@@ -0,0 +1,16 @@
+; gc_auto: allocate 1000 short-lived pairs; a small --gc-threshold must
+; trigger collections while the program runs
+PUSH 1000
+STORE 0
+loop:
+LOAD 0
+LOAD 0
+PAIR
+POP
+LOAD 0
+PUSH 1
+SUB
+DUP
+STORE 0
+JNZ loop
+HALT
@@ -0,0 +1,42 @@
+; gc_deep_list: build a 3000-node list of (leaf, next) pairs while small GC
+; thresholds collect, then sum the leaves; any live node freed early would
+; corrupt the sum (expected 4501500)
+PUSH 3000
+STORE 0
+PUSH 0
+STORE 1
+build:
+LOAD 0
+LOAD 0
+PAIR
+LOAD 1
+PAIR
+STORE 1
+LOAD 0
+PUSH 1
+SUB
+DUP
+STORE 0
+JNZ build
+PUSH 3000
+STORE 0
+PUSH 0
+STORE 2
+walk:
+LOAD 1
+DUP
+RIGHT
+STORE 1
+LEFT
+LEFT
+LOAD 2
+ADD
+STORE 2
+LOAD 0
+PUSH 1
+SUB
+DUP
+STORE 0
+JNZ walk
+LOAD 2
+HALT
@@ -273,6 +273,287 @@ else
     pass "truncated rejected"
 fi
 
+# Test 21: allocation-triggered GC runs mid-program with a small threshold
+# (nursery disabled so every allocation is charged to the old space).
+gc_auto_bin="$tmp_dir/gc_auto.byc"
+if ! "$ASM_BIN" "$TEST_DIR/gc_auto.asm" "$gc_auto_bin" >/dev/null 2>&1; then
+    fail_case "assemble gc_auto program"
+else
+    if ! "$VM_BIN" "$gc_auto_bin" --gc-threshold 4096 --gc-nursery 0 >"$tmp_dir/gc_auto.out" 2>"$tmp_dir/gc_auto.err"; then
+        fail_case "gc_auto should run"
+    elif ! grep -qE "GC cycles: ([2-9]|[1-9][0-9]+)$" "$tmp_dir/gc_auto.out"; then
+        fail_case "gc_auto should collect automatically"
+    else
+        pass "gc_auto program"
+    fi
+fi
+
+# Test 22: long linked structure survives collections (mark stack growth).
+deep_list_bin="$tmp_dir/gc_deep_list.byc"
+if ! "$ASM_BIN" "$TEST_DIR/gc_deep_list.asm" "$deep_list_bin" >/dev/null 2>&1; then
+    fail_case "assemble gc_deep_list program"
+else
+    if ! "$VM_BIN" "$deep_list_bin" --gc-threshold 8192 >"$tmp_dir/gc_deep_list.out" 2>"$tmp_dir/gc_deep_list.err"; then
+        fail_case "gc_deep_list should run"
+    elif ! grep -q "Int value=4501500" "$tmp_dir/gc_deep_list.out"; then
+        fail_case "gc_deep_list result"
+    else
+        pass "gc_deep_list program"
+    fi
+fi
+
+# Test 23: a tiny nursery forces many minor GCs; survivors must be promoted
+# intact, including young nodes referenced from old pairs and memory slots.
+if [[ -f "$deep_list_bin" ]]; then
+    if ! "$VM_BIN" "$deep_list_bin" --gc-nursery 4096 --gc-threshold 8192 >"$tmp_dir/gc_nursery.out" 2>"$tmp_dir/gc_nursery.err"; then
+        fail_case "gc_nursery should run"
+    elif ! grep -q "Int value=4501500" "$tmp_dir/gc_nursery.out"; then
+        fail_case "gc_nursery result"
+    elif ! grep -qE "Minor GC cycles: ([2-9]|[1-9][0-9]+)$" "$tmp_dir/gc_nursery.out"; then
+        fail_case "gc_nursery should run minor collections"
+    else
+        pass "gc_nursery program"
+    fi
+fi
+
+# Test 24: incremental marking/sweeping in tiny steps must keep every live
+# node (write barrier + allocate-black), with and without the nursery.
+if [[ -f "$deep_list_bin" ]]; then
+    for nursery in 0 4096; do
+        out="$tmp_dir/gc_incremental_$nursery.out"
+        if ! "$VM_BIN" "$deep_list_bin" --gc-incremental 16 --gc-threshold 8192 --gc-nursery "$nursery" >"$out" 2>&1; then
+            fail_case "gc_incremental (nursery $nursery) should run"
+        elif ! grep -q "Int value=4501500" "$out"; then
+            fail_case "gc_incremental (nursery $nursery) result"
+        elif ! grep -qE "GC incremental steps: [1-9][0-9]*$" "$out"; then
+            fail_case "gc_incremental (nursery $nursery) should step"
+        else
+            pass "gc_incremental program (nursery $nursery)"
+        fi
+    done
+fi
+
+# Test 25: full collections marked and swept by 4 worker threads.
+if [[ -f "$deep_list_bin" ]]; then
+    if ! "$VM_BIN" "$deep_list_bin" --gc-threads 4 --gc-threshold 8192 --gc-nursery 0 >"$tmp_dir/gc_threads.out" 2>&1; then
+        fail_case "gc_threads should run"
+    elif ! grep -q "Int value=4501500" "$tmp_dir/gc_threads.out"; then
+        fail_case "gc_threads result"
+    else
+        pass "gc_threads program"
+    fi
+fi
+
+# Test 26: sweeping on the background thread while the program keeps allocating.
+if [[ -f "$deep_list_bin" ]]; then
+    if ! "$VM_BIN" "$deep_list_bin" --gc-sweep-thread --gc-threshold 8192 --gc-nursery 4096 >"$tmp_dir/gc_sweep_thread.out" 2>&1; then
+        fail_case "gc_sweep_thread should run"
+    elif ! grep -q "Int value=4501500" "$tmp_dir/gc_sweep_thread.out"; then
+        fail_case "gc_sweep_thread result"
+    else
+        pass "gc_sweep_thread program"
+    fi
+fi
+
+# Test 27: mark-compact moves every survivor and rewrites stack, memory and
+# pair fields; the walk afterwards must still see the whole list.
+if [[ -f "$deep_list_bin" ]]; then
+    for nursery in 0 4096; do
+        out="$tmp_dir/gc_compact_$nursery.out"
+        if ! "$VM_BIN" "$deep_list_bin" --gc=compact --gc-threshold 8192 --gc-nursery "$nursery" >"$out" 2>&1; then
+            fail_case "gc_compact (nursery $nursery) should run"
+        elif ! grep -q "Int value=4501500" "$out"; then
+            fail_case "gc_compact (nursery $nursery) result"
+        else
+            pass "gc_compact program (nursery $nursery)"
+        fi
+    done
+fi
+
+# Test 28: superinstruction fusion fires once per pattern, never across a
+# jump target, and leaves the result unchanged.
+fusion_bin="$tmp_dir/fusion.byc"
+if ! "$ASM_BIN" "$TEST_DIR/fusion.asm" "$fusion_bin" >/dev/null 2>&1; then
+    fail_case "assemble fusion program"
+elif ! "$VM_BIN" "$fusion_bin" --fusion-report >"$tmp_dir/fusion.out" 2>&1 ||
+     ! "$VM_BIN" "$fusion_bin" --no-fuse >"$tmp_dir/nofuse.out" 2>&1; then
+    fail_case "fusion program should run"
+elif ! grep -q "Fusion: 30 -> 23 instructions" "$tmp_dir/fusion.out"; then
+    fail_case "fusion report"
+elif ! grep -q "\[3\] Int value=112" "$tmp_dir/fusion.out" ||
+     ! diff <(grep "Int value" "$tmp_dir/fusion.out") <(grep "Int value" "$tmp_dir/nofuse.out") >/dev/null; then
+    fail_case "fusion result"
+else
+    pass "superinstruction fusion"
+fi
+
+# Test 29: tiered execution promotes the loop once it is hot, runs the rest
+# of it fused, and leaves cold code (and the result) alone.
+if [[ -f "$fusion_bin" ]]; then
+    if ! "$VM_BIN" "$fusion_bin" --tier-threshold 2 >"$tmp_dir/tier.out" 2>&1 ||
+       ! "$VM_BIN" "$fusion_bin" --tier-threshold 100 >"$tmp_dir/tier_cold.out" 2>&1; then
+        fail_case "tiered program should run"
+    elif ! grep -q "1 loop(s) promoted" "$tmp_dir/tier.out" ||
+         ! grep -q "0 loop(s) promoted" "$tmp_dir/tier_cold.out" ||
+         ! grep -q "Tier instructions: base 93, fused 0" "$tmp_dir/tier_cold.out" ||
+         grep -q "fused 0$" "$tmp_dir/tier.out"; then
+        fail_case "tier promotion"
+    elif ! grep -q "\[3\] Int value=112" "$tmp_dir/tier.out"; then
+        fail_case "tiered result"
+    else
+        pass "tiered execution"
+    fi
+fi
+
+# Test 30: the verifier rejects a stack error on every path before running
+# (PUSH 5; STORE 0; POP; HALT) and names its pc; an overflow that only a
+# loop reaches is still trapped at run time.
+printf '\x01\x05\x00\x00\x00\x30\x00\x00\x00\x00\x02\xff' > "$tmp_dir/verify.byc"
+printf '\x01\x01\x00\x00\x00\x20\x00\x00\x00\x00\xff' > "$tmp_dir/verify_loop.byc"
+if "$VM_BIN" "$tmp_dir/verify.byc" >/dev/null 2>"$tmp_dir/verify.err" ||
+   "$VM_BIN" "$tmp_dir/verify_loop.byc" >/dev/null 2>"$tmp_dir/verify_loop.err"; then
+    fail_case "unverifiable programs should fail"
+elif ! grep -q "stack underflow at pc=10" "$tmp_dir/verify.err" ||
+     ! grep -q "stack overflow" "$tmp_dir/verify_loop.err"; then
+    fail_case "verifier error message"
+else
+    pass "stack verifier"
+fi
+
+# Test 31: the call stack grows past its old 1024-frame cap (100000 nested
+# CALLs), and memory is sized to the one slot the program uses.
+deep_call_bin="$tmp_dir/deep_call.byc"
+if ! "$ASM_BIN" "$TEST_DIR/deep_call.asm" "$deep_call_bin" >/dev/null 2>&1; then
+    fail_case "assemble deep_call program"
+else
+    if ! "$VM_BIN" "$deep_call_bin" >"$tmp_dir/deep_call.out" 2>"$tmp_dir/deep_call.err"; then
+        fail_case "deep_call should run"
+    elif ! grep -q "\[0\] Int value=7" "$tmp_dir/deep_call.out" ||
+         [[ $(grep -c "^\[[0-9]*\] Int value=" "$tmp_dir/deep_call.out") -ne 2 ]]; then
+        fail_case "deep_call result"
+    else
+        pass "deep_call program"
+    fi
+fi
+
+# Test 32: the assembler writes a checksummed container; a flipped code byte
+# is caught before decoding, and --verify re-runs the verifier on a good one.
+container_bin="$tmp_dir/container.byc"
+if ! "$ASM_BIN" "$ROOT_TEST_DIR/loop.asm" "$container_bin" >/dev/null 2>&1; then
+    fail_case "assemble container program"
+else
+    cp "$container_bin" "$tmp_dir/corrupt.byc"
+    # header (32) + three section entries (36): the first code byte, PUSH -> POP
+    printf '\x02' | dd of="$tmp_dir/corrupt.byc" bs=1 seek=68 conv=notrunc 2>/dev/null
+    if ! "$VM_BIN" "$container_bin" --verify >"$tmp_dir/container.out" 2>&1; then
+        fail_case "container program should run"
+    elif ! grep -q "\[0\] Int value=0" "$tmp_dir/container.out"; then
+        fail_case "container result"
+    elif "$VM_BIN" "$tmp_dir/corrupt.byc" >/dev/null 2>"$tmp_dir/corrupt.err"; then
+        fail_case "corrupted container should fail"
+    elif ! grep -q "checksum mismatch" "$tmp_dir/corrupt.err"; then
+        fail_case "checksum error message"
+    else
+        pass "bytecode container"
+    fi
+fi
+
+# Test 33: numeric options must be whole numbers; "abc" used to become 0 and
+# silently turn automatic GC off.
+if "$VM_BIN" "$container_bin" --gc-threshold abc >/dev/null 2>"$tmp_dir/badnum.err" ||
+   "$VM_BIN" "$container_bin" --gc-nursery 10k >/dev/null 2>>"$tmp_dir/badnum.err"; then
+    fail_case "non-numeric GC option should fail"
+elif [[ $(grep -c "invalid number" "$tmp_dir/badnum.err") -ne 2 ]]; then
+    fail_case "non-numeric GC option message"
+else
+    pass "numeric option parsing"
+fi
+
+# Test 34: INT_MIN / -1 overflows; it must be a VM error, not a SIGFPE.
+div_overflow_bin="$tmp_dir/div_overflow.byc"
+if ! "$ASM_BIN" "$TEST_DIR/div_overflow.asm" "$div_overflow_bin" >/dev/null 2>&1; then
+    fail_case "assemble div_overflow program"
+else
+    "$VM_BIN" "$div_overflow_bin" >/dev/null 2>"$tmp_dir/div_overflow.err"
+    status=$?
+    if [[ $status -ne 1 ]]; then
+        fail_case "div_overflow should exit with 1 (got $status)"
+    elif ! grep -q "div overflow" "$tmp_dir/div_overflow.err"; then
+        fail_case "div_overflow error message"
+    else
+        pass "div_overflow trapped"
+    fi
+fi
+
+# Test 35: without --verify a container runs on its header alone, so the
+# header must say what the assembler proved: loop.asm is VERIFIED with a
+# stack of 2 and 1 memory slot; a program with CALL is never VERIFIED.
+read -r flags entry max_stack mem_slots < <(od -An -tu4 -j12 -N16 "$container_bin")
+call_bin="$tmp_dir/call.byc"
+if [[ "$flags $entry $max_stack $mem_slots" != "1 0 2 1" ]]; then
+    fail_case "container header fields (got $flags $entry $max_stack $mem_slots)"
+elif ! "$VM_BIN" "$container_bin" >"$tmp_dir/container_fast.out" 2>&1 ||
+     ! grep -q "\[0\] Int value=0" "$tmp_dir/container_fast.out"; then
+    fail_case "verified container should run without --verify"
+elif ! "$ASM_BIN" "$TEST_DIR/call.asm" "$call_bin" >/dev/null 2>&1; then
+    fail_case "assemble call program"
+elif [[ $(od -An -tu4 -j12 -N4 "$call_bin" | tr -d ' ') != 0 ]]; then
+    fail_case "container with CALL must not be VERIFIED"
+elif ! "$VM_BIN" "$call_bin" >/dev/null 2>&1; then
+    fail_case "unverified container should run"
+else
+    pass "container header"
+fi
+
+# Test 36: assemble_buffer (linked into the shell) must produce exactly the
+# bytes of the assembler binary, for good and bad programs alike.
+ASM_BUFFER_BIN="$ROOT_DIR/asm_buffer"
+if [[ ! -x "$ASM_BUFFER_BIN" ]]; then
+    fail_case "missing asm_buffer driver; run 'make test'"
+else
+    mismatch=""
+    for src in "$TEST_DIR"/*.asm; do
+        name="$(basename "$src" .asm)"
+        "$ASM_BIN" "$src" "$tmp_dir/$name.file.byc" >/dev/null 2>&1
+        file_status=$?
+        "$ASM_BUFFER_BIN" "$src" "$tmp_dir/$name.buffer.byc" >/dev/null 2>&1
+        buffer_status=$?
+        if [[ $file_status -ne $buffer_status ]]; then
+            mismatch+=" $name"
+        elif [[ $file_status -eq 0 ]] && ! cmp -s "$tmp_dir/$name.file.byc" "$tmp_dir/$name.buffer.byc"; then
+            mismatch+=" $name"
+        fi
+    done
+    if [[ -n "$mismatch" ]]; then
+        fail_case "assemble_buffer differs from assembler:$mismatch"
+    else
+        pass "assemble_buffer matches assembler"
+    fi
+fi
+
+# Test 37: the VERIFIED flag skips vm_verify, but not the memory bounds: a
+# container forged to STORE 4000000 (checksum recomputed) must be refused,
+# not write past the memory array.
+forged_bin="$tmp_dir/forged.byc"
+if ! "$ASM_BIN" "$TEST_DIR/mem_ok.asm" "$forged_bin" >/dev/null 2>&1; then
+    fail_case "assemble forged program"
+else
+    # code at 68: PUSH 99 (5 bytes), then STORE's operand at 74
+    printf '\x00\x09\x3d\x00' | dd of="$forged_bin" bs=1 seek=74 conv=notrunc 2>/dev/null
+    # the CRC-32 over bytes 8..EOF is the one gzip puts in its trailer
+    tail -c +9 "$forged_bin" | gzip -c | tail -c 8 | head -c 4 |
+        dd of="$forged_bin" bs=1 seek=4 conv=notrunc 2>/dev/null
+    "$VM_BIN" "$forged_bin" >/dev/null 2>"$tmp_dir/forged.err"
+    status=$?
+    if [[ $status -ne 1 ]]; then
+        fail_case "forged container should exit with 1 (got $status)"
+    elif ! grep -q "invalid memory index 4000000 at pc=5" "$tmp_dir/forged.err"; then
+        fail_case "forged container error message"
+    else
+        pass "forged container trapped"
+    fi
+fi
+
 if [[ $fail -ne 0 ]]; then
     echo "VM tests failed."
     exit 1